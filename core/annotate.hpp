@@ -26,8 +26,7 @@ struct Ann_name {
 
 using Ann_node_pin_offset = Attribute<Ann_name::wireoffset, Node_pin, mmap_lib::map<Node_pin::Compact_class_driver, uint16_t> >;
 
-using Ann_node_pin_name =
-    Attribute<Ann_name::wirename, Node_pin, mmap_lib::bimap<Node_pin::Compact_class_driver, std::string_view> >;
+using Ann_node_pin_name = Attribute<Ann_name::wirename, Node_pin, mmap_lib::str_bimap<Node_pin::Compact_class_driver> >;
 
 using Ann_node_pin_prp_vname =
     Attribute<Ann_name::prp_vname, Node_pin, mmap_lib::map<Node_pin::Compact_class_driver, std::string_view> >;
@@ -36,7 +35,7 @@ using Ann_node_pin_ssa      = Attribute<Ann_name::ssa, Node_pin, mmap_lib::map<N
 
 using Ann_node_pin_delay = Attribute<Ann_name::delay, Node_pin, mmap_lib::map<Node_pin::Compact_driver, float> >;
 
-using Ann_node_name = Attribute<Ann_name::nodename, Node, mmap_lib::bimap<Node::Compact_class, std::string_view> >;
+using Ann_node_name = Attribute<Ann_name::nodename, Node, mmap_lib::str_bimap<Node::Compact_class> >;
 
 using Ann_node_place = Attribute<Ann_name::nodeplace, Node, mmap_lib::map<Node::Compact, Ann_place> >;
 
@@ -44,7 +43,7 @@ using Ann_node_file_loc = Attribute<Ann_name::file_loc, Node, mmap_lib::map<Node
 
 using Ann_node_tree_pos = Attribute<Ann_name::tree_pos, Node, mmap_lib::map<Node::Compact_class, uint32_t> >;
 
-using Ann_node_color = Attribute<Ann_name::color, Node, mmap_lib::bimap<Node::Compact_class, std::string_view> >;
+using Ann_node_color = Attribute<Ann_name::color, Node, mmap_lib::str_bimap<Node::Compact_class> >;
 
 
 struct Ann_support {
@@ -61,5 +60,33 @@ struct Ann_support {
     Ann_node_file_loc::clear(lg);
     Ann_node_tree_pos::clear(lg);
     Ann_node_color::clear(lg);
+
+    Attribute_str_pool::clear(lg);  // after all the str_bimap users
+  };
+
+  template <typename Fn>
+  static void remap(LGraph *lg, Fn key_fn) {
+    Ann_node_pin_offset::remap(lg, key_fn);
+    Ann_node_pin_prp_vname::remap(lg, key_fn);
+    Ann_node_pin_ssa::remap(lg, key_fn);
+    Ann_node_pin_delay::remap(lg, key_fn);
+
+    Ann_node_place::remap(lg, key_fn);
+    Ann_node_file_loc::remap(lg, key_fn);
+    Ann_node_tree_pos::remap(lg, key_fn);
+
+    // The str_pool is append-only: rebuild it with only the text still in use
+    auto pin_names = Ann_node_pin_name::remap_extract(lg, key_fn);
+    auto names     = Ann_node_name::remap_extract(lg, key_fn);
+    auto colors    = Ann_node_color::remap_extract(lg, key_fn);
+
+    Ann_node_pin_name::clear(lg);
+    Ann_node_name::clear(lg);
+    Ann_node_color::clear(lg);
+    Attribute_str_pool::clear(lg);
+
+    Ann_node_pin_name::remap_insert(lg, pin_names);
+    Ann_node_name::remap_insert(lg, names);
+    Ann_node_color::remap_insert(lg, colors);
   };
 };
@@ -2,15 +2,75 @@
 
 #pragma once
 
+#include <unistd.h>
+
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+
 #include "lgraph.hpp"
 #include "mmap_bimap.hpp"
 #include "mmap_map.hpp"
 
+template <typename Attr_data, typename = void>
+struct Attribute_is_bimap : std::false_type {};
+template <typename Attr_data>
+struct Attribute_is_bimap<Attr_data, std::void_t<typename Attr_data::Val2key_type>> : std::true_type {};
+
+template <typename Attr_data, typename = void>
+struct Attribute_uses_str_pool : std::false_type {};
+template <typename Attr_data>
+struct Attribute_uses_str_pool<Attr_data, std::void_t<decltype(std::declval<Attr_data>().get_pool())>> : std::true_type {};
+
+// All the str_bimap attributes of an LGraph share one string pool (names repeat across attributes)
+struct Attribute_str_pool {
+  static std::string get_filename(Lg_type_id lgid) { return absl::StrCat("lg_", std::to_string(lgid), "_str_pool"); }
+
+  // Call after clearing all the attributes that use the pool
+  static void clear(const LGraph *lg) { mmap_lib::str_pool::clear_shared(lg->get_path(), get_filename(lg->get_lgid())); }
+};
+
+// Every Attribute with a loaded table registers its forget. Graph_library calls forget when the files of an
+// lgraph are replaced or removed (snapshot commit/discard), not only for the Ann_support attributes
+class Attribute_registry {
+  inline static std::mutex                         mutex;
+  inline static std::vector<void (*)(Lg_type_id)> forget_fns;
+
+public:
+  static void add(void (*forget_fn)(Lg_type_id)) {
+    std::lock_guard<std::mutex> guard(mutex);
+    forget_fns.emplace_back(forget_fn);
+  }
+
+  static void forget(Lg_type_id lgid) {
+    std::vector<void (*)(Lg_type_id)> fns;
+    {
+      std::lock_guard<std::mutex> guard(mutex);
+      fns = forget_fns;
+    }
+    for (auto *fn : fns) fn(lgid);
+  }
+};
+
+// Concurrency guarantees:
+//  -ref/clear/remap can be called from any thread.
+//  -Different LGraphs: reads and writes from different threads do not share Attr_data. The mmap_gc pool is locked,
+//   and the gc of a thread only recycles the containers that thread accessed last.
+//  -Same LGraph: the Attr_data (mmap_lib map/bimap) is not thread safe, one writer and no concurrent readers.
+//  -clear/remap of an LGraph must not overlap with other threads using the same LGraph.
+//
+// The per thread cache (last_lg/last_attr) avoids the lock in the common case. clear bumps the epoch to invalidate
+// the caches of all the threads.
 template <const char *Name, typename Base, typename Attr_data>
 class Attribute {
   inline static std::vector<Attr_data *> table;
-  inline static const LGraph *           last_lg   = nullptr;
-  inline static Attr_data *              last_attr = nullptr;
+  inline static std::shared_mutex        table_mutex;
+  inline static std::atomic<uint64_t>    epoch{1};
+  inline static std::once_flag           registered;
+
+  inline static thread_local const LGraph *last_lg    = nullptr;
+  inline static thread_local Attr_data *   last_attr  = nullptr;
+  inline static thread_local uint64_t      last_epoch = 0;
 
   static std::string_view get_base() {
     if constexpr (std::is_same<Base, Node>::value) {
@@ -25,36 +85,94 @@ class Attribute {
 
   static bool is_invalid(size_t pos) { return (table.size() <= pos) || table[pos] == nullptr; };
 
+  // Before the str_pool, the text was in private txt files (bimap<Key, std::string_view>). Same map names
+  static bool is_old_str_format(const LGraph *lg) {
+    auto base = absl::StrCat(lg->get_path(), "/", get_filename(lg->get_lgid()));
+    return access((base + "_k2vtxt").c_str(), F_OK) == 0 || access((base + "_v2ktxt").c_str(), F_OK) == 0;
+  }
+
+  static void remove_old_str_format(const LGraph *lg) {
+    auto base = absl::StrCat(lg->get_path(), "/", get_filename(lg->get_lgid()));
+    for (const auto *ext : {"_k2v", "_k2vtxt", "_v2k", "_v2ktxt"}) {
+      unlink((base + ext).c_str());
+    }
+  }
+
+  static Attr_data *create(const LGraph *lg) {
+    if constexpr (Attribute_uses_str_pool<Attr_data>::value) {
+      if (is_old_str_format(lg))
+        LGraph::error("attribute {} of lgraph {} has the old bimap format, regenerate the lgdb {}", Name, lg->get_name(), lg->get_path());
+      return new Attr_data(lg->get_path(), get_filename(lg->get_lgid()), Attribute_str_pool::get_filename(lg->get_lgid()));
+    } else {
+      return new Attr_data(lg->get_path(), get_filename(lg->get_lgid()));
+    }
+  }
+
   static void setup_table(const LGraph *lg) {
-    last_lg  = lg;
     auto pos = lg->get_lgid().value;
-    if (!is_invalid(pos)) {
-      last_attr = table[pos];
-      return;
+
+    auto cur_epoch = epoch.load(std::memory_order_acquire);  // before the lookup, a concurrent clear forces a retry
+
+    {
+      std::shared_lock<std::shared_mutex> lock(table_mutex);
+      if (!is_invalid(pos)) {
+        last_attr  = table[pos];
+        last_lg    = lg;
+        last_epoch = cur_epoch;
+        return;
+      }
     }
 
-    if (pos >= table.size()) table.resize(pos + 1);
-    I(table[pos] == 0);
-    last_attr  = new Attr_data(lg->get_path(), get_filename(lg->get_lgid()));
-    table[pos] = last_attr;
+    std::call_once(registered, [] { Attribute_registry::add(&forget); });
+
+    std::unique_lock<std::shared_mutex> lock(table_mutex);
+    if (is_invalid(pos)) {  // Another thread may have created it
+      if (pos >= table.size()) table.resize(pos + 1);
+      table[pos] = create(lg);  // may throw, the cache stays invalid
+    }
+    last_attr  = table[pos];
+    last_lg    = lg;
+    last_epoch = cur_epoch;
   };
 
+  static bool is_cached(const LGraph *lg) {
+    return likely(lg == last_lg) && likely(last_epoch == epoch.load(std::memory_order_acquire));
+  }
+
+  static auto get_val(const Attr_data *data, const typename Attr_data::const_iterator &it) {
+    if constexpr (Attribute_is_bimap<Attr_data>::value) {
+      return data->get_val(it);
+    } else {
+      return data->get(it);
+    }
+  }
+
   static_assert(std::is_same<Base, Node_pin>::value || std::is_same<Base, Node>::value, "Base should be Node or Node_pin");
 
 public:
   static Attr_data *ref(const Base &obj) {
-    if (unlikely(obj.get_top_lgraph() != last_lg)) setup_table(obj.get_top_lgraph());
+    if (unlikely(!is_cached(obj.get_top_lgraph()))) setup_table(obj.get_top_lgraph());
     return last_attr;
   }
   static Attr_data *ref(const LGraph *lg) {
-    if (unlikely(lg != last_lg)) setup_table(lg);
+    if (unlikely(!is_cached(lg))) setup_table(lg);
     return last_attr;
   }
 
   static void clear(const LGraph *lg) {
-    setup_table(lg);
-
     size_t pos = lg->get_lgid().value;
+
+    std::unique_lock<std::shared_mutex> lock(table_mutex);
+    epoch.fetch_add(1, std::memory_order_acq_rel);  // Invalidate the cache in all the threads
+
+    if (pos >= table.size()) table.resize(pos + 1);
+    if (table[pos] == nullptr) {
+      if constexpr (Attribute_uses_str_pool<Attr_data>::value) {
+        if (is_old_str_format(lg)) remove_old_str_format(lg);  // clear is how an old lgdb is regenerated
+      }
+      table[pos] = create(lg);  // to remove files
+    }
+
     table[pos]->clear();
     delete table[pos];
     table[pos] = nullptr;
@@ -62,4 +180,59 @@ public:
     last_lg   = nullptr;
     last_attr = nullptr;
   }
+
+  // Drop the loaded table, the files stay. Needed when the lgraph files are replaced on disk (see Attribute_registry)
+  static void forget(Lg_type_id lgid) {
+    size_t pos = lgid.value;
+
+    std::unique_lock<std::shared_mutex> lock(table_mutex);
+    epoch.fetch_add(1, std::memory_order_acq_rel);
+
+    if (pos < table.size() && table[pos]) {
+      delete table[pos];
+      table[pos] = nullptr;
+    }
+
+    last_lg   = nullptr;
+    last_attr = nullptr;
+  }
+
+  // Copy of all the entries with the keys rewritten by key_fn. remap_insert adds them back (after a clear)
+  template <typename Fn>
+  static auto remap_extract(const LGraph *lg, Fn key_fn) {
+    const Attr_data *cdata = ref(lg);
+
+    using Key      = decltype(cdata->get_key(cdata->begin()));
+    using Val      = decltype(get_val(cdata, cdata->begin()));
+    using Val_copy = std::conditional_t<std::is_same_v<Val, std::string_view>, std::string, Val>;  // clear invalidates sviews
+
+    std::vector<std::pair<Key, Val_copy>> entries;
+    entries.reserve(cdata->size());
+    for (auto it = cdata->begin(); it != cdata->end(); ++it) {
+      entries.emplace_back(key_fn(cdata->get_key(it)), Val_copy(get_val(cdata, it)));
+    }
+
+    return entries;
+  }
+
+  // Invalid keys are dropped
+  template <typename Entries>
+  static void remap_insert(const LGraph *lg, const Entries &entries) {
+    Attr_data *data = ref(lg);
+
+    using Val = decltype(get_val(data, data->cbegin()));
+
+    for (const auto &[key, val] : entries) {
+      if (key.is_invalid()) continue;
+      data->set(key, Val(val));
+    }
+  }
+
+  // Rewrite all the keys (LGraph::compact renumbers nodes). Invalid new keys are dropped
+  template <typename Fn>
+  static void remap(const LGraph *lg, Fn key_fn) {
+    auto entries = remap_extract(lg, key_fn);
+    ref(lg)->clear();
+    remap_insert(lg, entries);
+  }
 };
@@ -9,16 +9,23 @@
 #ifdef __APPLE__
 #include <copyfile.h>
 #else
+#include <linux/fs.h>
+#include <sys/ioctl.h>
 #include <sys/sendfile.h>
 #endif
 
+#include <algorithm>
 #include <cassert>
+#include <cctype>
 #include <fstream>
 #include <regex>
 #include <set>
 
+#include "absl/strings/match.h"
+#include "attribute.hpp"
 #include "fmt/format.h"
 #include "lgraph.hpp"
+#include "mmap_gc.hpp"
 #include "rapidjson/document.h"
 #include "rapidjson/error/en.h"
 #include "rapidjson/filereadstream.h"
@@ -363,33 +370,117 @@ void Graph_library::expunge(std::string_view name) {
   auto id = it2->second;
 
   attributes[id].expunge();
+  Attribute_registry::forget(id);  // the files go away, and the lgid may be recycled
   recycle_id(id);
 
-  DIR *dr = opendir(path.c_str());
+  for (const auto &fname : get_lgraph_files(path, id)) {
+    std::string file = absl::StrCat(path, "/", fname);
+    fmt::print("deleting... {}\n", file);
+    unlink(file.c_str());
+  }
+
+  name2id.erase(it2);
+  graph_library_clean = false;
+
+  sub_nodes[id].expunge();  // Nuke IO and contents, but keep around lgid
+}
+
+void Graph_library::clear(Lg_type_id lgid) {
+  I(lgid < attributes.size());
+
+  sub_nodes[lgid].reset_pins();
+}
+
+std::vector<std::string> Graph_library::get_lgraph_files(std::string_view path, Lg_type_id lgid) {
+  std::vector<std::string> files;
+
+  DIR *dr = opendir(std::string(path).c_str());
   if (dr == NULL) {
     LGraph::error("graph_library: unable to access path {}", path);
-    return;
+    return files;
   }
 
+  auto id = std::to_string(lgid);
+
+  auto match = [&id](std::string_view fname) {
+    if (absl::StartsWith(fname, absl::StrCat("lg_", id, "_"))) return true;
+    for (std::string_view prefix : {"lg_data_node", "lg_data_npin"}) {
+      if (!absl::StartsWith(fname, prefix)) continue;
+      auto rest = fname.substr(prefix.size());
+      return absl::StartsWith(rest, id) && rest.size() > id.size() && !std::isdigit(rest[id.size()]);
+    }
+    return false;
+  };
+
   struct dirent *de;  // Pointer for directory entry
-  std::string    match = absl::StrCat("lgraph_", std::to_string(id));
   while ((de = readdir(dr)) != NULL) {
-    std::string chop_name(de->d_name, match.size());
-    if (chop_name == match) {
-      std::string file = absl::StrCat(path, "/", de->d_name);
-      fmt::print("deleting... {}\n", file);
-      unlink(file.c_str());
-    }
+    if (match(de->d_name)) files.emplace_back(de->d_name);
   }
   closedir(dr);
 
-  sub_nodes[id].expunge();  // Nuke IO and contents, but keep around lgid
+  std::sort(files.begin(), files.end());
+
+  return files;
 }
 
-void Graph_library::clear(Lg_type_id lgid) {
-  I(lgid < attributes.size());
+bool Graph_library::clone_file(const std::string &src, const std::string &dst) {
+  int source = open(src.c_str(), O_RDONLY, 0);
+  if (source < 0) return false;
+  int dest = open(dst.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (dest < 0) {
+    close(source);
+    return false;
+  }
 
-  sub_nodes[lgid].reset_pins();
+  bool reflink = false;
+#ifdef __APPLE__
+  fcopyfile(source, dest, nullptr, COPYFILE_DATA);
+#else
+  // struct required, rationale: function stat() exists also
+  struct stat stat_source;
+  fstat(source, &stat_source);
+
+#ifdef FICLONE
+  reflink = ioctl(dest, FICLONE, source) == 0;  // btrfs, xfs: shares the extents, copy on write
+#endif
+  if (!reflink) {
+    off_t offset = 0;
+    while (offset < stat_source.st_size) {
+      auto sz = sendfile(dest, source, &offset, stat_source.st_size - offset);
+      if (sz <= 0) break;
+    }
+  }
+#endif
+
+  close(source);
+  close(dest);
+
+  return reflink;
+}
+
+// Returns the number of files shared with reflink (the rest were copied)
+int Graph_library::clone_lgraph_files(Lg_type_id id_orig, Lg_type_id id_new) {
+  auto orig = std::to_string(id_orig);
+  auto repl = std::to_string(id_new);
+
+  mmap_lib::mmap_gc::run_flush_hooks();  // complete the files of maps in the middle of a rehash
+
+  int n_reflink = 0;
+  for (const auto &fname : get_lgraph_files(path, id_orig)) {
+    // The lgid follows lg_ or lg_data_node/lg_data_npin
+    auto pos = absl::StartsWith(fname, "lg_data_") ? std::string_view("lg_data_node").size() : std::string_view("lg_").size();
+    I(fname.compare(pos, orig.size(), orig) == 0);
+
+    auto new_fname = absl::StrCat(fname.substr(0, pos), repl, fname.substr(pos + orig.size()));
+
+    auto file     = absl::StrCat(path, "/", fname);
+    auto new_file = absl::StrCat(path, "/", new_fname);
+
+    fmt::print("copying... {} to {}\n", file, new_file);
+    if (clone_file(file, new_file)) n_reflink++;
+  }
+
+  return n_reflink;
 }
 
 Lg_type_id Graph_library::copy_lgraph(std::string_view name, std::string_view new_name) {
@@ -406,50 +497,108 @@ Lg_type_id Graph_library::copy_lgraph(std::string_view name, std::string_view ne
   Lg_type_id id_new = reset_id(new_name, attributes[id_orig].source);
 
   attributes[id_new] = attributes[id_orig];
+  attributes[id_new].lg = nullptr;  // not open
 
-  DIR *dr = opendir(path.c_str());
-  if (dr == NULL) {
-    LGraph::error("graph_library: unable to access path {}", path);
-    return false;
+  clone_lgraph_files(id_orig, id_new);
+
+  clean_library();
+
+  return id_new;
+}
+
+Lg_type_id Graph_library::snapshot_lgraph(std::string_view name, std::string_view snap_name) {
+  const auto &it = name2id.find(name);
+  if (it == name2id.end()) {
+    LGraph::error("graph_library: snapshot of {} that does not exist", name);
+    return 0;
   }
+  auto id_orig = it->second;
 
-  struct dirent *de;  // Pointer for directory entry
-  std::string    match   = absl::StrCat("lgraph_", std::to_string(id_orig));
-  std::string    rematch = absl::StrCat("lgraph_", std::to_string(id_new));
-  while ((de = readdir(dr)) != NULL) {
-    std::string chop_name(de->d_name, match.size());
-    if (chop_name == match) {
-      std::string_view dname(de->d_name);
-      std::string      file      = absl::StrCat(path, "/", dname);
-      std::string_view extension = dname.substr(match.size());
+  auto it2 = global_name2lgraph[path].find(name);
+  if (it2 != global_name2lgraph[path].end()) {
+    it2->second->sync();
+  }
 
-      auto new_file = absl::StrCat(path, "/", rematch, extension);
+  graph_library_clean = false;
 
-      fmt::print("copying... {} to {}\n", file, new_file);
+  Lg_type_id id_snap = reset_id(snap_name, attributes[id_orig].source);
 
-      int source = open(file.c_str(), O_RDONLY, 0);
-      int dest   = open(new_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  attributes[id_snap].source = attributes[id_orig].source;
+  sub_nodes[id_snap].copy_pins(sub_nodes[id_orig]);
 
-#ifdef __APPLE__
-      fcopyfile(dest, source, nullptr, COPYFILE_DATA);
-#else
-      // struct required, rationale: function stat() exists also
-      struct stat stat_source;
-      fstat(source, &stat_source);
+  auto n_reflink = clone_lgraph_files(id_orig, id_snap);
+  auto n_files   = get_lgraph_files(path, id_snap).size();
+  if (n_reflink < static_cast<int>(n_files)) {
+    LGraph::warn("snapshot {} of {}: {} of {} files copied (no reflink support in {})", snap_name, name, n_files - n_reflink,
+                 n_files, path);
+  }
 
-      sendfile(dest, source, nullptr, stat_source.st_size);
-#endif
+  clean_library();
+
+  return id_snap;
+}
 
-      close(source);
-      close(dest);
+bool Graph_library::commit_snapshot(std::string_view snap_name, std::string_view name) {
+  const auto &it_snap = name2id.find(snap_name);
+  const auto &it_orig = name2id.find(name);
+  if (it_snap == name2id.end() || it_orig == name2id.end()) {
+    LGraph::error("graph_library: commit snapshot {} to {}, missing lgraph", snap_name, name);
+    return false;
+  }
+  Lg_type_id id_snap = it_snap->second;
+  Lg_type_id id_orig = it_orig->second;
+
+  for (auto id : {id_snap, id_orig}) {
+    if (attributes[id].lg) delete attributes[id].lg;  // sync and unregister
+    I(attributes[id].lg == nullptr);
+  }
+
+  // Loaded attributes map the files about to be replaced
+  Attribute_registry::forget(id_orig);
+  Attribute_registry::forget(id_snap);
+
+  auto orig = std::to_string(id_orig);
+  auto snap = std::to_string(id_snap);
+
+  // rename over the originals first (atomic per file, keeps the shared extents). A crash in the middle leaves each
+  // file old or new, never missing
+  absl::flat_hash_set<std::string> replaced;
+  for (const auto &fname : get_lgraph_files(path, id_snap)) {
+    auto pos = absl::StartsWith(fname, "lg_data_") ? std::string_view("lg_data_node").size() : std::string_view("lg_").size();
+    auto new_fname = absl::StrCat(fname.substr(0, pos), orig, fname.substr(pos + snap.size()));
+
+    if (rename(absl::StrCat(path, "/", fname).c_str(), absl::StrCat(path, "/", new_fname).c_str()) != 0) {
+      LGraph::error("graph_library: commit snapshot {} to {}, unable to rename {}", snap_name, name, fname);
+      return false;
     }
+    replaced.insert(new_fname);
   }
 
-  closedir(dr);
+  // then the original files that the snapshot does not have (e.g: an attribute cleared in the snapshot)
+  for (const auto &fname : get_lgraph_files(path, id_orig)) {
+    if (!replaced.contains(fname)) unlink(absl::StrCat(path, "/", fname).c_str());
+  }
+
+  graph_library_clean = false;
+  sub_nodes[id_orig].copy_pins(sub_nodes[id_snap]);
+  update(id_orig);
+
+  expunge(snap_name);  // no files left
 
   clean_library();
 
-  return id_new;
+  return true;
+}
+
+void Graph_library::discard_snapshot(std::string_view snap_name) {
+  const auto &it = name2id.find(snap_name);
+  if (it == name2id.end()) return;
+  Lg_type_id id_snap = it->second;
+
+  if (attributes[id_snap].lg) delete attributes[id_snap].lg;
+
+  expunge(snap_name);
+  clean_library();
 }
 
 Lg_type_id Graph_library::register_lgraph(std::string_view name, std::string_view source, LGraph *lg) {
@@ -503,6 +652,18 @@ void Graph_library::sync_all() {
   }
 }
 
+void Graph_library::checkpoint_all() {
+  sync_all();
+
+  // Small files, fsync in foreground
+  for (auto &it : global_instances) {
+    int fd = open(it.second->library_file.c_str(), O_RDONLY);
+    if (fd < 0) continue;
+    fsync(fd);
+    close(fd);
+  }
+}
+
 void Graph_library::clean_library() {
   if (graph_library_clean) return;
 
@@ -79,6 +79,9 @@ protected:
 
   static std::string get_lgraph_filename(std::string_view path, std::string_view name, std::string_view ext);
 
+  static bool clone_file(const std::string &src, const std::string &dst);
+  int         clone_lgraph_files(Lg_type_id id_orig, Lg_type_id id_new);
+
 public:
   Graph_library(const Graph_library &s) = delete;
   Graph_library &operator=(const Graph_library &) = delete;
@@ -177,6 +180,17 @@ public:
   // deprecated bool expunge_lgraph(std::string_view name, LGraph *lg);
 
   Lg_type_id copy_lgraph(std::string_view name, std::string_view new_name);
+
+  // Copy-on-write snapshot (reflink when the filesystem supports it, a plain copy otherwise). A pass works on the
+  // snapshot, then commit_snapshot moves it over the original lgid (parents keep their references) or
+  // discard_snapshot drops it. Commit closes the open instances of both (their LGraph pointers become invalid).
+  Lg_type_id snapshot_lgraph(std::string_view name, std::string_view snap_name);
+  bool       commit_snapshot(std::string_view snap_name, std::string_view name);
+  void       discard_snapshot(std::string_view snap_name);
+
+  // mmap files of an lgraph: lg_<lgid>_xxx (nodes, const, subid, lut, str_pool) and lg_data_{node,npin}<lgid><attr>
+  static std::vector<std::string> get_lgraph_files(std::string_view path, Lg_type_id lgid);
+
   Lg_type_id register_sub(std::string_view name);
   Lg_type_id register_lgraph(std::string_view name, std::string_view source, LGraph *lg);
   void       unregister(std::string_view name, Lg_type_id lgid, LGraph *lg = 0);  // unregister open instance
@@ -187,6 +201,7 @@ public:
   void sync() { clean_library(); }
 
   static void sync_all();  // Called when running out of mmaps
+  static void checkpoint_all();  // sync_all, and the graph_library files on disk (the mmaps: mmap_gc::checkpoint)
 
   absl::Span<const Sub_node> get_sub_nodes() const {
     I(sub_nodes.size() >= 1);
@@ -89,6 +89,7 @@ class LGraph;
 class __attribute__((packed)) Edge_raw {  // 3 bytes total
 protected:
   friend class LGraph;
+  friend class LGraph_csr;
   friend class Node_Internal;
   friend class Node_pin;
 
@@ -80,9 +80,9 @@ void Fwd_edge_iterator::Fwd_iter::topo_add_chain_down(const Node_pin &dst_pin) {
 
 void Fwd_edge_iterator::Fwd_iter::topo_add_chain_fwd(const Node_pin &dst_pin) {
   const auto dst_node = dst_pin.get_node();
-  if (visited.count(dst_node.get_compact())) return;
-  if (pending_stack_set.contains(dst_node.get_compact())) return;
-  pending_stack_set.insert(dst_node.get_compact());
+  if (visited.contains(dst_node)) return;
+  if (pending_stack_set.contains(dst_node)) return;
+  pending_stack_set.insert(dst_node);
 
   if (visit_sub) {
     if (dst_node.is_type_sub_present()) {  // DOWN??
@@ -137,7 +137,7 @@ void Fwd_edge_iterator::Fwd_iter::fwd_get_from_linear(LGraph *top) {
         // NOTE: For hierarchical, if the driver_node is an IO (input). It
         // could try to go up to see if the node is pipelined or not visited
 
-        if (!visited.count(driver_node.get_compact())) {  // fwd
+        if (!visited.contains(driver_node)) {  // fwd
           is_topo_sorted = false;
           break;
         }
@@ -146,7 +146,7 @@ void Fwd_edge_iterator::Fwd_iter::fwd_get_from_linear(LGraph *top) {
 
 
     if (is_topo_sorted) {
-      visited.insert(next_node.get_compact());
+      visited.insert(next_node);
       current_node.update(next_node);
       return;
     }
@@ -164,9 +164,9 @@ void Fwd_edge_iterator::Fwd_iter::fwd_get_from_pending() {
       }
 
 #if 1
-      if (visited.count(node.get_compact())) {
+      if (visited.contains(node)) {
         pending_stack.pop_back();
-        pending_stack_set.erase(node.get_compact());
+        pending_stack_set.erase(node);
         continue;
       }
 #endif
@@ -194,9 +194,9 @@ void Fwd_edge_iterator::Fwd_iter::fwd_get_from_pending() {
       }
 
       if (pending_stack.back() != node) continue;
-      visited.insert(node.get_compact());
+      visited.insert(node);
       pending_stack.pop_back();
-      pending_stack_set.erase(node.get_compact());
+      pending_stack_set.erase(node);
 
       if (can_be_visited) {
         I(node.get_class_lgraph()->is_valid_node(node.get_nid()));
@@ -211,13 +211,14 @@ void Fwd_edge_iterator::Fwd_iter::fwd_get_from_pending() {
       return;
     }
 
-    I(!(*global_it).is_graph_io());  // NOTE: should we propagate IO for going up?
-    if (!visited.count((*global_it).get_compact())) {
-      if (!pending_stack_set.contains((*global_it).get_compact())) {
-        pending_stack_set.insert((*global_it).get_compact());
-        pending_stack.push_back(*global_it);
-        for (auto &edge2 : (*global_it).inp_edges()) {  // fwd
-          // fmt::print("chain  {} from {}\n",edge2.driver.get_node().debug_name(), (*global_it).debug_name());
+    const auto global_node = *global_it;
+    I(!global_node.is_graph_io());  // NOTE: should we propagate IO for going up?
+    if (!visited.contains(global_node)) {
+      if (!pending_stack_set.contains(global_node)) {
+        pending_stack_set.insert(global_node);
+        pending_stack.push_back(global_node);
+        for (auto &edge2 : global_node.inp_edges()) {  // fwd
+          // fmt::print("chain  {} from {}\n",edge2.driver.get_node().debug_name(), global_node.debug_name());
           topo_add_chain_fwd(edge2.driver);
         }
       }
@@ -266,3 +267,67 @@ void Bwd_edge_iterator::Bwd_iter::bwd_first(LGraph *lg) {
 void Bwd_edge_iterator::Bwd_iter::bwd_next() {
   I(false);  // FIXME: forward works, now do backward
 }
+
+int Fwd_levels::get_driver_level(const Node_pin &driver_pin, const absl::flat_hash_map<Node::Compact, int> &node2level) const {
+  const auto driver_node = driver_pin.get_node();
+
+  if (visit_sub) {
+    if (driver_node.is_type_sub_present()) {  // DOWN: the driver is the graph output inside the sub
+      auto down_pin = driver_pin.get_down_pin();
+      int  level    = -1;
+      for (auto &edge : down_pin.inp_edges()) {
+        level = std::max(level, get_driver_level(edge.driver, node2level));
+      }
+      return level;
+    } else if (driver_node.is_graph_input() && !driver_node.is_root()) {  // UP: the driver is in the parent
+      auto up_pin = driver_pin.get_up_pin();
+      if (up_pin.is_invalid()) return -1;  // Pin is not connected
+
+      int level = -1;
+      for (auto &edge : up_pin.inp_edges()) {
+        level = std::max(level, get_driver_level(edge.driver, node2level));
+      }
+      return level;
+    }
+  }
+
+  if (driver_node.is_graph_io()) return -1;
+
+  const auto it = node2level.find(driver_node.get_compact());
+  if (it == node2level.end()) return -1;  // Not visited yet: loop broken by forward()
+
+  return it->second;
+}
+
+Fwd_levels::Fwd_levels(LGraph *lg, bool _visit_sub) : visit_sub(_visit_sub) {
+  absl::flat_hash_map<Node::Compact, int> node2level;
+  std::vector<uint32_t>                   level_size;
+
+  // 1st: forward() handles loop breakers and hierarchy, so the drivers already visited are the only constraints
+  for (auto node : lg->forward(visit_sub)) {
+    int level = 0;
+    for (auto &edge : node.inp_edges()) {
+      level = std::max(level, get_driver_level(edge.driver, node2level) + 1);
+    }
+
+    node2level[node.get_compact()] = level;
+    nodes.emplace_back(node);
+
+    if (level_size.size() <= static_cast<size_t>(level)) level_size.resize(level + 1, 0);
+    level_size[level]++;
+  }
+
+  // 2nd: bucket sort the nodes so that each level is contiguous
+  level_start.resize(level_size.size() + 1);
+  level_start[0] = 0;
+  for (size_t i = 0; i < level_size.size(); ++i) {
+    level_start[i + 1] = level_start[i] + level_size[i];
+  }
+
+  std::vector<uint32_t> insert_pos(level_start.begin(), level_start.end() - 1);
+  std::vector<Node>     sorted(nodes.size());
+  for (const auto &node : nodes) {
+    sorted[insert_pos[node2level[node.get_compact()]]++] = node;
+  }
+  nodes.swap(sorted);
+}
@@ -1,6 +1,8 @@
 //  This file is distributed under the BSD 3-Clause License. See LICENSE for details.
 #pragma once
 
+#include "absl/types/span.h"
+
 #include "lgedge.hpp"
 #include "lgraph.hpp"
 
@@ -62,16 +64,81 @@ public:
 };
 
 class Flow_base_iterator {
+public:
+  // Dense bitmap indexed by nid. Each hierarchy instance (hidx) has its own
+  // bitmap, so non-hierarchical traversals only touch the root one.
+  class Node_set {
+  protected:
+    std::vector<uint64_t>                           root_bits;
+    std::vector<std::vector<std::vector<uint64_t>>> sub_bits;  // [level-1][pos]
+    size_t                                          nentries;
+
+    const std::vector<uint64_t> *find_bits(const Hierarchy_index &hidx) const {
+      if (likely(hidx.level == 0)) return &root_bits;
+      if (static_cast<size_t>(hidx.level) > sub_bits.size()) return nullptr;
+      const auto &level_bits = sub_bits[hidx.level - 1];
+      if (static_cast<size_t>(hidx.pos) >= level_bits.size()) return nullptr;
+      return &level_bits[hidx.pos];
+    }
+
+    std::vector<uint64_t> &ref_bits(const Node &node) {
+      std::vector<uint64_t> *bits;
+      if (likely(node.hidx.level == 0)) {
+        bits = &root_bits;
+      } else {
+        if (static_cast<size_t>(node.hidx.level) > sub_bits.size()) sub_bits.resize(node.hidx.level);
+        auto &level_bits = sub_bits[node.hidx.level - 1];
+        if (static_cast<size_t>(node.hidx.pos) >= level_bits.size()) level_bits.resize(node.hidx.pos + 1);
+        bits = &level_bits[node.hidx.pos];
+      }
+
+      if (unlikely((node.nid >> 6) >= bits->size())) {
+        // Nodes can be created during the iteration, so size for whatever is larger
+        size_t sz = std::max<size_t>(node.current_g->size(), node.nid + 1);
+        bits->resize((sz + 63) >> 6, 0);
+      }
+      return *bits;
+    }
+
+  public:
+    Node_set() : nentries(0) {}
+
+    bool contains(const Node &node) const {
+      const auto *bits = find_bits(node.hidx);
+      if (bits == nullptr || (node.nid >> 6) >= bits->size()) return false;
+      return ((*bits)[node.nid >> 6] >> (node.nid & 63)) & 1;
+    }
+
+    void insert(const Node &node) {
+      auto &   bits = ref_bits(node);
+      uint64_t mask = 1ULL << (node.nid & 63);
+      nentries += (bits[node.nid >> 6] & mask) == 0;
+      bits[node.nid >> 6] |= mask;
+    }
+
+    void erase(const Node &node) {
+      const auto *cbits = find_bits(node.hidx);
+      if (cbits == nullptr || (node.nid >> 6) >= cbits->size()) return;
+      auto &   bits = *const_cast<std::vector<uint64_t> *>(cbits);
+      uint64_t mask = 1ULL << (node.nid & 63);
+      nentries -= (bits[node.nid >> 6] & mask) != 0;
+      bits[node.nid >> 6] &= ~mask;
+    }
+
+    bool   empty() const { return nentries == 0; }
+    size_t size() const { return nentries; }
+  };
+
 protected:
   bool                          linear_phase;
   Node                          current_node;
   Fast_edge_iterator::Fast_iter global_it;
 
   // State built during iteration
-  const bool                         visit_sub;
-  absl::flat_hash_set<Node::Compact> visited;
-  std::vector<Node>                  pending_stack;
-  absl::flat_hash_set<Node::Compact> pending_stack_set; // to break comb loops
+  const bool        visit_sub;
+  Node_set          visited;
+  std::vector<Node> pending_stack;
+  Node_set          pending_stack_set;  // to break comb loops
 
   Flow_base_iterator(LGraph *lg, bool _visit_sub);
   Flow_base_iterator(bool _visit_sub);
@@ -124,6 +191,34 @@ public:
   Fwd_iter end() const { return Fwd_iter(visit_sub); }
 };
 
+// Topological levels (wavefronts) of an LGraph computed once. All the
+// drivers of a node visited before it by forward() are in a lower level, so
+// the nodes in the same level can be processed in parallel. Visiting the
+// levels in reverse order is a valid backward traversal.
+class Fwd_levels {
+protected:
+  const bool            visit_sub;
+  std::vector<Node>     nodes;        // sorted by level
+  std::vector<uint32_t> level_start;  // level i is [level_start[i], level_start[i+1])
+
+  int get_driver_level(const Node_pin &driver_pin, const absl::flat_hash_map<Node::Compact, int> &node2level) const;
+
+public:
+  Fwd_levels() = delete;
+  explicit Fwd_levels(LGraph *lg, bool visit_sub);
+
+  size_t size() const { return level_start.size() - 1; }  // number of levels
+  bool   empty() const { return nodes.empty(); }
+  size_t get_num_nodes() const { return nodes.size(); }
+
+  absl::Span<const Node> get_level(size_t level) const {
+    I(level < size());
+    return absl::MakeConstSpan(nodes).subspan(level_start[level], level_start[level + 1] - level_start[level]);
+  }
+
+  absl::Span<const Node> get_nodes() const { return absl::MakeConstSpan(nodes); }
+};
+
 class Bwd_edge_iterator {
 public:
   class Bwd_iter : public Flow_base_iterator {
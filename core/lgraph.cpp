@@ -3,10 +3,13 @@
 #include "lgraph.hpp"
 
 #include <dirent.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 
 #include <fstream>
 #include <iostream>
+#include <map>
+#include <numeric>
 #include <set>
 
 #include "annotate.hpp"
@@ -824,12 +827,364 @@ const Sub_node &LGraph::get_self_sub_node() const { return library->get_sub(get_
 
 Sub_node *LGraph::ref_self_sub_node() { return library->ref_sub(get_lgid()); }
 
+void LGraph::add_edges(absl::Span<const std::pair<Node_pin, Node_pin>> edges) {
+  std::vector<Edge_batch_entry> batch;
+  batch.reserve(edges.size());
+
+  for (const auto &[dpin, spin] : edges) {
+    I(dpin.is_driver());
+    I(spin.is_sink());
+    I(spin.get_class_lgraph() == this);
+    I(dpin.get_class_lgraph() == this);
+    // Do not loop back unless pipelined or subgraph
+    GI(!spin.is_graph_io() && !dpin.is_graph_io() && dpin.get_node().get_nid() == spin.get_node().get_nid(),
+       dpin.get_node().get_type().is_pipelined());
+
+    batch.emplace_back(Edge_batch_entry{dpin.get_idx(), spin.get_idx(), dpin.get_pid(), spin.get_pid()});
+  }
+
+  add_edges_int(batch);
+}
+
 Fwd_edge_iterator LGraph::forward(bool visit_sub) { return Fwd_edge_iterator(this, visit_sub); }
 Bwd_edge_iterator LGraph::backward(bool visit_sub) { return Bwd_edge_iterator(this, visit_sub); }
 
 // Skip after 1, but first may be deleted, so fast_next
 Fast_edge_iterator LGraph::fast(bool visit_sub) { return Fast_edge_iterator(this, visit_sub); }
 
+Fwd_levels LGraph::forward_levels(bool visit_sub) { return Fwd_levels(this, visit_sub); }
+
+LGraph_csr LGraph::freeze() { return LGraph_csr(this); }
+
+void LGraph::compact(Compact_order order) {
+  struct Compact_pin {
+    Index_ID old_idx;
+    Port_ID  pid;
+    uint32_t bits;
+    bool     driver;
+    bool     sink;
+  };
+  struct Compact_entry {
+    Index_ID                 old_nid;
+    Node_Type_Op             op;
+    Lconst                   value;  // Const_Op value or LUT_Op table
+    Lg_type_id               sub_lgid;
+    std::vector<Compact_pin> pins;
+  };
+  struct Compact_edge {
+    Index_ID driver_idx;
+    Index_ID sink_idx;
+    Index_ID driver_nid;
+    Index_ID sink_nid;
+  };
+
+  // 1st: snapshot nodes in forward order (graph IO first to keep the hardcoded nids)
+
+  std::vector<Compact_entry>   entries;
+  std::vector<Compact_edge>    edges;
+  absl::flat_hash_set<uint32_t>  visited;
+
+  auto snapshot = [&](const Node &node) {
+    auto nid = node.get_nid();
+    if (visited.contains(nid)) return;
+    visited.insert(nid);
+
+    Compact_entry entry{nid, get_type_op(nid), Lconst(), Lg_type_id(), {}};
+    if (entry.op == Const_Op) {
+      entry.value = get_type_const(nid);
+    } else if (entry.op == LUT_Op) {
+      entry.value = get_type_lut(nid);
+    } else if (entry.op == SubGraph_Op) {
+      entry.sub_lgid = get_type_sub(nid);
+    }
+
+    for (const auto &dpin : out_setup_pins(node)) {
+      entry.pins.emplace_back(Compact_pin{dpin.get_idx(), dpin.get_pid(), get_bits(dpin.get_idx()), true, false});
+    }
+    for (const auto &spin : inp_setup_pins(node)) {
+      auto it = std::find_if(entry.pins.begin(), entry.pins.end(), [&spin](const Compact_pin &p) { return p.pid == spin.get_pid(); });
+      if (it == entry.pins.end()) {
+        entry.pins.emplace_back(Compact_pin{spin.get_idx(), spin.get_pid(), get_bits(spin.get_idx()), false, true});
+      } else {
+        I(it->old_idx == spin.get_idx());
+        it->sink = true;
+      }
+    }
+
+    for (const auto &e : out_edges(node)) {
+      edges.emplace_back(Compact_edge{e.driver.get_idx(), e.sink.get_idx(), nid, e.sink.get_node().get_nid()});
+    }
+
+    entries.emplace_back(std::move(entry));
+  };
+
+  snapshot(get_graph_input_node());
+  snapshot(get_graph_output_node());
+  for (const auto &node : forward()) {
+    snapshot(node);
+  }
+  for (const auto &node : fast()) {  // Nodes not reached by forward (unconnected loops)
+    snapshot(node);
+  }
+
+  if (order == Compact_order::Rcm) {
+    // BFS from the lowest degree nodes, neighbors by increasing degree, then reverse. IOs stay as nid 1 and 2
+    absl::flat_hash_map<uint32_t, size_t> nid2pos;
+    for (size_t i = 0; i < entries.size(); ++i) {
+      nid2pos[entries[i].old_nid] = i;
+    }
+
+    std::vector<std::vector<size_t>> adj(entries.size());
+    for (const auto &e : edges) {
+      auto d = nid2pos[e.driver_nid];
+      auto s = nid2pos[e.sink_nid];
+      if (d == s || d < 2 || s < 2) continue;
+      adj[d].emplace_back(s);
+      adj[s].emplace_back(d);
+    }
+    for (auto &a : adj) {
+      std::sort(a.begin(), a.end());
+      a.erase(std::unique(a.begin(), a.end()), a.end());
+    }
+    auto by_degree = [&adj](size_t a, size_t b) { return adj[a].size() < adj[b].size(); };
+    for (auto &a : adj) {
+      std::stable_sort(a.begin(), a.end(), by_degree);
+    }
+
+    std::vector<size_t> starts(entries.size() - 2);
+    std::iota(starts.begin(), starts.end(), 2);
+    std::stable_sort(starts.begin(), starts.end(), by_degree);
+
+    std::vector<bool>   done(entries.size(), false);
+    std::vector<size_t> rcm;  // also the BFS queue
+    rcm.reserve(entries.size());
+    for (auto start : starts) {
+      if (done[start]) continue;
+      done[start] = true;
+      auto head   = rcm.size();
+      rcm.emplace_back(start);
+      for (; head < rcm.size(); ++head) {
+        for (auto n : adj[rcm[head]]) {
+          if (done[n]) continue;
+          done[n] = true;
+          rcm.emplace_back(n);
+        }
+      }
+    }
+    I(rcm.size() + 2 == entries.size());
+
+    std::vector<Compact_entry> reordered;
+    reordered.reserve(entries.size());
+    reordered.emplace_back(std::move(entries[0]));
+    reordered.emplace_back(std::move(entries[1]));
+    for (auto it = rcm.rbegin(); it != rcm.rend(); ++it) {
+      reordered.emplace_back(std::move(entries[*it]));
+    }
+    entries.swap(reordered);
+  }
+
+  // 2nd: rebuild node_internal. The lgraph IOs (library sub_node) are not touched
+
+  LGraph_Node_Type::clear();
+  idx_insert_cache.clear();
+  node_internal.clear();
+
+  absl::flat_hash_map<uint32_t, Index_ID> idx_map;  // old pin idx (nid for pid 0) -> new idx
+  idx_map.reserve(entries.size());
+
+  // Both graph IO nids first, the input pin spaces would otherwise take the hardcoded output nid
+  auto io_inp = create_node_int();
+  auto io_out = create_node_int();
+  I(io_inp == Node::Hardcoded_input_nid && io_out == Node::Hardcoded_output_nid);
+
+  for (size_t i = 0; i < entries.size(); ++i) {
+    const auto &entry = entries[i];
+    auto        nid   = i == 0 ? io_inp : (i == 1 ? io_out : create_node_int());
+    if (entry.op == Const_Op) {
+      set_type_const(nid, entry.value);
+    } else if (entry.op == SubGraph_Op) {
+      // No set_type_sub: the tree_pos annotation is remapped below
+      subid_map.set(Node::Compact_class(nid), entry.sub_lgid.value);
+      node_internal.ref(nid)->set_type(SubGraph_Op);
+    } else {
+      set_type(nid, entry.op);
+      if (entry.op == LUT_Op) set_type_lut(nid, entry.value);
+    }
+    I(entry.old_nid != Node::Hardcoded_input_nid || nid == Node::Hardcoded_input_nid);
+    I(entry.old_nid != Node::Hardcoded_output_nid || nid == Node::Hardcoded_output_nid);
+
+    for (const auto &pin : entry.pins) {
+      auto idx = setup_idx_from_pid(nid, pin.pid);
+      if (pin.driver) setup_driver(idx);
+      if (pin.sink) setup_sink(idx);
+      set_bits(idx, pin.bits);
+      idx_map[pin.old_idx] = idx;
+    }
+    idx_map[entry.old_nid] = nid;
+  }
+
+  std::vector<Edge_batch_entry> batch;
+  batch.reserve(edges.size());
+  for (const auto &e : edges) {
+    I(idx_map.contains(e.driver_idx) && idx_map.contains(e.sink_idx));
+    auto driver_idx = idx_map[e.driver_idx];
+    auto sink_idx   = idx_map[e.sink_idx];
+    batch.emplace_back(Edge_batch_entry{driver_idx, sink_idx, get_dst_pid(driver_idx), get_dst_pid(sink_idx)});
+  }
+  add_edges_int(batch);
+
+  // 3rd: remap the annotations. Keys below the root are dropped: the htree is regenerated with the new nids, so
+  // their hidx may point to a different instance
+
+  Ann_support::remap(this, [&idx_map](auto key) {
+    using Key = decltype(key);
+
+    auto remap_idx = [&idx_map](Index_ID old_idx) -> Index_ID {
+      const auto it = idx_map.find(old_idx);
+      if (it == idx_map.end()) return 0;  // deleted entry, drop annotation
+      return it->second;
+    };
+
+    if constexpr (std::is_same_v<Key, Node::Compact_class>) {
+      key.nid = remap_idx(key.nid);
+    } else if constexpr (std::is_same_v<Key, Node::Compact>) {
+      key.nid = key.hidx.is_root() ? remap_idx(key.nid) : Index_ID(0);
+    } else if constexpr (std::is_same_v<Key, Node_pin::Compact_class_driver>) {
+      key.idx = remap_idx(key.idx);
+    } else if constexpr (std::is_same_v<Key, Node_pin::Compact_driver>) {
+      key.idx = key.hidx.is_root() ? remap_idx(key.idx) : Index_ID(0);
+    } else {
+      static_assert(std::is_same_v<Key, Node::Compact_class>, "unsupported annotation key");
+    }
+    return key;
+  });
+
+  htree.clear();  // up_nid changed, regenerate on demand
+}
+
+std::vector<std::pair<std::string, size_t>> LGraph::get_mmap_files() const {
+  std::vector<std::pair<std::string, size_t>> files;
+
+  for (const auto &fname : Graph_library::get_lgraph_files(path, lgid)) {
+    std::string file = absl::StrCat(path, "/", fname);
+    struct stat sb;
+    if (stat(file.c_str(), &sb) != 0) continue;
+    files.emplace_back(fname, sb.st_size);
+  }
+
+  return files;
+}
+
+void LGraph::dump_stats_json(rapidjson::PrettyWriter<rapidjson::StringBuffer> &writer) {
+  struct Module_stats {
+    LGraph_Base::Stats                          st;
+    std::vector<std::pair<std::string, size_t>> files;
+    size_t                                      bytes     = 0;
+    size_t                                      instances = 0;
+  };
+
+  auto write_stats = [&writer](const LGraph_Base::Stats &st, size_t bytes) {
+    writer.Key("nodes");
+    writer.Uint64(st.n_nodes);
+    writer.Key("pins");
+    writer.Uint64(st.n_pins);
+    writer.Key("short_edges");
+    writer.Uint64(st.n_short_edges);
+    writer.Key("long_edges");
+    writer.Uint64(st.n_long_edges);
+    writer.Key("entries");
+    writer.Uint64(st.n_entries);
+    writer.Key("overflow_entries");
+    writer.Uint64(st.n_used - st.n_pins);
+    writer.Key("pages");
+    writer.Uint64(st.n_pages);
+    writer.Key("overflow_pages");
+    writer.Uint64(st.n_overflow_pages);
+    writer.Key("invalid_entries");
+    writer.Uint64(st.get_invalid());
+    writer.Key("invalid_ratio");
+    writer.Double(st.get_invalid_ratio());
+    writer.Key("bytes");
+    writer.Uint64(bytes);
+  };
+
+  auto setup_module = [](LGraph *lg, Module_stats &ms) {
+    ms.st    = lg->get_stats();
+    ms.files = lg->get_mmap_files();
+    for (const auto &f : ms.files) ms.bytes += f.second;
+  };
+
+  // Memory is per module (class), instances only tell how often it is used
+  std::map<uint32_t, Module_stats> modules;
+  ref_htree()->each_top_down_fast([this, &modules, &setup_module](const Hierarchy_index &hidx, const Hierarchy_data &data) {
+    (void)hidx;
+    auto it = modules.find(data.lgid.value);
+    if (it == modules.end()) {
+      auto *lg = data.lgid == lgid ? this : LGraph::open(path, data.lgid);
+      if (lg == nullptr) return;  // black box, no lgraph
+      it = modules.emplace(data.lgid.value, Module_stats()).first;
+      setup_module(lg, it->second);
+    }
+    it->second.instances++;
+  });
+
+  writer.StartObject();
+
+  writer.Key("name");
+  writer.String(name.c_str());
+  writer.Key("lgid");
+  writer.Uint64(lgid);
+
+  I(modules.find(lgid.value) != modules.end());
+  const auto &self = modules[lgid.value];
+  write_stats(self.st, self.bytes);
+
+  writer.Key("files");
+  writer.StartObject();
+  for (const auto &[file, bytes] : self.files) {
+    writer.Key(file.c_str());
+    writer.Uint64(bytes);
+  }
+  writer.EndObject();
+
+  LGraph_Base::Stats total;
+  size_t             total_bytes = 0;
+
+  writer.Key("modules");
+  writer.StartArray();
+  for (const auto &[id, ms] : modules) {
+    total.n_entries += ms.st.n_entries;
+    total.n_nodes += ms.st.n_nodes;
+    total.n_pins += ms.st.n_pins;
+    total.n_used += ms.st.n_used;
+    total.n_pages += ms.st.n_pages;
+    total.n_overflow_pages += ms.st.n_overflow_pages;
+    total.n_short_edges += ms.st.n_short_edges;
+    total.n_long_edges += ms.st.n_long_edges;
+    total_bytes += ms.bytes;
+
+    if (id == lgid.value) continue;
+
+    writer.StartObject();
+    writer.Key("name");
+    writer.String(std::string(library->get_name(Lg_type_id(id))).c_str());
+    writer.Key("lgid");
+    writer.Uint64(id);
+    writer.Key("instances");
+    writer.Uint64(ms.instances);
+    write_stats(ms.st, ms.bytes);
+    writer.EndObject();
+  }
+  writer.EndArray();
+
+  writer.Key("hierarchy");  // unique modules, including this one
+  writer.StartObject();
+  write_stats(total, total_bytes);
+  writer.EndObject();
+
+  writer.EndObject();
+}
+
 void LGraph::dump() {
   fmt::print("lgraph name:{} size:{}\n", name, node_internal.size());
 
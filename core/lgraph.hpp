@@ -2,10 +2,12 @@
 #pragma once
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/types/span.h"
 #include "edge.hpp"
 #include "graph_library.hpp"
 #include "hierarchy.hpp"
 #include "lgedge.hpp"
+#include "lgraph_csr.hpp"
 #include "lgraphbase.hpp"
 #include "node.hpp"
 #include "node_pin.hpp"
@@ -21,6 +23,7 @@ protected:
   friend class Fwd_edge_iterator;
   friend class Bwd_edge_iterator;
   friend class Fast_edge_iterator;
+  friend class LGraph_csr;
 
   Hierarchy_tree htree;
 
@@ -192,10 +195,24 @@ public:
     return idx;
   }
 
+  // Bulk insert: faster than add_edge when the fanin/fanout of pins is known
+  void add_edges(absl::Span<const std::pair<Node_pin, Node_pin>> edges);
+
   Fwd_edge_iterator  forward(bool visit_sub = false);
   Bwd_edge_iterator  backward(bool visit_sub = false);
   Fast_edge_iterator fast(bool visit_sub = false);
 
+  Fwd_levels forward_levels(bool visit_sub = false);  // forward() grouped in levels for parallel passes
+
+  LGraph_csr freeze();  // Read-only CSR snapshot, invalid after any LGraph change
+
+  // Forward: topological order. Rcm: reverse Cuthill-McKee, connected nodes get close nids (more SEdges)
+  enum class Compact_order { Forward, Rcm };
+
+  // Renumber nodes, drop deleted entries, and remap the annotations.
+  // WARNING: all the Node/Node_pin/XEdge (and hierarchy) handles are invalid after compact
+  void compact(Compact_order order = Compact_order::Forward);
+
   LGraph *clone_skeleton(std::string_view extended_name);
 
   static bool    exists(std::string_view path, std::string_view name);
@@ -224,6 +241,9 @@ public:
   Sub_node *      ref_self_sub_node();        // Access all input/outputs
 
   void dump();
+  void dump_stats_json(rapidjson::PrettyWriter<rapidjson::StringBuffer> &writer);  // this module and its hierarchy
+
+  std::vector<std::pair<std::string, size_t>> get_mmap_files() const;  // {file, bytes} for nodes, types, and annotations
   void dump_down_nodes();
 
   Node get_graph_input_node();
@@ -0,0 +1,109 @@
+//  This file is distributed under the BSD 3-Clause License. See LICENSE for details.
+
+#include "lgraph_csr.hpp"
+
+#include "lgraph.hpp"
+
+static_assert(sizeof(LGraph_csr::Edge) == 24);
+
+LGraph_csr::LGraph_csr(LGraph *_lg) : lg(_lg), lg_size(_lg->node_internal.size()) {
+  const auto &node_internal = lg->node_internal;
+
+  struct Pending_edge {
+    Index_ID nid;  // master nid that owns the edge
+    Edge     edge;
+  };
+  std::vector<Pending_edge> pending_out;
+  std::vector<Pending_edge> pending_inp;
+
+  out_offset.resize(lg_size + 1, 0);
+  inp_offset.resize(lg_size + 1, 0);
+
+  // 1st: single linear sweep over node_internal (no get_next() chasing)
+  for (Index_ID idx = 1; idx < lg_size; idx.value++) {
+    const auto &ni = node_internal[idx];
+    if (!ni.is_valid()) continue;
+
+    Index_ID root_idx = ni.is_root() ? idx : ni.get_nid();
+    Index_ID nid      = ni.get_master_root_nid();
+    Port_ID  pid      = ni.get_dst_pid();
+    uint32_t bits     = node_internal[root_idx].get_bits();
+
+    if (ni.is_master_root() && !ni.is_graph_io()) nodes.emplace_back(idx);
+
+    auto n_out = ni.get_num_local_outputs();
+    if (n_out) {
+      const Edge_raw *redge = ni.get_output_begin();
+      for (uint8_t i = 0; i < n_out; i++, redge += redge->next_node_inc()) {
+        Index_ID other_idx = redge->get_idx();
+        Edge     e;
+        e.driver_nid = nid;
+        e.driver_idx = root_idx;
+        e.driver_pid = pid;
+        e.sink_nid   = node_internal[other_idx].get_master_root_nid();
+        e.sink_idx   = other_idx;
+        e.sink_pid   = redge->get_inp_pid();
+        e.bits       = bits;
+        pending_out.emplace_back(Pending_edge{nid, e});
+        out_offset[nid + 1]++;
+      }
+    }
+
+    auto n_inp = ni.get_num_local_inputs();
+    if (n_inp) {
+      const Edge_raw *redge = ni.get_input_begin();
+      for (uint8_t i = 0; i < n_inp; i++, redge += redge->next_node_inc()) {
+        Index_ID other_idx = redge->get_idx();
+        Edge     e;
+        e.driver_nid = node_internal[other_idx].get_master_root_nid();
+        e.driver_idx = other_idx;
+        e.driver_pid = redge->get_inp_pid();
+        e.sink_nid   = nid;
+        e.sink_idx   = root_idx;
+        e.sink_pid   = pid;
+        e.bits       = node_internal[other_idx].get_bits();
+        pending_inp.emplace_back(Pending_edge{nid, e});
+        inp_offset[nid + 1]++;
+      }
+    }
+  }
+
+  // 2nd: counting sort by nid so that every node has contiguous edges
+  for (size_t i = 1; i < out_offset.size(); ++i) {
+    out_offset[i] += out_offset[i - 1];
+    inp_offset[i] += inp_offset[i - 1];
+  }
+
+  out_list.resize(pending_out.size());
+  std::vector<uint32_t> pos(out_offset.begin(), out_offset.end() - 1);
+  for (const auto &p : pending_out) {
+    out_list[pos[p.nid]++] = p.edge;
+  }
+
+  inp_list.resize(pending_inp.size());
+  pos.assign(inp_offset.begin(), inp_offset.end() - 1);
+  for (const auto &p : pending_inp) {
+    inp_list[pos[p.nid]++] = p.edge;
+  }
+}
+
+bool LGraph_csr::is_stale() const { return lg->node_internal.size() != lg_size; }
+
+absl::Span<const LGraph_csr::Edge> LGraph_csr::out_edges(const Node &node) const {
+  I(node.get_class_lgraph() == lg);
+  return out_edges(node.get_compact_class().get_nid());
+}
+
+absl::Span<const LGraph_csr::Edge> LGraph_csr::inp_edges(const Node &node) const {
+  I(node.get_class_lgraph() == lg);
+  return inp_edges(node.get_compact_class().get_nid());
+}
+
+XEdge LGraph_csr::get_xedge(const Node &node, const Edge &edge) const {
+  I(node.get_class_lgraph() == lg);
+
+  Node_pin dpin(node.get_top_lgraph(), lg, node.get_hidx(), edge.driver_idx, edge.driver_pid, false);
+  Node_pin spin(node.get_top_lgraph(), lg, node.get_hidx(), edge.sink_idx, edge.sink_pid, true);
+
+  return XEdge(dpin, spin);
+}
@@ -0,0 +1,73 @@
+//  This file is distributed under the BSD 3-Clause License. See LICENSE for details.
+#pragma once
+
+#include <vector>
+
+#include "absl/types/span.h"
+#include "edge.hpp"
+#include "lgraph_base_core.hpp"
+
+class LGraph;
+
+// Read-only compressed sparse row (CSR) snapshot of an LGraph. The edges of
+// each node are contiguous, so a traversal reads memory sequentially instead
+// of following the overflow chain in node_internal. The snapshot is not
+// updated if the LGraph changes: it must be re-created after any edit.
+class LGraph_csr {
+public:
+  struct Edge {  // 24 bytes
+    Index_ID driver_nid;
+    Index_ID driver_idx;
+    Index_ID sink_nid;
+    Index_ID sink_idx;
+    Port_ID  driver_pid;
+    Port_ID  sink_pid;
+    uint32_t bits;  // driver pin bits
+  };
+
+protected:
+  friend class LGraph;
+
+  LGraph *lg;
+  size_t  lg_size;  // node_internal size when frozen (detect stale snapshots)
+
+  std::vector<Index_ID> nodes;       // master root nids in fast() order (no graph IO)
+  std::vector<uint32_t> out_offset;  // per nid, out_list[out_offset[nid] .. out_offset[nid+1]]
+  std::vector<uint32_t> inp_offset;  // per nid, inp_list[inp_offset[nid] .. inp_offset[nid+1]]
+  std::vector<Edge>     out_list;
+  std::vector<Edge>     inp_list;
+
+  explicit LGraph_csr(LGraph *_lg);
+
+  bool is_stale() const;
+
+public:
+  LGraph_csr()                   = delete;
+  LGraph_csr(const LGraph_csr &) = delete;
+  LGraph_csr(LGraph_csr &&)      = default;
+
+  LGraph *get_lgraph() const { return lg; }
+
+  absl::Span<const Index_ID> get_nodes() const { return absl::MakeConstSpan(nodes); }
+
+  size_t get_num_nodes() const { return nodes.size(); }
+  size_t get_num_edges() const { return out_list.size(); }
+
+  absl::Span<const Edge> out_edges(Index_ID nid) const {
+    I(!is_stale());
+    I(nid < out_offset.size() - 1);
+    return absl::MakeConstSpan(out_list).subspan(out_offset[nid], out_offset[nid + 1] - out_offset[nid]);
+  }
+
+  absl::Span<const Edge> inp_edges(Index_ID nid) const {
+    I(!is_stale());
+    I(nid < inp_offset.size() - 1);
+    return absl::MakeConstSpan(inp_list).subspan(inp_offset[nid], inp_offset[nid + 1] - inp_offset[nid]);
+  }
+
+  absl::Span<const Edge> out_edges(const Node &node) const;
+  absl::Span<const Edge> inp_edges(const Node &node) const;
+
+  // Same XEdge that LGraph::out_edges/inp_edges would return for the node
+  XEdge get_xedge(const Node &node, const Edge &edge) const;
+};
@@ -2,6 +2,7 @@
 
 #include "lgraphbase.hpp"
 
+#include <algorithm>
 #include <iostream>
 #include <set>
 
@@ -183,28 +184,51 @@ Index_ID LGraph_Base::create_node_space(const Index_ID last_idx, const Port_ID d
   return idx2;
 }
 
-void LGraph_Base::print_stats() const {
-  double bytes = 0;
+LGraph_Base::Stats LGraph_Base::get_stats() const {
+  Stats st;
+
+  st.n_entries = node_internal.size();
 
-  size_t n_nodes       = 1;
-  size_t n_extra       = 1;
-  size_t n_master      = 1;
-  size_t n_roots       = 1;
-  size_t n_long_edges  = 1;
-  size_t n_short_edges = 1;
+  bool page_root     = false;
+  bool page_overflow = false;
   for (size_t i = 0; i < node_internal.size(); i++) {
-    if (node_internal[i].is_node_state()) {
-      n_long_edges += node_internal[i].get_num_local_long();
-      n_short_edges += node_internal[i].get_num_local_short();
-      n_nodes++;
-      if (node_internal[i].is_root()) {
-        n_roots++;
-        if (node_internal[i].is_master_root()) n_master++;
-      }
+    const auto &entry = node_internal[i];
+    if (entry.is_page_state()) {
+      if (st.n_pages && page_overflow && !page_root) st.n_overflow_pages++;
+      st.n_pages++;
+      page_root     = false;
+      page_overflow = false;
+      continue;
+    }
+    if (!entry.is_node_state()) continue;
+
+    st.n_used++;
+    st.n_long_edges += entry.get_num_local_long();
+    st.n_short_edges += entry.get_num_local_short();
+    if (entry.is_root()) {
+      page_root = true;
+      st.n_pins++;
+      if (entry.is_master_root()) st.n_nodes++;
     } else {
-      n_extra++;
+      page_overflow = true;
     }
   }
+  if (page_overflow && !page_root) st.n_overflow_pages++;
+
+  return st;
+}
+
+void LGraph_Base::print_stats() const {
+  double bytes = 0;
+
+  auto st = get_stats();
+
+  size_t n_nodes       = st.n_used + 1;
+  size_t n_extra       = st.n_entries - st.n_used + 1;
+  size_t n_master      = st.n_nodes + 1;
+  size_t n_roots       = st.n_pins + 1;
+  size_t n_long_edges  = st.n_long_edges + 1;
+  size_t n_short_edges = st.n_short_edges + 1;
 
   bytes += node_internal.size() * sizeof(Node_Internal);
   // bytes += node_type_op.size() * sizeof(Node_Type_Op);
@@ -224,6 +248,8 @@ void LGraph_Base::print_stats() const {
   bytes = n_nodes + 1;
   fmt::print("  edges short/node:{:.2f} long/node:{:.2f} short/ratio:{:.2f}\n", n_short_edges / bytes, n_long_edges / bytes,
              (n_short_edges) / (1.0 + n_short_edges + n_long_edges));
+  fmt::print("  edges short(SEdge):{} long(LEdge):{} short/long:{:.2f}\n", st.n_short_edges, st.n_long_edges,
+             (double)n_short_edges / n_long_edges);
 }
 
 #if 0
@@ -563,6 +589,124 @@ Index_ID LGraph_Base::add_edge_int(const Index_ID dst_idx, const Port_ID inp_pid
   return root_idx;
 }
 
+bool LGraph_Base::try_add_output_int(const Index_ID idx, const Index_ID dst_idx, const Port_ID inp_pid) {
+  if (!node_internal[idx].has_space_short()) return false;
+
+  int o = node_internal[idx].next_free_output_pos();
+
+  auto *sedge = (SEdge_Internal *)&node_internal[idx].sedge[o];
+  if (sedge->set(dst_idx, inp_pid, false)) {
+    node_internal.ref(idx)->inc_outputs();
+    return true;
+  }
+
+  if (!node_internal[idx].has_space_long()) return false;
+
+  o--;
+  auto *ledge = (LEdge_Internal *)(&node_internal[idx].sedge[o]);
+  ledge->set(dst_idx, inp_pid, false);
+
+  node_internal.ref(idx)->inc_outputs(true);
+  return true;
+}
+
+bool LGraph_Base::try_add_input_int(const Index_ID idx, const Index_ID src_idx, const Port_ID dst_pid) {
+  if (!node_internal[idx].has_space_short()) return false;
+
+  int i = node_internal[idx].next_free_input_pos();
+
+  auto *sedge = (SEdge_Internal *)&node_internal[idx].sedge[i];
+  if (sedge->set(src_idx, dst_pid, true)) {
+    node_internal.ref(idx)->inc_inputs();
+    return true;
+  }
+
+  if (!node_internal[idx].has_space_long()) return false;
+
+  auto *ledge = (LEdge_Internal *)(&node_internal[idx].sedge[i]);
+  ledge->set(src_idx, dst_pid, true);
+
+  node_internal.ref(idx)->inc_inputs(true);  // WARNING: after next_free_input_pos (increasing insert)
+  return true;
+}
+
+void LGraph_Base::add_edges_int(std::vector<Edge_batch_entry> &edges) {
+  // Same result as add_edge_int for each edge, but all the edges of a pin are
+  // written together. The overflow chain of each pin is walked once (always
+  // from the last entry written) instead of once per edge.
+
+  //-----------------------
+  // Outputs, grouped by driver pin
+  std::sort(edges.begin(), edges.end(), [](const Edge_batch_entry &a, const Edge_batch_entry &b) {
+    return a.driver_idx < b.driver_idx;
+  });
+
+  size_t i = 0;
+  while (i < edges.size()) {
+    const Index_ID src_idx = edges[i].driver_idx;
+    const Port_ID  dst_pid = edges[i].driver_pid;
+    I(node_internal[src_idx].is_root());
+    I(node_internal[src_idx].get_dst_pid() == dst_pid);
+    node_internal.ref(src_idx)->set_driver_setup();
+
+    const Index_ID src_nid = node_internal[src_idx].get_master_root_nid();
+
+    Index_ID idx = src_idx;
+    auto     it  = idx_insert_cache.find(src_idx);
+    if (it != idx_insert_cache.end()) idx = it->second;
+
+    for (; i < edges.size() && edges[i].driver_idx == src_idx; ++i) {
+      I(node_internal[edges[i].sink_idx].is_root());
+      if (try_add_output_int(idx, edges[i].sink_idx, edges[i].sink_pid)) continue;
+
+      idx = get_space_output_pin(src_nid, idx, dst_pid, src_idx);
+      bool done = try_add_output_int(idx, edges[i].sink_idx, edges[i].sink_pid);
+      I(done);
+      (void)done;
+    }
+
+    if (node_internal[idx].has_space_short())
+      idx_insert_cache[src_idx] = idx;
+    else
+      idx_insert_cache.erase(src_idx);
+  }
+
+  //-----------------------
+  // Inputs, grouped by sink pin
+  std::sort(edges.begin(), edges.end(), [](const Edge_batch_entry &a, const Edge_batch_entry &b) {
+    return a.sink_idx < b.sink_idx;
+  });
+
+  i = 0;
+  while (i < edges.size()) {
+    const Index_ID dst_idx = edges[i].sink_idx;
+    const Port_ID  inp_pid = edges[i].sink_pid;
+    I(node_internal[dst_idx].is_root());
+    I(node_internal[dst_idx].get_dst_pid() == inp_pid);
+    node_internal.ref(dst_idx)->set_sink_setup();
+
+    const Index_ID dst_nid = node_internal[dst_idx].get_master_root_nid();
+
+    Index_ID idx = dst_idx;
+    auto     it  = idx_insert_cache.find(dst_idx);
+    if (it != idx_insert_cache.end()) idx = it->second;
+
+    for (; i < edges.size() && edges[i].sink_idx == dst_idx; ++i) {
+      if (try_add_input_int(idx, edges[i].driver_idx, edges[i].driver_pid)) continue;
+
+      idx = get_space_output_pin(dst_nid, idx, inp_pid, dst_idx);
+      bool done = try_add_input_int(idx, edges[i].driver_idx, edges[i].driver_pid);
+      I(done);
+      (void)done;
+    }
+
+    if (node_internal[idx].has_space_short())
+      idx_insert_cache[dst_idx] = idx;
+    else
+      idx_insert_cache.erase(dst_idx);
+  }
+}
+
 void LGraph_Base::error(std::string_view text) {
   fmt::print("error:{}\n", text);
   throw std::runtime_error(std::string(text));
@@ -16,6 +16,7 @@
 class Fwd_edge_iterator;
 class Bwd_edge_iterator;
 class Fast_edge_iterator;
+class Fwd_levels;
 class Graph_library;
 
 class LGraph_Base : public Lgraph_base_core {
@@ -36,6 +37,16 @@ protected:
 
   Index_ID add_edge_int(Index_ID dst_nid, Port_ID dst_pid, Index_ID src_nid, Port_ID inp_pid);
 
+  struct Edge_batch_entry {
+    Index_ID driver_idx;
+    Index_ID sink_idx;
+    Port_ID  driver_pid;
+    Port_ID  sink_pid;
+  };
+  bool try_add_output_int(Index_ID idx, Index_ID dst_idx, Port_ID inp_pid);
+  bool try_add_input_int(Index_ID idx, Index_ID src_idx, Port_ID dst_pid);
+  void add_edges_int(std::vector<Edge_batch_entry> &edges);
+
   Port_ID recompute_io_ports(const Index_ID track_nid);
 
   Index_ID find_idx_from_pid_int(const Index_ID idx, const Port_ID pid) const;
@@ -103,7 +114,22 @@ public:
     add_edge_int(dst_idx, node_internal[dst_idx].get_dst_pid(), src_idx, node_internal[src_idx].get_dst_pid());
   }
 
-  void print_stats() const;
+  struct Stats {
+    size_t n_entries        = 0;  // node_internal entries (nodes, pins, overflow, pages, free)
+    size_t n_nodes          = 0;  // master roots
+    size_t n_pins           = 0;  // roots
+    size_t n_used           = 0;  // entries in node state (roots and overflow)
+    size_t n_pages          = 0;
+    size_t n_overflow_pages = 0;  // pages with overflow entries but no root
+    size_t n_short_edges    = 0;  // SEdge (both directions)
+    size_t n_long_edges     = 0;  // LEdge (both directions)
+
+    size_t get_invalid() const { return n_entries - n_used - n_pages; }  // free or never used
+    double get_invalid_ratio() const { return n_entries ? (double)get_invalid() / n_entries : 0.0; }
+  };
+
+  Stats get_stats() const;
+  void  print_stats() const;
 
   const Node_Internal &get_node_int(Index_ID idx) const {
     I(static_cast<Index_ID>(node_internal.size()) > idx);
@@ -100,6 +100,7 @@ public:
     friend class Bwd_edge_iterator;
     friend class Hierarchy_tree;
     friend class mmap_lib::hash<Node::Compact_class>;
+    friend struct mmap_lib::dense_key<Node::Compact_class>;
 
   public:
     // constexpr operator size_t() const { return nid; }
@@ -287,4 +288,10 @@ template <>
 struct hash<Node::Compact_class> {
   size_t operator()(Node::Compact_class const &o) const { return hash<uint32_t>{}(o.nid); }
 };
+
+template <>
+struct dense_key<Node::Compact_class> {
+  static constexpr bool value = true;
+  static uint64_t       get(Node::Compact_class const &o) { return o.nid; }
+};
 }  // namespace mmap_lib
@@ -25,6 +25,7 @@ protected:
   friend class Fwd_edge_iterator;
   friend class Bwd_edge_iterator;
   friend class Edge_raw;
+  friend class LGraph_csr;
 
   LGraph *        top_g;
   LGraph *        current_g;
@@ -138,6 +139,7 @@ public:
     friend class Fwd_edge_iterator;
     friend class Bwd_edge_iterator;
     friend class mmap_lib::hash<Node_pin::Compact_class>;
+    friend struct mmap_lib::dense_key<Node_pin::Compact_class>;
 
   public:
     // constexpr operator size_t() const { I(0); return idx|(sink<<31); }
@@ -177,6 +179,7 @@ public:
     friend class Fwd_edge_iterator;
     friend class Bwd_edge_iterator;
     friend class mmap_lib::hash<Node_pin::Compact_class_driver>;
+    friend struct mmap_lib::dense_key<Node_pin::Compact_class_driver>;
 
   public:
     // constexpr operator size_t() const { I(0); return idx|(sink<<31); }
@@ -380,4 +383,16 @@ template <>
 struct hash<Node_pin::Compact_class_driver> {
   size_t operator()(Node_pin::Compact_class_driver const &o) const { return hash<uint32_t>{}(o.idx); }
 };
+
+template <>
+struct dense_key<Node_pin::Compact_class> {
+  static constexpr bool value = true;
+  static uint64_t       get(Node_pin::Compact_class const &o) { return (static_cast<uint64_t>(o.idx) << 1) + o.sink; }
+};
+
+template <>
+struct dense_key<Node_pin::Compact_class_driver> {
+  static constexpr bool value = true;
+  static uint64_t       get(Node_pin::Compact_class_driver const &o) { return o.idx; }
+};
 }  // namespace mmap_lib
@@ -102,6 +102,14 @@ public:
     reset_pins();
   }
 
+  // Same IOs and cell, keeps name and lgid (lgraph copies)
+  void copy_pins(const Sub_node &sub) {
+    phys                   = sub.phys;
+    io_pins                = sub.io_pins;
+    name2id                = sub.name2id;
+    graph_pos2instance_pid = sub.graph_pos2instance_pid;
+  }
+
   void rename(std::string_view _name) {
     I(!is_invalid());
     I(name != _name);
@@ -7,8 +7,10 @@
 #include <vector>
 #include <string>
 
+#include "annotate.hpp"
 #include "attribute.hpp"
 #include "lbench.hpp"
+#include "thread_pool.hpp"
 
 #include "lgedgeiter.hpp"
 #include "lgraph.hpp"
@@ -89,3 +91,71 @@ TEST_F(Setup_attr_test, data_test1) {
   }
 }
 
+
+TEST(Attribute_thread, stress) {
+  static constexpr int n_lgs   = 64;
+  static constexpr int n_nodes = 2000;
+
+  static constexpr char name[] = "thr_stress";
+  using tattr = Attribute<name, Node, mmap_lib::map<Node::Compact_class, uint32_t> >;
+
+  std::vector<LGraph *> lgs;
+  for (int i = 0; i < n_lgs; ++i) {
+    auto *lg = LGraph::create("lgdb_attr_thr", "thr_" + std::to_string(i), "-");
+    for (int j = 0; j < n_nodes; ++j) {
+      lg->create_node(Sum_Op);
+    }
+    lgs.emplace_back(lg);
+  }
+
+  Thread_pool pool;
+
+  std::atomic<int> n_errors = 0;
+  auto work = [&lgs, &n_errors](int i, uint32_t seed) {
+    // Jump between lgraphs to hit the per thread cache misses and table growth
+    auto *lg   = lgs[i];
+    auto *next = lgs[(i + 1) % n_lgs];
+    for (auto node : lg->fast()) {
+      tattr::ref(node)->set(node.get_compact_class(), node.get_compact_class().get_nid().value + seed);
+      (void)tattr::ref(next)->size();
+    }
+    for (auto node : lg->fast()) {
+      if (tattr::ref(node)->get(node.get_compact_class()) != node.get_compact_class().get_nid().value + seed) n_errors++;
+    }
+  };
+
+  for (uint32_t round = 0; round < 4; ++round) {
+    for (int i = 0; i < n_lgs; ++i) {
+      if (i % 2 == int(round % 2)) pool.add([&work, i, round] { work(i, round); });
+    }
+    pool.wait_all();
+
+    // clear from one thread while the others are idle, the caches must not return a deleted table
+    for (int i = 0; i < n_lgs; ++i) {
+      if (i % 4 == 0) tattr::clear(lgs[i]);
+    }
+  }
+
+  EXPECT_EQ(n_errors, 0);
+}
+
+TEST(Attribute_str_pool, old_format) {
+  // An lgdb from before the str_pool (bimap with txt files) is rejected, LGraph::create regenerates it
+  auto *lg   = LGraph::create("lgdb_attr_fmt", "old", "-");
+  auto  node = lg->create_node(Sum_Op);
+  node.set_name("sum0");
+  EXPECT_EQ(node.get_name(), "sum0");
+
+  auto txt = absl::StrCat(lg->get_path(), "/lg_data_node", std::to_string(lg->get_lgid()), Ann_name::nodename, "_k2vtxt");
+  int  fd  = ::open(txt.c_str(), O_CREAT | O_WRONLY, 0644);
+  ASSERT_GE(fd, 0);
+  ::close(fd);
+
+  Ann_node_name::forget(lg->get_lgid());  // reopen
+  EXPECT_THROW(Ann_node_name::ref(lg), std::runtime_error);
+  EXPECT_THROW(Ann_node_name::ref(lg), std::runtime_error);  // not cached
+
+  lg = LGraph::create("lgdb_attr_fmt", "old", "-");
+  EXPECT_NE(access(txt.c_str(), F_OK), 0);
+  EXPECT_TRUE(Ann_node_name::ref(lg)->empty());
+}
@@ -3,6 +3,9 @@
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
+#include <set>
+
+#include "annotate.hpp"
 #include "lgedgeiter.hpp"
 #include "lgraph.hpp"
 #include "lbench.hpp"
@@ -248,6 +251,187 @@ TEST_F(Edge_test, random_insert) {
   }
 }
 
+TEST_F(Edge_test, frozen_csr) {
+
+  for(int i=0;i<3000;++i) {
+    Node_pin d;
+    Node_pin s;
+    if (rbool.any())
+      d = add_n1_setup_driver_pin("driver_pin" + std::to_string(i));
+    if (rbool.any())
+      s = add_n2_setup_sink_pin("sink_pin" + std::to_string(i));
+    if (rbool.any() && !d.is_invalid() && !s.is_invalid()) {
+      add_edge(d, s);
+    }
+  }
+
+  auto csr = g->freeze();
+
+  EXPECT_EQ(csr.get_num_edges(), track_edge_count.size());
+  EXPECT_EQ(csr.out_edges(n1).size(), n1.out_edges().size());
+  EXPECT_EQ(csr.inp_edges(n2).size(), n2.inp_edges().size());
+  EXPECT_EQ(csr.inp_edges(n1).size(), 0);
+  EXPECT_EQ(csr.out_edges(n2).size(), 0);
+
+  for(const auto &e : csr.out_edges(n1)) {
+    auto xedge = csr.get_xedge(n1, e);
+    EXPECT_TRUE(track_edge_count.has(xedge.get_compact()));
+    EXPECT_EQ(xedge.driver.get_node(), n1);
+    EXPECT_EQ(xedge.sink.get_node(), n2);
+    EXPECT_EQ(e.bits, xedge.driver.get_bits());
+  }
+
+  for(const auto &e : csr.inp_edges(n2)) {
+    auto xedge = csr.get_xedge(n2, e);
+    EXPECT_TRUE(track_edge_count.has(xedge.get_compact()));
+    EXPECT_EQ(e.driver_nid, n1.get_compact_class().get_nid());
+  }
+
+  int n_nodes = 0;
+  for(auto node : g->fast()) {
+    EXPECT_EQ(node.get_compact_class().get_nid(), csr.get_nodes()[n_nodes]);
+    n_nodes++;
+  }
+  EXPECT_EQ(n_nodes, csr.get_num_nodes());
+}
+
+TEST_F(Edge_test, bulk_insert) {
+
+  std::vector<std::pair<Node_pin, Node_pin>> edges;
+  std::vector<Node_pin> dpins;
+  std::vector<Node_pin> spins;
+
+  for(int i=0;i<200;++i) {
+    dpins.emplace_back(add_n1_setup_driver_pin("driver_pin" + std::to_string(i)));
+    spins.emplace_back(add_n2_setup_sink_pin("sink_pin" + std::to_string(i)));
+  }
+
+  for(int i=0;i<4000;++i) {
+    auto &d = dpins[rint.max(dpins.size())];
+    auto &s = spins[rint.max(spins.size())];
+    XEdge edge(d, s);
+    if (track_edge_count.has(edge.get_compact()))
+      continue;
+    track_edge_count.set(edge.get_compact(), 1);
+    edges.emplace_back(d, s);
+  }
+
+  g->add_edges(edges);
+
+  check_edges();
+
+  EXPECT_EQ(n1.out_edges().size(), track_edge_count.size());
+  EXPECT_EQ(n2.inp_edges().size(), track_edge_count.size());
+  for(const auto &[d, s] : edges) {
+    EXPECT_TRUE(g->has_edge(d, s));
+  }
+
+  // Mixing single inserts after a bulk insert must keep the chains consistent
+  for(int i=0;i<200;++i) {
+    add_edge(dpins[rint.max(dpins.size())], spins[rint.max(spins.size())]);
+  }
+  check_edges();
+  EXPECT_EQ(n1.out_edges().size(), track_edge_count.size());
+  EXPECT_EQ(n2.inp_edges().size(), track_edge_count.size());
+}
+
+TEST_F(Edge_test, compact) {
+
+  auto inp = g->add_graph_input("a", 1, 8);
+  auto out = g->add_graph_output("z", 2, 8);
+
+  std::vector<Node> nodes;
+  for(int i=0;i<300;++i) {
+    auto node = g->create_node(And_Op, 8);
+    node.set_name("and" + std::to_string(i));
+    nodes.emplace_back(node);
+  }
+  g->add_edge(inp, nodes[0].setup_sink_pin(0));
+  for(size_t i=1;i<nodes.size();++i) {
+    g->add_edge(nodes[i-1].setup_driver_pin(0), nodes[i].setup_sink_pin(0));
+  }
+  g->add_edge(nodes.back().setup_driver_pin(0), out);
+
+  // Deleted nodes leave holes in the middle of the graph
+  for(int i=0;i<300;++i) {
+    auto tmp = g->create_node(Or_Op, 8);
+    g->add_edge(nodes[rint.max(nodes.size())].setup_driver_pin(0), tmp.setup_sink_pin(0));
+    tmp.del_node();
+  }
+
+  // Renames leave dead text in the str_pool
+  for(size_t i=0;i<nodes.size();++i) {
+    nodes[i].set_name("tmp" + std::to_string(i));
+    nodes[i].set_name("and" + std::to_string(i));
+  }
+
+  auto count_live_txt = [this]() {
+    std::set<std::string> live;
+    const auto *pin_names = Ann_node_pin_name::ref(g);
+    for(auto it = pin_names->begin(); it != pin_names->end(); ++it) {
+      live.insert(std::string(pin_names->get_val(it)));
+    }
+    const auto *names = Ann_node_name::ref(g);
+    for(auto it = names->begin(); it != names->end(); ++it) {
+      live.insert(std::string(names->get_val(it)));
+    }
+    return live.size();
+  };
+  EXPECT_GE(Ann_node_name::ref(g)->get_pool().size(), count_live_txt() + nodes.size());
+
+  // Per instance annotations: the root one follows the node, the one below the root (stale hidx) is dropped
+  nodes[5].ref_place()->replace(5, 7);
+  Ann_node_place::ref(g)->set(Node::Compact(Hierarchy_index(1, 0), nodes[6].get_compact().get_nid()), Ann_place(6, 8));
+  EXPECT_EQ(Ann_node_place::ref(g)->size(), 2);
+
+  auto check_compact = [this, &count_live_txt]() {
+    int n_nodes = 0;
+    for(auto node : g->fast()) {
+      (void)node;
+      n_nodes++;
+    }
+    EXPECT_EQ(n_nodes, 302);  // and0..and299 + n1 + n2
+
+    for(auto node : g->fast()) {
+      if (node.is_type_sub()) continue;
+      EXPECT_EQ(node.get_type().op, And_Op);
+      EXPECT_EQ(node.get_driver_pin(0).get_bits(), 8);
+
+      auto inp_edges = node.inp_edges();
+      ASSERT_EQ(inp_edges.size(), 1);
+      auto id = std::stoi(std::string(node.get_name().substr(3)));
+      if (id == 0) {
+        EXPECT_TRUE(inp_edges[0].driver.is_graph_input());
+        EXPECT_EQ(inp_edges[0].driver.get_name(), "a");
+      } else {
+        EXPECT_EQ(inp_edges[0].driver.get_node().get_name(), "and" + std::to_string(id-1));
+      }
+    }
+
+    EXPECT_TRUE(g->is_graph_input("a"));
+    EXPECT_TRUE(g->is_graph_output("z"));
+    auto out_edges = g->get_graph_output("z").get_node().inp_edges();
+    ASSERT_EQ(out_edges.size(), 1);
+    EXPECT_EQ(out_edges[0].driver.get_node().get_name(), "and299");
+
+    EXPECT_EQ(Ann_node_name::ref(g)->get_pool().size(), count_live_txt());
+
+    EXPECT_EQ(Ann_node_place::ref(g)->size(), 1);
+    for(auto node : g->fast()) {
+      if (node.is_type_sub() || node.get_name() != "and5") continue;
+      ASSERT_TRUE(node.has_place());
+      EXPECT_EQ(node.get_place().get_x(), 5);
+      EXPECT_EQ(node.get_place().get_y(), 7);
+    }
+  };
+
+  g->compact();  // nodes, n1, and n2 are invalid after this point
+  check_compact();
+
+  g->compact(LGraph::Compact_order::Rcm);
+  check_compact();
+}
+
 TEST_F(Edge_test, trivial_delete) {
 
   auto dpin = add_n1_setup_driver_pin("driver_pin" + std::to_string(1));
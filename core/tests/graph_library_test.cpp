@@ -0,0 +1,118 @@
+//  This file is distributed under the BSD 3-Clause License. See LICENSE for details.
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include <sys/stat.h>
+
+#include "absl/strings/match.h"
+
+#include "annotate.hpp"
+#include "attribute.hpp"
+#include "graph_library.hpp"
+#include "lgedgeiter.hpp"
+#include "lgraph.hpp"
+
+static constexpr char snap_attr_name[] = "snap_test";
+using Snap_attr = Attribute<snap_attr_name, Node, mmap_lib::map<Node::Compact_class, uint32_t> >;
+
+class Graph_library_test : public ::testing::Test {
+protected:
+  static constexpr std::string_view path = "lgdb_glib_test";
+
+  Graph_library *lib;
+
+  void SetUp() override {
+    mkdir(std::string(path).c_str(), 0755);
+    lib = Graph_library::instance(path);
+
+    auto *lg = LGraph::create(path, "orig", "-");
+    for (int i = 0; i < 10; ++i) {
+      auto node = lg->create_node(Sum_Op);
+      node.set_name("sum" + std::to_string(i));
+      Snap_attr::ref(lg)->set(node.get_compact_class(), 1);
+    }
+    lg->sync();
+  }
+
+  void TearDown() override {
+    lib->discard_snapshot("snap");
+  }
+
+  static int count_nodes(LGraph *lg) {
+    int n = 0;
+    for (auto node : lg->fast()) {
+      (void)node;
+      ++n;
+    }
+    return n;
+  }
+
+  // Adds a node, renames the existing ones, and changes the Snap_attr values
+  static void modify(LGraph *lg) {
+    for (auto node : lg->fast()) {
+      node.set_name(absl::StrCat("new_", node.get_name()));
+      Snap_attr::ref(lg)->set(node.get_compact_class(), 2);
+    }
+    auto node = lg->create_node(Sum_Op);
+    node.set_name("added");
+    Snap_attr::ref(lg)->set(node.get_compact_class(), 2);
+  }
+
+  static void check(LGraph *lg, int n_nodes, std::string_view prefix, uint32_t val) {
+    EXPECT_EQ(count_nodes(lg), n_nodes);
+    for (auto node : lg->fast()) {
+      ASSERT_TRUE(node.has_name());
+      if (node.get_name() != "added") EXPECT_TRUE(absl::StartsWith(node.get_name(), absl::StrCat(prefix, "sum")));
+      EXPECT_EQ(Snap_attr::ref(lg)->get(node.get_compact_class()), val);
+    }
+  }
+};
+
+TEST_F(Graph_library_test, snapshot_discard) {
+  auto id_snap = lib->snapshot_lgraph("orig", "snap");
+  EXPECT_FALSE(Graph_library::get_lgraph_files(path, id_snap).empty());
+
+  auto *snap = LGraph::open(path, "snap");
+  ASSERT_NE(snap, nullptr);
+  check(snap, 10, "", 1);
+  modify(snap);
+  check(snap, 11, "new_", 2);
+
+  lib->discard_snapshot("snap");
+  EXPECT_TRUE(Graph_library::get_lgraph_files(path, id_snap).empty());
+  EXPECT_FALSE(Graph_library::exists(path, "snap"));
+
+  auto *lg = LGraph::open(path, "orig");
+  ASSERT_NE(lg, nullptr);
+  check(lg, 10, "", 1);
+}
+
+TEST_F(Graph_library_test, snapshot_commit) {
+  auto id_orig = LGraph::open(path, "orig")->get_lgid();
+  auto id_snap = lib->snapshot_lgraph("orig", "snap");
+
+  modify(LGraph::open(path, "snap"));
+
+  // The original stays loaded (and with cached attribute tables) until the commit
+  check(LGraph::open(path, "orig"), 10, "", 1);
+
+  EXPECT_TRUE(lib->commit_snapshot("snap", "orig"));  // LGraph pointers are invalid after this
+  EXPECT_TRUE(Graph_library::get_lgraph_files(path, id_snap).empty());
+  EXPECT_FALSE(Graph_library::exists(path, "snap"));
+
+  auto *lg = LGraph::open(path, "orig");
+  ASSERT_NE(lg, nullptr);
+  EXPECT_EQ(lg->get_lgid(), id_orig);  // parents keep their references
+  check(lg, 11, "new_", 2);
+}
+
+TEST_F(Graph_library_test, expunge) {
+  auto id = LGraph::open(path, "orig")->get_lgid();
+  EXPECT_FALSE(Graph_library::get_lgraph_files(path, id).empty());
+
+  lib->expunge("orig");
+
+  EXPECT_TRUE(Graph_library::get_lgraph_files(path, id).empty());
+  EXPECT_FALSE(Graph_library::exists(path, "orig"));
+}
@@ -0,0 +1,80 @@
+//  This file is distributed under the BSD 3-Clause License. See LICENSE for details.
+
+#include "absl/container/flat_hash_set.h"
+#include "inou_rand.hpp"
+#include "lbench.hpp"
+#include "lgedgeiter.hpp"
+#include "lgraph.hpp"
+
+// Compares the old absl::flat_hash_set<Node::Compact> visited set against
+// the dense Node_set used by the flow iterators with the same access pattern
+// (check every driver, insert every node).
+
+template <typename Set, typename Fn_contains, typename Fn_insert>
+size_t visit_all(LGraph *lg, Set &set, Fn_contains fn_contains, Fn_insert fn_insert) {
+  size_t nhits = 0;
+  for (auto node : lg->fast()) {
+    for (auto &edge : node.inp_edges()) {
+      nhits += fn_contains(set, edge.driver.get_node());
+    }
+    fn_insert(set, node);
+  }
+  return nhits;
+}
+
+int main(int argc, char **argv) {
+  int size = 1000000;
+  if (argc > 1) size = atoi(argv[1]);
+
+  Inou_rand::setup();
+
+  Eprp_var var;
+  var.add("name", "rand_bench");
+  var.add("path", "lgdb_iter_bench");
+  var.add("size", std::to_string(size));
+  Pass::eprp.run_cmd("inou.rand", var);
+  if (var.lgs.size() != 1) {
+    fmt::print("ERROR: inou.rand did not create a graph\n");
+    return -1;
+  }
+  LGraph *lg = var.lgs[0];
+  fmt::print("graph:{} size:{}\n", lg->get_name(), lg->size());
+
+  size_t hash_hits;
+  {
+    Lbench b("iter_bench.hash_set");
+
+    absl::flat_hash_set<Node::Compact> visited;
+    hash_hits = visit_all(
+        lg, visited, [](const auto &set, const Node &node) { return set.contains(node.get_compact()); },
+        [](auto &set, const Node &node) { set.insert(node.get_compact()); });
+  }
+
+  size_t bitmap_hits;
+  {
+    Lbench b("iter_bench.node_set");
+
+    Flow_base_iterator::Node_set visited;
+    bitmap_hits = visit_all(
+        lg, visited, [](const auto &set, const Node &node) { return set.contains(node); },
+        [](auto &set, const Node &node) { set.insert(node); });
+  }
+
+  if (hash_hits != bitmap_hits) {
+    fmt::print("ERROR: hash_set hits:{} node_set hits:{}\n", hash_hits, bitmap_hits);
+    return -1;
+  }
+
+  {
+    Lbench b("iter_bench.forward");
+
+    size_t n = 0;
+    for (auto node : lg->forward()) {
+      (void)node;
+      n++;
+    }
+    fmt::print("forward visited {} nodes\n", n);
+  }
+
+  return 0;
+}
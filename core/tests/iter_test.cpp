@@ -63,6 +63,43 @@ void do_fwd_traversal(LGraph *lg) {
   }
 }
 
+void check_levels(LGraph *lg, bool visit_sub) {
+  auto levels = lg->forward_levels(visit_sub);
+
+  size_t n_fwd = 0;
+  for (auto node : lg->forward(visit_sub)) {
+    (void)node;
+    n_fwd++;
+  }
+  if (levels.get_num_nodes() != n_fwd) {
+    fmt::print("ERROR: forward_levels has {} nodes but forward has {}\n", levels.get_num_nodes(), n_fwd);
+    I(false);
+    failed = true;
+  }
+
+  absl::flat_hash_map<Node::Compact, size_t> node2level;
+  for (size_t l = 0; l < levels.size(); ++l) {
+    for (const auto &node : levels.get_level(l)) {
+      node2level[node.get_compact()] = l;
+    }
+  }
+
+  for (size_t l = 0; l < levels.size(); ++l) {
+    for (const auto &node : levels.get_level(l)) {
+      for (auto edge : node.inp_edges()) {
+        auto it = node2level.find(edge.driver.get_node().get_compact());
+        if (it == node2level.end()) continue;
+
+        if (it->second >= l && test_order[edge.driver.get_node().get_compact()] < test_order[node.get_compact()]) {
+          fmt::print("ERROR: node:{} level:{} is not after driver pin:{} level:{}\n", node.debug_name(), l,
+                     edge.driver.debug_name(), it->second);
+          I(false);
+          failed = true;
+        }
+      }
+    }
+  }
+}
 
 void generate_graphs(int n) {
 
@@ -185,6 +222,8 @@ bool fwd(int n) {
     do_fwd_traversal(g);
 
     check_test_order(g);
+
+    check_levels(g, true);
   }
 
   return true;
@@ -459,6 +498,8 @@ void simple() {
   do_fwd_traversal(g);
 
   check_test_order(g);
+
+  check_levels(g, true);
 }
 
 int main() {
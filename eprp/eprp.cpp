@@ -1,9 +1,17 @@
 //  This file is distributed under the BSD 3-Clause License. See LICENSE for details.
 
 #include <ctype.h>
+#include <time.h>
+
 #include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
 
 #include "eprp.hpp"
+#include "lbench.hpp"
+#include "thread_pool.hpp"
 
 void Eprp::eat_comments() {
   while (scan_is_token(Token_id_comment) && !scan_is_end()) scan_next();
@@ -77,6 +85,7 @@ bool Eprp::rule_reg(bool first) {
 
   std::string var{scan_text()};
   ast->add(Eprp_rule_reg, scan_token());
+  run_pipe();  // the register gets the result of the queued commands
   if (first) {  // First in line #a |> ...
     if (variables.find(var) == variables.end()) {
       scan_error("variable {} is empty", var);
@@ -141,7 +150,10 @@ bool Eprp::rule_cmd_full() {
   } while (path_found);
 
   ast->down();
-  run_cmd(cmd_line, next_var);
+  if (stream_width > 0)
+    pipe_stages.push_back({cmd_line, next_var});
+  else
+    run_cmd(cmd_line, next_var);
   ast->up(Eprp_rule_cmd_full);
 
   return true;
@@ -186,6 +198,7 @@ bool Eprp::rule_top() {
   bool try_either = rule_cmd_or_reg(true);
   ast->up(Eprp_rule_top);
   if (!try_either) {
+    pipe_stages.clear();
     scan_error("statements start with a register or a command");
     return false;
   }
@@ -195,11 +208,14 @@ bool Eprp::rule_top() {
   bool try_pipe = rule_pipe();
   if (!try_pipe) {
     if (scan_is_token(Token_id_or)) {
+      pipe_stages.clear();
       scan_error("eprp pipe is |> not |");
       return false;
     } else if (scan_is_end()) {
+      run_pipe();
       return true;
     } else {
+      pipe_stages.clear();
       scan_error("invalid command");
       return false;
     }
@@ -212,6 +228,8 @@ bool Eprp::rule_top() {
     ;
   }
 
+  run_pipe();
+
   return true;
 }
 
@@ -234,6 +252,7 @@ void Eprp::elaborate() {
 
   ast = nullptr;
   last_cmd_var.clear();
+  pipe_stages.clear();
 };
 
 void Eprp::process_ast_handler(const mmap_lib::Tree_index &self, const Ast_parser_node &node) {
@@ -276,10 +295,8 @@ void Eprp::run_cmd(const std::string &cmd, Eprp_var &var) {
 
   const auto &m = it->second;
 
-  last_cmd_var.add(var);
-
   std::string err_msg;
-  bool        err = m.check_labels(last_cmd_var, err_msg);
+  bool        err = setup_var(m, var, last_cmd_var, err_msg);
   if (err) {
     parser_error(err_msg);
     return;
@@ -293,12 +310,236 @@ void Eprp::run_cmd(const std::string &cmd, Eprp_var &var) {
   }
 #endif
 
+  call_method(cmd, m, last_cmd_var);
+}
+
+// Adds the command labels and the defaults to var. Thread safe, returns true on error like check_labels
+bool Eprp::setup_var(const Eprp_method &m, const Eprp_var &args, Eprp_var &var, std::string &err_msg) const {
+  var.add(args);
+
+  bool err = m.check_labels(var, err_msg);
+  if (err) return true;
+
   for (const auto &label : m.labels) {
-    if (!label.second.default_value.empty() && !last_cmd_var.has_label(label.first))
-      last_cmd_var.add(label.first, label.second.default_value);
+    if (!label.second.default_value.empty() && !var.has_label(label.first)) var.add(label.first, label.second.default_value);
   }
 
-  m.method(last_cmd_var);
+  return false;
+}
+
+void Eprp::call_method(const std::string &cmd, const Eprp_method &m, Eprp_var &var) {
+  if (profile)
+    run_profiled(cmd, m, var);
+  else
+    m.method(var);
+}
+
+bool Eprp::is_streamable(const Pipe_stage &stage) const {
+  const auto it = methods.find(stage.cmd);
+  if (it == methods.end() || !it->second.is_streamable()) return false;
+
+  // hierarchical modes need the whole design
+  return stage.var.get("hier") != "true" && last_cmd_var.get("hier") != "true";
+}
+
+void Eprp::run_pipe() {
+  if (pipe_stages.empty()) return;
+
+  std::vector<Pipe_stage> stages;
+  std::swap(stages, pipe_stages);
+
+  auto it = stages.begin();
+  while (it != stages.end()) {
+    auto end = it;
+    while (end != stages.end() && is_streamable(*end)) ++end;
+
+    if (end == it) {
+      run_cmd(it->cmd, it->var);
+      ++it;
+    } else if (last_cmd_var.lgs.size() <= 1) {
+      for (; it != end; ++it) run_cmd(it->cmd, it->var);
+    } else {
+      run_stream(it, end);
+      it = end;
+    }
+    if (has_errors()) return;
+  }
+}
+
+void Eprp::run_stream(std::vector<Pipe_stage>::const_iterator begin, std::vector<Pipe_stage>::const_iterator end) {
+  const auto lgs = last_cmd_var.lgs;
+
+  // Bottom-up: each LGraph waits for its children in the stream (pending), and releases its parents when done
+  std::vector<int>                 pending(lgs.size());
+  std::vector<std::vector<size_t>> parents(lgs.size());
+  if (children_fn) {
+    absl::flat_hash_map<LGraph *, size_t> lg2pos;
+    for (size_t i = 0; i < lgs.size(); ++i) lg2pos.emplace(lgs[i], i);
+
+    for (size_t i = 0; i < lgs.size(); ++i) {
+      auto children = children_fn(lgs[i]);
+      std::sort(children.begin(), children.end());
+      children.erase(std::unique(children.begin(), children.end()), children.end());
+      for (auto *child : children) {
+        const auto it = lg2pos.find(child);
+        if (it == lg2pos.end() || it->second == i) continue;
+        pending[i]++;
+        parents[it->second].emplace_back(i);
+      }
+    }
+  }
+
+  std::vector<Eprp_var>           results(lgs.size());
+  std::vector<std::string>        errors(lgs.size());
+  std::vector<std::exception_ptr> exceptions(lgs.size());
+
+  auto &pool = Thread_pool::shared();
+
+  std::mutex              mutex;
+  std::condition_variable done;
+  int                     in_flight = 0;
+  std::deque<size_t>      ready;
+  std::vector<bool>       started(lgs.size());
+  size_t                  next_unstarted = 0;
+
+  for (size_t i = 0; i < lgs.size(); ++i) {
+    if (pending[i] == 0) ready.emplace_back(i);
+  }
+
+  for (size_t n = 0; n < lgs.size(); ++n) {
+    size_t i;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      done.wait(lock, [&] { return in_flight < stream_width && (!ready.empty() || in_flight == 0); });
+      if (ready.empty()) {  // Only with a loop in the hierarchy, start the first one left
+        while (started[next_unstarted]) ++next_unstarted;
+        i = next_unstarted;
+      } else {
+        i = ready.front();
+        ready.pop_front();
+      }
+      started[i] = true;
+      in_flight++;
+    }
+
+    pool.add([this, i, begin, end, &lgs, &results, &errors, &exceptions, &mutex, &done, &in_flight, &pending, &parents,
+              &started, &ready] {
+      Eprp_var var(last_cmd_var.dict);
+      var.add(lgs[i]);
+
+      try {
+        for (auto it = begin; it != end; ++it) {
+          const auto &m = methods.find(it->cmd)->second;
+          if (setup_var(m, it->var, var, errors[i])) break;
+          call_method(it->cmd, m, var);
+        }
+      } catch (...) {
+        exceptions[i] = std::current_exception();
+      }
+      results[i] = std::move(var);
+
+      std::lock_guard<std::mutex> lock(mutex);  // notify with the lock, the caller may return as soon as it is released
+      in_flight--;
+      for (auto p : parents[i]) {
+        if (--pending[p] == 0 && !started[p]) ready.emplace_back(p);
+      }
+      done.notify_one();
+    });
+  }
+  {
+    // Not wait_all, it spins while the last LGraphs finish
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [&in_flight] { return in_flight == 0; });
+  }
+
+  Eprp_var out;
+  out.lnasts = last_cmd_var.lnasts;
+  for (auto &r : results) {
+    out.add(r);
+    for (auto &l : r.lnasts) out.lnasts.emplace_back(l);
+  }
+  last_cmd_var = std::move(out);
+
+  for (const auto &err : errors) {
+    if (err.empty()) continue;
+    parser_error(err);
+    return;
+  }
+  for (const auto &e : exceptions) {
+    if (e) std::rethrow_exception(e);
+  }
+}
+
+static double get_cpu_secs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);  // all the threads
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void Eprp::run_profiled(const std::string &cmd, const Eprp_method &m, Eprp_var &var) {
+  auto cpu_start = get_cpu_secs();
+  auto rss_start = Lbench_sampler::get_rss_kb();
+
+  Lbench b("eprp." + cmd);
+
+  m.method(var);
+
+  std::vector<uint64_t> stats(4, 0);
+  b.read_stats(stats);
+  auto rss = Lbench_sampler::get_rss_kb();
+
+  static std::mutex           profile_mutex;  // streaming pipes run methods in parallel
+  std::lock_guard<std::mutex> lock(profile_mutex);
+
+  auto &p = profile_stats[cmd];
+  p.calls++;
+  p.wall_secs += b.get_secs();
+  p.cpu_secs += get_cpu_secs() - cpu_start;
+  p.rss_delta_kb += rss - rss_start;
+  p.max_rss_kb = std::max(p.max_rss_kb, rss);
+  p.ncycles += stats[0];
+  p.ninst += stats[1];
+  p.nbr_misses += stats[2];
+  p.nmem_misses += stats[3];
+
+  b.end();
+}
+
+void Eprp::print_profile() const {
+  if (profile_stats.empty()) return;
+
+  std::vector<std::pair<std::string, Profile_stats>> sorted(profile_stats.begin(), profile_stats.end());
+  std::sort(sorted.begin(), sorted.end(), [](const auto &a, const auto &b) { return a.second.wall_secs > b.second.wall_secs; });
+
+  double total = 0;
+  for (const auto &it : sorted) total += it.second.wall_secs;
+
+  fmt::print("{:<30} {:>6} {:>10} {:>10} {:>6} {:>12} {:>12} {:>6}\n", "method", "calls", "wall_secs", "cpu_secs", "%wall",
+             "rss_delta_kb", "max_rss_kb", "IPC");
+  for (const auto &[name, p] : sorted) {
+    fmt::print("{:<30} {:>6} {:>10.3f} {:>10.3f} {:>6.1f} {:>12} {:>12} {:>6.2f}\n", name, p.calls, p.wall_secs, p.cpu_secs,
+               total > 0 ? 100.0 * p.wall_secs / total : 0.0, p.rss_delta_kb, p.max_rss_kb, ((double)p.ninst) / (p.ncycles + 1));
+  }
+}
+
+bool Eprp::dump_profile(const std::string &file) const {
+  FILE *f = fopen(file.c_str(), "w");
+  if (f == nullptr) return false;
+
+  fmt::print(f, "{{\"methods\":[");
+  bool first = true;
+  for (const auto &[name, p] : profile_stats) {
+    fmt::print(f,
+               "{}\n  {{\"name\":\"{}\",\"calls\":{},\"wall_secs\":{:.6f},\"cpu_secs\":{:.6f},\"rss_delta_kb\":{},\"max_rss_kb\":{}"
+               ",\"ninst\":{},\"ncycles\":{},\"nbr_misses\":{},\"nmem_misses\":{}}}",
+               first ? "" : ",", name, p.calls, p.wall_secs, p.cpu_secs, p.rss_delta_kb, p.max_rss_kb, p.ninst, p.ncycles,
+               p.nbr_misses, p.nmem_misses);
+    first = false;
+  }
+  fmt::print(f, "\n]}}\n");
+  fclose(f);
+
+  return true;
 }
 
 const std::string &Eprp::get_command_help(const std::string &cmd) const {
@@ -16,6 +16,33 @@ protected:
 
   Eprp_var last_cmd_var;
 
+  // Per method totals when profiling (wall and cpu time, rss, hw counters)
+  struct Profile_stats {
+    size_t   calls        = 0;
+    double   wall_secs    = 0;
+    double   cpu_secs     = 0;
+    int64_t  rss_delta_kb = 0;
+    int      max_rss_kb   = 0;
+    uint64_t ninst        = 0;
+    uint64_t ncycles      = 0;
+    uint64_t nbr_misses   = 0;
+    uint64_t nmem_misses  = 0;
+  };
+  bool                                                   profile = false;
+  std::map<std::string, Profile_stats, eprp_casecmp_str> profile_stats;
+
+  // Streaming pipes (stream_width > 0): the commands in a |> chain are queued until the end of the chain (or a
+  // register). Then, each run of consecutive streamable methods is a per LGraph dataflow, with up to stream_width
+  // LGraphs in flight. The next method starts on one LGraph while the previous is still working on others.
+  // An LGraph starts once its submodules (children_fn) in the same stream are done, so passes see them bottom-up.
+  struct Pipe_stage {
+    std::string cmd;
+    Eprp_var    var;
+  };
+  int                                            stream_width = 0;
+  std::vector<Pipe_stage>                        pipe_stages;
+  std::function<std::vector<LGraph *>(LGraph *)> children_fn;
+
   std::unique_ptr<Ast_parser> ast;
 
   enum Eprp_rules : Rule_id {
@@ -47,6 +74,14 @@ protected:
   void process_ast_handler(const mmap_lib::Tree_index &self, const Ast_parser_node &node);
   void process_ast();
 
+  bool setup_var(const Eprp_method &m, const Eprp_var &args, Eprp_var &var, std::string &err_msg) const;
+  void call_method(const std::string &cmd, const Eprp_method &m, Eprp_var &var);
+  void run_profiled(const std::string &cmd, const Eprp_method &m, Eprp_var &var);
+
+  bool is_streamable(const Pipe_stage &stage) const;
+  void run_pipe();
+  void run_stream(std::vector<Pipe_stage>::const_iterator begin, std::vector<Pipe_stage>::const_iterator end);
+
 public:
   Eprp();
 
@@ -62,6 +97,19 @@ public:
 
   bool readline(const char *line);
 
+  // Time every method call (Lbench scope eprp.<method>) and accumulate per method
+  void set_profile(bool on) { profile = on; }
+  bool is_profile() const { return profile; }
+  void clear_profile() { profile_stats.clear(); }
+  void print_profile() const;
+  bool dump_profile(const std::string &file) const;  // json, false if the file could not be written
+
+  // Up to max_in_flight LGraphs per streaming pipe, 0 disables streaming
+  void set_stream(int max_in_flight) { stream_width = max_in_flight; }
+  int  get_stream() const { return stream_width; }
+  // Submodules of an LGraph, to stream the LGraphs bottom-up (eprp does not know the LGraph hierarchy)
+  void set_children(std::function<std::vector<LGraph *>(LGraph *)> fn) { children_fn = fn; }
+
   const std::string &get_command_help(const std::string &cmd) const;
 
   void get_commands(std::function<void(const std::string &, const std::string &)> fn) const;
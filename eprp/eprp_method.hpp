@@ -17,6 +17,7 @@ protected:
   };
   void add_label(const std::string &attr, const std::string &help, bool required, const std::string &default_value = "");
   const std::string name;
+  bool              streamable = false;
 
 public:
   absl::flat_hash_map<std::string, Label_attr> labels;
@@ -36,4 +37,9 @@ public:
   };
   void               add_label_required(const std::string &attr, const std::string &help_txt) { add_label(attr, help_txt, true); };
   const std::string &get_label_help(const std::string &label) const;
+
+  // The method handles each LGraph in var.lgs independently, and it can run in parallel for different LGraphs. In
+  // streaming pipes (Eprp::set_stream), consecutive streamable methods run per LGraph.
+  void set_streamable(bool s = true) { streamable = s; }
+  bool is_streamable() const { return streamable; }
 };
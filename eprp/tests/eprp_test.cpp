@@ -1,4 +1,12 @@
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
 #include "fmt/format.h"
 
 #include "gtest/gtest.h"
@@ -7,6 +15,7 @@
 class LGraph {
 public:
   int id;
+  std::vector<LGraph *> subs;
 
   LGraph() {
     static int conta=0;
@@ -18,6 +27,7 @@ public:
 
 #include "eprp.hpp"
 #include "eprp_utils.hpp"
+#include "thread_pool.hpp"
 
 static bool is_equal_called = false;
 
@@ -166,3 +176,196 @@ TEST_F(Eprp_test, SimpleReadlinePipe) {
   EXPECT_TRUE(is_equal_called);
 }
 
+
+TEST_F(Eprp_test, Profile) {
+  eprp.set_profile(true);
+  EXPECT_TRUE(eprp.is_profile());
+
+  const char *buffer =" test1.pass check1:foo check2:bar |> test1.pass |> test1.xyz.generate lgdb:./lgdb";
+  eprp.parse_inline(buffer);
+
+  // One row per method, with the number of calls
+  testing::internal::CaptureStdout();
+  eprp.print_profile();
+  fflush(stdout);
+  auto report = testing::internal::GetCapturedStdout();
+
+  std::map<std::string, size_t> report_calls;
+  std::istringstream            report_lines(report);
+  std::string                   line;
+  while (std::getline(report_lines, line)) {
+    std::istringstream row(line);
+    std::string        name;
+    size_t             calls;
+    if (row >> name >> calls) report_calls[name] = calls;
+  }
+  EXPECT_EQ(report.substr(0, 6), "method");
+  EXPECT_EQ(report_calls.size(), 2);
+  EXPECT_EQ(report_calls["test1.pass"], 2);
+  EXPECT_EQ(report_calls["test1.xyz.generate"], 1);
+
+  std::string file = "eprp_test_profile.json";
+  EXPECT_TRUE(eprp.dump_profile(file));
+
+  FILE *f = fopen(file.c_str(), "r");
+  ASSERT_NE(f, nullptr);
+  char txt[4096];
+  auto sz = fread(txt, 1, sizeof(txt) - 1, f);
+  txt[sz] = 0;
+  fclose(f);
+  unlink(file.c_str());
+
+  std::string json(txt);
+  EXPECT_NE(json.find("\"name\":\"test1.pass\",\"calls\":2"), std::string::npos);
+  EXPECT_NE(json.find("\"name\":\"test1.xyz.generate\",\"calls\":1"), std::string::npos);
+
+  eprp.set_profile(false);
+  eprp.clear_profile();
+  eprp.parse_inline(buffer);
+  testing::internal::CaptureStdout();
+  eprp.print_profile();
+  fflush(stdout);
+  EXPECT_EQ(testing::internal::GetCapturedStdout(), "");
+  EXPECT_TRUE(eprp.dump_profile(file));
+  f = fopen(file.c_str(), "r");
+  ASSERT_NE(f, nullptr);
+  sz = fread(txt, 1, sizeof(txt) - 1, f);
+  txt[sz] = 0;
+  fclose(f);
+  unlink(file.c_str());
+  EXPECT_EQ(std::string(txt).find("test1.pass"), std::string::npos);
+}
+
+static std::mutex               stream_mutex;
+static std::vector<std::string> stream_log;
+
+class test_stream {
+public:
+  static void source(Eprp_var &var) {
+    std::vector<LGraph *> lgs;
+    for (int i = 0; i < 8; ++i) lgs.emplace_back(new LGraph());
+    // Parents before children: 0 has {1,2}, 1 has {3,4}, 2 has {4,5,6} (and 6 twice)
+    lgs[0]->subs = {lgs[1], lgs[2]};
+    lgs[1]->subs = {lgs[3], lgs[4]};
+    lgs[2]->subs = {lgs[4], lgs[5], lgs[6], lgs[6]};
+    parent_child.clear();
+    for (auto *lg : lgs) {
+      for (const auto *sub : lg->subs) parent_child.emplace_back(lg->get_id(), sub->get_id());
+      var.add(lg);
+    }
+  }
+  static void stage(Eprp_var &var, const char *name) {
+    EXPECT_EQ(var.lgs.size(), 1);  // one item per call
+    EXPECT_EQ(var.get("label"), "foo");
+    std::lock_guard<std::mutex> lock(stream_mutex);
+    for (const auto *lg : var.lgs) stream_log.emplace_back(fmt::format("{}:{}", name, lg->get_id()));
+  }
+  static void stage1(Eprp_var &var) { stage(var, "s1"); var.add("stage1", "done"); }
+  static void stage2(Eprp_var &var) {
+    EXPECT_EQ(var.get("stage1"), "done");
+    stage(var, "s2");
+  }
+  static void check(Eprp_var &var) {
+    EXPECT_EQ(var.lgs.size(), 8);
+    for (size_t i = 1; i < var.lgs.size(); ++i) EXPECT_LT(var.lgs[i - 1]->get_id(), var.lgs[i]->get_id());
+    EXPECT_EQ(var.get("stage1"), "done");
+    check_called = true;
+  }
+  static inline bool                             check_called = false;
+  static inline std::vector<std::pair<int, int>> parent_child;
+};
+
+TEST_F(Eprp_test, StreamPipe) {
+  Eprp_method m1("test.source", "create lgraphs", &test_stream::source);
+  Eprp_method m2("test.stage1", "per lgraph", &test_stream::stage1);
+  m2.set_streamable();
+  m2.add_label_required("label", "needed label");
+  Eprp_method m3("test.stage2", "per lgraph", &test_stream::stage2);
+  m3.set_streamable();
+  Eprp_method m4("test.check", "all the lgraphs", &test_stream::check);
+  eprp.register_method(m1);
+  eprp.register_method(m2);
+  eprp.register_method(m3);
+  eprp.register_method(m4);
+
+  eprp.set_stream(3);
+  eprp.set_children([](LGraph *lg) { return lg->subs; });
+  stream_log.clear();
+
+  eprp.parse_inline("test.source |> test.stage1 label:foo |> test.stage2 |> #s");
+  EXPECT_FALSE(eprp.has_errors());
+
+  EXPECT_EQ(stream_log.size(), 16);
+  for (size_t i = 0; i < stream_log.size(); ++i) {
+    if (stream_log[i].substr(0, 3) != "s2:") continue;
+    auto s1 = "s1:" + stream_log[i].substr(3);
+    auto it = std::find(stream_log.begin(), stream_log.end(), s1);
+    EXPECT_TRUE(it != stream_log.end() && it < stream_log.begin() + i);  // per lgraph order is kept
+  }
+
+  // Bottom-up, the children are done before the parent starts
+  const auto pos = [](const std::string &entry) {
+    return std::find(stream_log.begin(), stream_log.end(), entry) - stream_log.begin();
+  };
+  EXPECT_EQ(test_stream::parent_child.size(), 8);
+  for (const auto &[parent, child] : test_stream::parent_child) {
+    EXPECT_LT(pos(fmt::format("s2:{}", child)), pos(fmt::format("s1:{}", parent)));
+  }
+
+  // The register has all the lgraphs, in the source order
+  test_stream::check_called = false;
+  eprp.set_stream(0);
+  eprp.parse_inline("#s |> test.check");
+  EXPECT_TRUE(test_stream::check_called);
+}
+
+// stage2 on one LGraph and stage1 on another must be running at the same time. Each side waits (bounded) for the
+// other, so when the stages do not overlap both time out.
+class test_overlap {
+public:
+  static inline std::mutex              mutex;
+  static inline std::condition_variable cv;
+  static inline int                     n_stage1     = 0;
+  static inline bool                    in_stage2    = false;
+  static inline bool                    seen_stage2  = false;
+  static constexpr auto                 wait_timeout = std::chrono::seconds(5);
+
+  static void source(Eprp_var &var) {
+    for (int i = 0; i < 4; ++i) var.add(new LGraph());
+  }
+  static void stage1(Eprp_var &var) {
+    (void)var;
+    std::unique_lock<std::mutex> lock(mutex);
+    if (n_stage1++ == 0) return;  // the first LGraph goes on to stage2
+    if (cv.wait_for(lock, wait_timeout, [] { return in_stage2 || seen_stage2; })) seen_stage2 = true;
+    cv.notify_all();
+  }
+  static void stage2(Eprp_var &var) {
+    (void)var;
+    std::unique_lock<std::mutex> lock(mutex);
+    in_stage2 = true;
+    cv.notify_all();
+    cv.wait_for(lock, wait_timeout, [] { return seen_stage2; });
+    in_stage2 = false;
+  }
+};
+
+TEST_F(Eprp_test, StreamOverlap) {
+  if (Thread_pool::shared().size() < 2) GTEST_SKIP() << "the thread pool needs at least 2 workers";
+
+  Eprp_method m1("test.osource", "create lgraphs", &test_overlap::source);
+  Eprp_method m2("test.ostage1", "per lgraph", &test_overlap::stage1);
+  m2.set_streamable();
+  Eprp_method m3("test.ostage2", "per lgraph", &test_overlap::stage2);
+  m3.set_streamable();
+  eprp.register_method(m1);
+  eprp.register_method(m2);
+  eprp.register_method(m3);
+
+  eprp.set_stream(2);
+  eprp.parse_inline("test.osource |> test.ostage1 |> test.ostage2");
+  EXPECT_FALSE(eprp.has_errors());
+  EXPECT_EQ(test_overlap::n_stage1, 4);
+  EXPECT_TRUE(test_overlap::seen_stage2);
+  eprp.set_stream(0);
+}
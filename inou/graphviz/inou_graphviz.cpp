@@ -149,7 +149,9 @@ void Inou_graphviz::populate_lg_handle_xedge(const Node &node, const XEdge &out,
 void Inou_graphviz::populate_lg_data(LGraph *g) {
   std::string data = "digraph {\n";
 
-  g->each_node_fast([&data, this](const Node &node) {
+  const auto csr = g->freeze();  // read-only pass, sequential edge access
+
+  g->each_node_fast([&data, &csr, this](const Node &node) {
     if (!node.has_inputs() && !node.has_outputs())
       return;
     std::string node_info;
@@ -170,8 +172,8 @@ void Inou_graphviz::populate_lg_data(LGraph *g) {
       data += fmt::format(" {} [label=<{}>];\n", node.debug_name(), node_info);
 
 
-    for (const auto &out : node.out_edges()) {
-      populate_lg_handle_xedge(node, out, data);
+    for (const auto &e : csr.out_edges(node)) {
+      populate_lg_handle_xedge(node, csr.get_xedge(node, e), data);
     }
   });
 
@@ -28,6 +28,12 @@ Inou_rand::Inou_rand(const Eprp_var &var) : Pass("rand", var) {
   rand_crate  = 10;
   rand_eratio = 4;
 
+  if (var.has_label("size")) {
+    bool ok = absl::SimpleAtoi(var.get("size"), &rand_size);
+    if(!ok)
+      Pass::error("size parameter must be integer");
+  }
+
   if (var.has_label("crate")) {
     bool ok = absl::SimpleAtoi(var.get("crate"), &rand_crate);
     if(!ok)
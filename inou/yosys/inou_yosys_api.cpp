@@ -142,6 +142,17 @@ int Inou_yosys_api::call_yosys(mustache::data &vars) {
 
   fmt::print("yosys {} synthesis cmd: {} -m {} using {}\n", filename, yosys, liblg, script_file);
 
+  // Everything allocated before the fork. fromlg is streamable, another thread may hold the malloc lock in the child
+  const std::string log_file = absl::StrCat(filename, ".log");
+  const std::string err_file = absl::StrCat(filename, ".err");
+
+  std::string yosys_str(yosys);
+  std::string liblg_str(liblg);
+  char        opt_q[] = "-q";
+  char        opt_m[] = "-m";
+  char        opt_s[] = "-s";
+  char *      argv[]  = {yosys_str.data(), opt_q, opt_m, liblg_str.data(), opt_s, filename, 0};
+
   int pid = fork();
   if (pid < 0) {
     error("unable to fork??");
@@ -150,19 +161,15 @@ int Inou_yosys_api::call_yosys(mustache::data &vars) {
 
   if (pid == 0) {  // Child
 
-    char filename2[1024 + 32];
-
-    sprintf(filename2, "%s.log", filename);
-    int fd_out = open(filename2, O_CREAT | O_WRONLY | O_TRUNC, 0644);
+    int fd_out = open(log_file.c_str(), O_CREAT | O_WRONLY | O_TRUNC, 0644);
     if (fd_out < 0) {
       fprintf(stderr, "ERROR inou_yosys_api could not create %s file\n", filename);
-      exit(-3);
+      _exit(-3);
     }
-    sprintf(filename2, "%s.err", filename);
-    int fd_err = open(filename2, O_CREAT | O_WRONLY | O_TRUNC, 0644);
+    int fd_err = open(err_file.c_str(), O_CREAT | O_WRONLY | O_TRUNC, 0644);
     if (fd_err < 0) {
       fprintf(stderr, "ERROR inou_yosys_api could not create %s file\n", filename);
-      exit(-3);
+      _exit(-3);
     }
 
     dup2(fd_out, STDOUT_FILENO);
@@ -170,20 +177,9 @@ int Inou_yosys_api::call_yosys(mustache::data &vars) {
     close(fd_err);
     close(fd_out);
 
-    char *argv[] = {strdup(std::string(yosys).c_str()),
-                    strdup("-q"),
-                    strdup("-m"),
-                    strdup(std::string(liblg).c_str()),
-                    strdup("-s"),
-                    strdup(filename),
-                    0};
-
-    if (execvp(std::string(yosys).c_str(), argv) < 0) {
-      error("execvp fail with {}", strerror(errno));
-      exit(-3);
-    }
-
-    exit(0);
+    execvp(argv[0], argv);
+    fprintf(stderr, "ERROR inou_yosys_api execvp fail with %s\n", strerror(errno));
+    _exit(-3);
   }
 
   int wstatus;
@@ -303,7 +299,7 @@ void Inou_yosys_api::do_tolg(Eprp_var &var) {
 }
 
 void Inou_yosys_api::fromlg(Eprp_var &var) {
-  Inou_yosys_api p(var, false);
+  Inou_yosys_api p(var, false);  // one per call, a streaming pipe calls it from several threads
 
   for (auto &lg : var.lgs) {
     mustache::data vars;
@@ -347,6 +343,7 @@ void Inou_yosys_api::setup() {
   m2.add_label_optional("odir", "output directory for generated verilog files", ".");
   m2.add_label_optional("script", "alternative custom inou_yosys_write.ys command");
   m2.add_label_optional("yosys", "path for yosys command", yosys);
+  m2.set_streamable();  // one yosys process and verilog file per lgraph
 
   register_inou("yosys", m2);
 }
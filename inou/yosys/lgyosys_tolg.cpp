@@ -564,11 +564,13 @@ static Node_pin create_join_operator(LGraph *g, const RTLIL::SigSpec &ss) {
   if (inp_pins.size() > 1) {
     auto join_node = g->create_node(Join_Op, ss.size());
 
+    std::vector<std::pair<Node_pin, Node_pin>> edges;  // full fanin known, bulk insert
     int pid = 0;
     for (auto &inp_pin : inp_pins) {
-      g->add_edge(inp_pin, join_node.setup_sink_pin(pid));
+      edges.emplace_back(inp_pin, join_node.setup_sink_pin(pid));
       pid++;
     }
+    g->add_edges(edges);
     dpin = join_node.setup_driver_pin(0);
   } else {
     dpin = inp_pins[0];  // single wire, do not create join
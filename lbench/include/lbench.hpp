@@ -12,12 +12,18 @@
 #include <unistd.h>
 #include <signal.h>
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <iostream>
+#include <mutex>
+#include <thread>
 #include <vector>
 #include <sstream>
 
 #include "likely.hpp"
+#include "lbench_sampler.hpp"
+#include "lbench_trace.hpp"
 
 #include "linux-perf-events.hpp"
 
@@ -25,36 +31,26 @@ class Lbench {
 private:
   LinuxEvents<PERF_TYPE_HARDWARE> linux;
 
-  int parseLine(char *line) {
-    // This assumes that a digit will be found and the line ends in " Kb".
-    int         i = strlen(line);
-    const char *p = line;
-    while(*p < '0' || *p > '9')
-      p++;
-    line[i - 3] = '\0';
-    i           = atoi(p);
-    return i;
-  }
-
   int getValue() { // Note: this value is in KB!
-    FILE *file   = fopen("/proc/self/status", "r");
-    int result = -1;
-    char line[128];
-
-    while(fgets(line, 128, file) != nullptr) {
-      if(strncmp(line, "VmRSS:", 6) == 0) {
-        result = parseLine(line);
-        break;
-      }
-    }
-    fclose(file);
-    return result;
+    return Lbench_sampler::get_rss_kb();
   }
 
-  static inline bool perf_setup   = false;
-  static inline bool perf_enabled = false;
   pid_t perf_pid=0;
 
+  // The hardware counters are one group for the thread that opened them. Nested Lbench read deltas, the outermost
+  // enables and closes the group. Lbench in other threads have no counters. counting_mutex serializes the open and
+  // close of the group, so a thread does not take it while the previous one is still closing it.
+  static inline std::mutex                   counting_mutex;
+  static inline int                          n_counting = 0;
+  static inline std::atomic<std::thread::id> counting_thread;
+  bool                                       counting = false;
+  bool                           sampling = false;  // started the Lbench_sampler
+  std::vector<uint64_t>          start_stats;
+
+  // Lbench_trace scope (nested by thread)
+  size_t parent_path_len = 0;
+  int    depth           = 0;
+
 protected:
   typedef std::chrono::time_point<std::chrono::system_clock> Time_Point;
   struct Time_Sample {
@@ -65,6 +61,7 @@ protected:
     size_t      nbr_misses;
     size_t      nmem_misses;
     std::string name;
+    std::chrono::duration<double> paused;  // paused_time when sampled
   };
   std::vector<Time_Sample> record;
   const std::string        sample_name;
@@ -72,24 +69,29 @@ protected:
   int                      start_mem;
   bool                     end_called;
 
-  void perf_start(const std::string& name) {
-    if (unlikely(!perf_setup)) {
+  // pause/resume: the paused time and counters are not accounted
+  bool                          paused = false;
+  Time_Point                    pause_tp;
+  std::chrono::duration<double> paused_time{0};
+  std::vector<uint64_t>         pause_stats;
+  std::vector<uint64_t>         paused_stats;
+
+  static bool is_perf_enabled() {  // thread safe, Lbench can start in several threads
+    static const bool perf_enabled = []() {
       const char *do_perf = getenv("LGBENCH_PERF");
-      if (do_perf==nullptr) {
-        perf_enabled = false;
-      }else if (do_perf[0]=='0') {
-        perf_enabled = false;
-      }else{
-        perf_enabled = true;
-      }
-      if (perf_enabled && access("/usr/bin/perf", X_OK) == -1) {
+      if (do_perf==nullptr || do_perf[0]=='0')
+        return false;
+      if (access("/usr/bin/perf", X_OK) == -1) {
         std::cerr << "ERROR: lgbench could not find /usr/bin/perf in system\n";
         exit(-3);
       }
+      return true;
+    }();
+    return perf_enabled;
+  }
 
-      perf_setup=true;
-    }
-    if (!perf_enabled)
+  void perf_start(const std::string& name) {
+    if (!is_perf_enabled())
       return;
 
     std::string filename = name.find(".data") == std::string::npos ? (name + ".data") : name;
@@ -106,7 +108,7 @@ protected:
   }
 
   void perf_stop() {
-    if (!perf_enabled)
+    if (!is_perf_enabled())
       return;
     // Kill profiler
     kill(perf_pid,SIGINT);
@@ -127,7 +129,30 @@ public:
       PERF_COUNT_HW_CACHE_REFERENCES
 #endif
     };
-    linux.setup(evts);
+    {
+      std::lock_guard<std::mutex> lock(counting_mutex);
+      if (n_counting == 0) {
+        n_counting      = 1;
+        counting_thread = std::this_thread::get_id();
+        counting        = true;
+        linux.setup(evts);
+        linux.start();
+        sampling = Lbench_sampler::instance().start();  // the counters group is open, the sampler can read it
+      } else if (counting_thread == std::this_thread::get_id()) {
+        n_counting++;
+        counting = true;
+        linux.setup(evts);  // shared group, already enabled
+      }
+    }
+    start_stats.resize(4, 0);
+
+    Lbench_trace::instance();  // trace origin before the first scope starts
+
+    auto &path      = Lbench_trace::ref_path();
+    parent_path_len = path.size();
+    depth           = parent_path_len == 0 ? 0 : 1 + std::count(path.begin(), path.end(), '/');
+    if (!path.empty()) path.push_back('/');
+    path.append(name);
 
     start();
   };
@@ -142,12 +167,50 @@ public:
   void start() {
     start_time = std::chrono::system_clock::now();
     start_mem  = getValue();
-    linux.start();
+    if (counting) linux.sample(start_stats);
+  }
+
+  void read_stats(std::vector<uint64_t> &stats) {
+    if (!counting) return;
+    linux.sample(stats);
+    for (size_t i = 0; i < stats.size(); ++i) {
+      stats[i] -= start_stats[i];
+      if (i < paused_stats.size()) stats[i] -= paused_stats[i];
+    }
+  }
+
+  // Exclude a section (e.g: file I/O) from the time, counters and memory samples
+  void pause() {
+    if (paused || end_called)
+      return;
+    paused   = true;
+    pause_tp = std::chrono::system_clock::now();
+    if (counting) {
+      pause_stats.resize(4, 0);
+      linux.sample(pause_stats);
+    }
+    Lbench_sampler::instance().pause();
   }
 
+  void resume() {
+    if (!paused)
+      return;
+    paused = false;
+    paused_time += std::chrono::system_clock::now() - pause_tp;
+    if (counting) {
+      std::vector<uint64_t> stats(4, 0);
+      linux.sample(stats);
+      paused_stats.resize(4, 0);
+      for (size_t i = 0; i < stats.size(); ++i) paused_stats[i] += stats[i] - pause_stats[i];
+    }
+    Lbench_sampler::instance().resume();
+  }
+
+  bool is_paused() const { return paused; }
+
   void sample(const std::string &name) {
     std::vector<uint64_t> stats(4);
-    linux.sample(stats);
+    read_stats(stats);
 
     Time_Sample s;
     s.tp          = std::chrono::system_clock::now();
@@ -157,6 +220,7 @@ public:
     s.nbr_misses  = stats[2];
     s.nmem_misses = stats[3];
     s.name        = name;
+    s.paused      = paused_time;
 
     record.push_back(s);
   }
@@ -165,7 +229,9 @@ public:
     Time_Point tp = std::chrono::system_clock::now();
 
     Time_Point prev     = start_time;
-    std::chrono::duration<double> t = tp - start_time;
+    std::chrono::duration<double> t = tp - start_time - paused_time;
+    if (paused)
+      t -= tp - pause_tp;
     return t.count();
   }
 
@@ -173,14 +239,30 @@ public:
     if (end_called)
       return;
     end_called = true;
+    resume();
 
     Time_Point tp = std::chrono::system_clock::now();
 
     Time_Point prev     = start_time;
     int        prev_mem = start_mem;
 
+    auto &trace = Lbench_trace::instance();
+    auto &path  = Lbench_trace::ref_path();
+
+    Time_Sample prev_sample;
+    prev_sample.ncycles = prev_sample.ninst = prev_sample.nbr_misses = prev_sample.nmem_misses = 0;
+    prev_sample.paused  = std::chrono::duration<double>(0);
+
     for(const auto &s : record) {
-      std::chrono::duration<double> t = s.tp - prev;
+      if (trace.is_enabled()) {  // phases inside the scope
+        trace.add({s.name, path + "/" + s.name, Lbench_trace::get_tid(), depth + 1, trace.get_us(prev),
+                   trace.get_us(s.tp) - trace.get_us(prev), s.mem, s.mem - prev_mem, s.ninst - prev_sample.ninst,
+                   s.ncycles - prev_sample.ncycles, s.nbr_misses - prev_sample.nbr_misses,
+                   s.nmem_misses - prev_sample.nmem_misses, (s.paused - prev_sample.paused).count() * 1e6});
+      }
+
+      std::chrono::duration<double> t = s.tp - prev - (s.paused - prev_sample.paused);
+      prev_sample = s;
 
       if(s.name == "end" && t.count() < 0.01)
         continue;
@@ -204,17 +286,36 @@ public:
       prev_mem = s.mem;
     }
     std::vector<uint64_t> stats(4);
-    linux.stop(stats);
-    linux.close();
+    read_stats(stats);
+    if (counting) {
+      std::lock_guard<std::mutex> lock(counting_mutex);
+      if (sampling)
+        Lbench_sampler::instance().stop();  // before closing the counters it reads
+      if (--n_counting == 0) {
+        std::vector<uint64_t> dummy(4);
+        linux.stop(dummy);
+        linux.close();
+        counting_thread = std::thread::id();
+      }
+    }
+
+    if (trace.is_enabled()) {
+      int mem = getValue();
+      trace.add({sample_name, path, Lbench_trace::get_tid(), depth, trace.get_us(start_time), trace.get_us(tp) - trace.get_us(start_time),
+                 mem, mem - start_mem, stats[1], stats[0], stats[2], stats[3], paused_time.count() * 1e6});
+    }
+    path.resize(parent_path_len);
 
-    std::chrono::duration<double> t = tp - start_time;
+    std::chrono::duration<double> t = tp - start_time - paused_time;
     std::stringstream sstr;
     sstr
       << sample_name << " secs=" << t.count()
       << ":IPC=" << ((double)stats[1]) / (stats[0]+1)
       << ":BR MPKI=" << ((double)stats[2]*1000) / (stats[1]+1)
-      << ":L2 MPKI=" << ((double)stats[3]*1000) / (stats[1]+1)
-      << "\n";
+      << ":L2 MPKI=" << ((double)stats[3]*1000) / (stats[1]+1);
+    if (sampling)
+      sstr << ":peak RSS=" << Lbench_sampler::instance().get_peak_rss_kb() << "KB";
+    sstr << "\n";
 
     std::cerr << sstr.str();
 
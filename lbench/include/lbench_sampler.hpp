@@ -0,0 +1,239 @@
+//  This file is distributed under the BSD 3-Clause License. See LICENSE for details.
+#pragma once
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "lbench_trace.hpp"
+#include "linux-perf-events.hpp"
+
+// Background thread that samples RSS, the registered gauges (mmap_gc bytes...), and the Lbench hardware counters
+// every LGBENCH_SAMPLE milliseconds (or set_interval_ms). The outermost Lbench starts and stops it, so the curves
+// cover the whole pass. pause/resume skips the samples (e.g. the file I/O phases).
+//
+// The samples are written at exit to <prefix>.samples.csv (prefix from LGBENCH_TRACE, "lbench" otherwise), and as
+// counter tracks in the LGBENCH_TRACE json.
+class Lbench_sampler {
+public:
+  struct Sample {
+    double               ts_us;  // Lbench_trace time
+    int                  rss_kb;
+    std::vector<int64_t> gauges;
+    uint64_t             ninst;  // counters over the last interval
+    uint64_t             ncycles;
+    uint64_t             nbr_misses;
+    uint64_t             nmem_misses;
+  };
+
+private:
+  struct Gauge {
+    std::string              name;
+    std::function<int64_t()> fn;  // called from the sampler thread
+  };
+
+  LinuxEvents<PERF_TYPE_HARDWARE> linux;
+
+  mutable std::mutex      mtx;
+  std::condition_variable cv;
+  std::thread             worker;
+  bool                    running = false;
+  int                     n_paused = 0;
+  int                     interval_ms;
+  int                     peak_rss_kb = 0;
+  size_t                  run_start   = 0;  // first sample of the current run
+
+  std::vector<Gauge>  gauges;
+  std::vector<Sample> samples;
+
+  Lbench_sampler() {
+    Lbench_trace::instance();  // the trace outlives the sampler
+
+    const char *str = getenv("LGBENCH_SAMPLE");
+    interval_ms     = str == nullptr ? 0 : atoi(str);
+  }
+
+  void sample_counters(Sample &s, std::vector<uint64_t> &prev) {
+    s.ninst = s.ncycles = s.nbr_misses = s.nmem_misses = 0;
+    if (!linux.is_open())  // Lbench in another thread or without perf access
+      return;
+
+    std::vector<uint64_t> stats(4, 0);
+    linux.sample(stats);
+    if (!prev.empty()) {
+      s.ncycles     = stats[0] - prev[0];
+      s.ninst       = stats[1] - prev[1];
+      s.nbr_misses  = stats[2] - prev[2];
+      s.nmem_misses = stats[3] - prev[3];
+    }
+    prev = stats;
+  }
+
+  void run() {
+    if (linux.is_open())
+      linux.setup({0, 0, 0, 0});  // group already open by the Lbench, only sizes the read buffer
+
+    std::vector<uint64_t>        prev;
+    std::unique_lock<std::mutex> lock(mtx);
+    while (running) {
+      cv.wait_for(lock, std::chrono::milliseconds(interval_ms));
+      if (!running)
+        break;
+      if (n_paused) {
+        prev.clear();  // do not attribute the paused counters to the next interval
+        continue;
+      }
+
+      Sample s;
+      s.ts_us  = Lbench_trace::instance().get_us(std::chrono::system_clock::now());
+      s.rss_kb = get_rss_kb();
+      for (const auto &g : gauges) s.gauges.emplace_back(g.fn());
+      sample_counters(s, prev);
+
+      if (s.rss_kb > peak_rss_kb)
+        peak_rss_kb = s.rss_kb;
+      samples.emplace_back(std::move(s));
+    }
+  }
+
+  void dump_csv() const {
+    std::string file = Lbench_trace::instance().get_prefix() + ".samples.csv";
+    FILE *      f    = fopen(file.c_str(), "w");
+    if (f == nullptr) {
+      fprintf(stderr, "ERROR: lbench could not write %s\n", file.c_str());
+      return;
+    }
+    fprintf(f, "secs,rss_kb");
+    for (const auto &g : gauges) fprintf(f, ",%s", g.name.c_str());
+    fprintf(f, ",IPC,BR_MPKI,L2_MPKI\n");
+    for (const auto &s : samples) {
+      fprintf(f, "%.6f,%d", s.ts_us / 1e6, s.rss_kb);
+      for (auto v : s.gauges) fprintf(f, ",%lld", static_cast<long long>(v));
+      fprintf(f, ",%.3f,%.3f,%.3f\n", ((double)s.ninst) / (s.ncycles + 1), ((double)s.nbr_misses * 1000) / (s.ninst + 1),
+              ((double)s.nmem_misses * 1000) / (s.ninst + 1));
+    }
+    fclose(f);
+  }
+
+public:
+  Lbench_sampler(const Lbench_sampler &) = delete;
+  Lbench_sampler &operator=(const Lbench_sampler &) = delete;
+
+  ~Lbench_sampler() {
+    stop();
+    if (!samples.empty())
+      dump_csv();
+  }
+
+  static Lbench_sampler &instance() {
+    static Lbench_sampler sampler;
+    return sampler;
+  }
+
+  // Resident set size in KB. Same as VmRSS in /proc/self/status, but the statm fd stays open (cheap to call often)
+  static int get_rss_kb() {
+    static int  statm_fd = ::open("/proc/self/statm", O_RDONLY | O_CLOEXEC);
+    static long page_kb  = sysconf(_SC_PAGESIZE) / 1024;
+    if (statm_fd < 0)
+      return -1;
+
+    char buffer[128];
+    auto sz = ::pread(statm_fd, buffer, sizeof(buffer) - 1, 0);
+    if (sz <= 0)
+      return -1;
+    buffer[sz] = '\0';
+
+    long total_pages, rss_pages;
+    if (sscanf(buffer, "%ld %ld", &total_pages, &rss_pages) != 2)
+      return -1;
+    return static_cast<int>(rss_pages * page_kb);
+  }
+
+  // Extra value sampled with the RSS (must be thread safe). E.g: mmap_gc::get_mmap_bytes
+  void add_gauge(const std::string &name, std::function<int64_t()> fn) {
+    std::lock_guard<std::mutex> lock(mtx);
+    for (auto &g : gauges) {
+      if (g.name == name) {
+        g.fn = fn;
+        return;
+      }
+    }
+    gauges.push_back({name, fn});
+    for (auto &s : samples) s.gauges.resize(gauges.size(), 0);
+  }
+
+  void set_interval_ms(int ms) { interval_ms = ms; }
+  int  get_interval_ms() const { return interval_ms; }
+  bool is_running() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return running;
+  }
+
+  // Peak RSS seen by the samples of the current (or last) run
+  int get_peak_rss_kb() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return peak_rss_kb;
+  }
+
+  const std::vector<Sample> &get_samples() const { return samples; }
+
+  bool start() {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (running || interval_ms <= 0)
+      return false;
+
+    running     = true;
+    n_paused    = 0;
+    peak_rss_kb = get_rss_kb();
+    run_start   = samples.size();
+    worker      = std::thread(&Lbench_sampler::run, this);
+    return true;
+  }
+
+  void stop() {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      if (!running)
+        return;
+      running = false;
+    }
+    cv.notify_all();
+    worker.join();
+
+    auto &trace = Lbench_trace::instance();
+    if (!trace.is_enabled())
+      return;
+    for (size_t i = run_start; i < samples.size(); ++i) {
+      const auto &s = samples[i];
+
+      std::vector<std::pair<std::string, double>> values;
+      values.emplace_back("rss_kb", s.rss_kb);
+      for (size_t j = 0; j < gauges.size(); ++j) values.emplace_back(gauges[j].name, s.gauges[j]);
+      trace.add_counter({"memory", s.ts_us, std::move(values)});
+      if (s.ncycles)
+        trace.add_counter({"IPC", s.ts_us, {{"IPC", ((double)s.ninst) / (s.ncycles + 1)}}});
+    }
+  }
+
+  // Nested pause/resume: no samples while any pause is pending
+  void pause() {
+    std::lock_guard<std::mutex> lock(mtx);
+    n_paused++;
+  }
+
+  void resume() {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (n_paused > 0)
+      n_paused--;
+  }
+};
@@ -0,0 +1,212 @@
+//  This file is distributed under the BSD 3-Clause License. See LICENSE for details.
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Collects the Lbench scopes of the whole run when LGBENCH_TRACE is set (LGBENCH_TRACE=1 writes lbench.trace.json
+// and lbench.csv, LGBENCH_TRACE=foo writes foo.trace.json and foo.csv at exit).
+//
+// Scopes nest per thread: an Lbench created while another is alive in the same thread is its child, and the path
+// is the '/' separated list of names (pass.cprop/module/phase). The trace.json is in Chrome trace-event format
+// (chrome://tracing, perfetto). The csv aggregates by path.
+class Lbench_trace {
+public:
+  struct Event {
+    std::string name;
+    std::string path;
+    int         tid;
+    int         depth;
+    double      ts_us;   // since the trace start
+    double      dur_us;
+    int         rss_kb;
+    int         rss_delta_kb;
+    uint64_t    ninst;
+    uint64_t    ncycles;
+    uint64_t    nbr_misses;
+    uint64_t    nmem_misses;
+    double      paused_us;  // inside dur_us, not accounted in the csv
+  };
+
+  // Value over time (Chrome "C" events), e.g. the Lbench_sampler memory curves
+  struct Counter {
+    std::string                                 name;
+    double                                      ts_us;
+    std::vector<std::pair<std::string, double>> values;
+  };
+
+private:
+  using Time_Point = std::chrono::time_point<std::chrono::system_clock>;
+
+  std::mutex           mtx;
+  std::vector<Event>   events;
+  std::vector<Counter> counters;
+  std::string          prefix;
+  Time_Point           origin;
+  bool                 enabled;
+
+  Lbench_trace() {
+    origin             = std::chrono::system_clock::now();
+    const char *do_trace = getenv("LGBENCH_TRACE");
+    enabled            = do_trace != nullptr && do_trace[0] != '\0' && do_trace[0] != '0';
+    if (enabled) prefix = (do_trace[0] == '1' && do_trace[1] == '\0') ? "lbench" : do_trace;
+  }
+
+  static void write_json_string(FILE *f, const std::string &str) {
+    fputc('"', f);
+    for (auto c : str) {
+      if (c == '"' || c == '\\')
+        fputc('\\', f);
+      else if (static_cast<unsigned char>(c) < 0x20)
+        c = ' ';
+      fputc(c, f);
+    }
+    fputc('"', f);
+  }
+
+  void dump_json(const std::string &file) const {
+    FILE *f = fopen(file.c_str(), "w");
+    if (f == nullptr) {
+      fprintf(stderr, "ERROR: lbench could not write %s\n", file.c_str());
+      return;
+    }
+
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    auto pid   = getpid();
+    for (const auto &e : events) {
+      if (!first) fprintf(f, ",\n");
+      first = false;
+
+      fprintf(f, "{\"name\":");
+      write_json_string(f, e.name);
+      fprintf(f, ",\"cat\":\"lbench\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"path\":", pid, e.tid,
+              e.ts_us, e.dur_us);
+      write_json_string(f, e.path);
+      fprintf(f, ",\"rss_kb\":%d,\"rss_delta_kb\":%d", e.rss_kb, e.rss_delta_kb);
+      if (e.paused_us > 0) fprintf(f, ",\"paused_us\":%.3f", e.paused_us);
+      if (e.ncycles) {
+        fprintf(f, ",\"IPC\":%.3f,\"BR_MPKI\":%.3f,\"L2_MPKI\":%.3f", ((double)e.ninst) / (e.ncycles + 1),
+                ((double)e.nbr_misses * 1000) / (e.ninst + 1), ((double)e.nmem_misses * 1000) / (e.ninst + 1));
+      }
+      fprintf(f, "}}");
+    }
+    for (const auto &c : counters) {
+      if (!first) fprintf(f, ",\n");
+      first = false;
+
+      fprintf(f, "{\"name\":");
+      write_json_string(f, c.name);
+      fprintf(f, ",\"cat\":\"lbench\",\"ph\":\"C\",\"pid\":%d,\"ts\":%.3f,\"args\":{", pid, c.ts_us);
+      bool first_val = true;
+      for (const auto &[key, val] : c.values) {
+        if (!first_val) fputc(',', f);
+        first_val = false;
+        write_json_string(f, key);
+        fprintf(f, ":%.3f", val);
+      }
+      fprintf(f, "}}");
+    }
+    fprintf(f, "\n]}\n");
+    fclose(f);
+  }
+
+  void dump_csv(const std::string &file) const {
+    struct Summary {
+      size_t   calls = 0;
+      double   total_us = 0;
+      double   max_us   = 0;
+      int      max_rss_kb   = 0;
+      int64_t  rss_delta_kb = 0;
+      uint64_t ninst   = 0;
+      uint64_t ncycles = 0;
+      uint64_t nbr_misses  = 0;
+      uint64_t nmem_misses = 0;
+    };
+    std::map<std::string, Summary> summary;  // sorted by path: children after parents
+    for (const auto &e : events) {
+      auto &s = summary[e.path];
+      s.calls++;
+      auto dur = e.dur_us - e.paused_us;
+      s.total_us += dur;
+      if (dur > s.max_us) s.max_us = dur;
+      if (e.rss_kb > s.max_rss_kb) s.max_rss_kb = e.rss_kb;
+      s.rss_delta_kb += e.rss_delta_kb;
+      s.ninst += e.ninst;
+      s.ncycles += e.ncycles;
+      s.nbr_misses += e.nbr_misses;
+      s.nmem_misses += e.nmem_misses;
+    }
+
+    FILE *f = fopen(file.c_str(), "w");
+    if (f == nullptr) {
+      fprintf(stderr, "ERROR: lbench could not write %s\n", file.c_str());
+      return;
+    }
+    fprintf(f, "path,calls,total_secs,max_secs,max_rss_kb,rss_delta_kb,IPC,BR_MPKI,L2_MPKI\n");
+    for (const auto &[path, s] : summary) {
+      fprintf(f, "\"%s\",%zu,%.6f,%.6f,%d,%lld,%.3f,%.3f,%.3f\n", path.c_str(), s.calls, s.total_us / 1e6, s.max_us / 1e6,
+              s.max_rss_kb, static_cast<long long>(s.rss_delta_kb), ((double)s.ninst) / (s.ncycles + 1),
+              ((double)s.nbr_misses * 1000) / (s.ninst + 1), ((double)s.nmem_misses * 1000) / (s.ninst + 1));
+    }
+    fclose(f);
+  }
+
+public:
+  Lbench_trace(const Lbench_trace &) = delete;
+  Lbench_trace &operator=(const Lbench_trace &) = delete;
+
+  ~Lbench_trace() { dump(); }
+
+  static Lbench_trace &instance() {
+    static Lbench_trace trace;
+    return trace;
+  }
+
+  bool is_enabled() const { return enabled; }
+
+  // Output files prefix ("lbench" when the trace is disabled)
+  std::string get_prefix() const { return enabled ? prefix : "lbench"; }
+
+  double get_us(const Time_Point &tp) const { return std::chrono::duration<double, std::micro>(tp - origin).count(); }
+
+  // Small per thread ids (trace viewers show them as rows)
+  static int get_tid() {
+    static std::atomic<int> next_tid{1};
+    thread_local int        tid = next_tid.fetch_add(1);
+    return tid;
+  }
+
+  // Current scope path of the calling thread
+  static std::string &ref_path() {
+    thread_local std::string path;
+    return path;
+  }
+
+  void add(Event &&e) {
+    std::lock_guard<std::mutex> lock(mtx);
+    events.emplace_back(std::move(e));
+  }
+
+  void add_counter(Counter &&c) {
+    std::lock_guard<std::mutex> lock(mtx);
+    counters.emplace_back(std::move(c));
+  }
+
+  void dump() {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!enabled || (events.empty() && counters.empty())) return;
+
+    dump_json(prefix + ".trace.json");
+    dump_csv(prefix + ".csv");
+  }
+};
@@ -29,8 +29,11 @@ public:
   void setup(const std::vector<int> &config_vec) {
     if (!working)
       return;
-    if (fd!=-1)
+    if (fd!=-1) { // group opened by another instance, just size the read buffer
+      num_events = config_vec.size();
+      temp_result_vec.resize(num_events * 2 + 1);
       return;
+    }
 
     memset(&attribs, 0, sizeof(attribs));
     attribs.type = TYPE;
@@ -72,9 +75,9 @@ public:
     fd = -1;
   }
 
-  ~LinuxEvents() {
-    close();
-  }
+  // fd is shared, whoever called start() must call close()
+  ~LinuxEvents() = default;
+
   inline void start() {
     if (fd == -1)
       return;
@@ -124,6 +127,11 @@ public:
     return working;
   }
 
+  // Group opened (and not closed yet) by some instance
+  bool is_open() const {
+    return fd != -1;
+  }
+
 private:
   void report_error(const std::string &context) {
     if (working)
@@ -146,6 +154,8 @@ public:
 
   bool is_working() const { return false; }
 
+  bool is_open() const { return false; }
+
   inline void close() {}
 };
 #endif
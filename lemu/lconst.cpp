@@ -72,7 +72,7 @@ Lconst::Container Lconst::serialize() const {
   v.emplace_back(c);
   v.emplace_back(bits>>8);
   v.emplace_back(bits & 0xFF);
-  boost::multiprecision::export_bits(num, std::back_inserter(v), 8);
+  boost::multiprecision::export_bits(get_num(), std::back_inserter(v), 8);
 
   return v;
 }
@@ -93,7 +93,9 @@ Lconst::Lconst(absl::Span<unsigned char> v) {
   bits = (c1<<8) | c2;
 
   auto s = v.subspan(3);
-  boost::multiprecision::import_bits(num,s.begin(),s.end());
+  Number n;
+  boost::multiprecision::import_bits(n,s.begin(),s.end());
+  set_num(n);
 }
 
 Lconst::Lconst(const Container &v) {
@@ -111,7 +113,9 @@ Lconst::Lconst(const Container &v) {
 
   bits = (c1<<8) | c2;
 
-  boost::multiprecision::import_bits(num,v.begin()+3,v.end());
+  Number n;
+  boost::multiprecision::import_bits(n,v.begin()+3,v.end());
+  set_num(n);
 }
 
 Lconst::Lconst() {
@@ -120,7 +124,8 @@ Lconst::Lconst() {
   explicit_bits = false;
   sign          = false;
   bits          = 1;
-  num           = 0;
+  small         = true;
+  small_num     = 0;
 }
 
 Lconst::Lconst(uint64_t v) {
@@ -128,7 +133,7 @@ Lconst::Lconst(uint64_t v) {
   explicit_sign = false;
   explicit_bits = false;
   sign          = false;
-  num           = v;
+  set_num(v);
   bits          = calc_bits();
 }
 
@@ -137,7 +142,7 @@ Lconst::Lconst(Number v) {
   explicit_sign = false;
   explicit_bits = false;
   sign          = v<0;
-  num           = v;
+  set_num(v);
   bits          = calc_bits();
 }
 
@@ -146,7 +151,7 @@ Lconst::Lconst(uint64_t v, uint16_t b) {
   explicit_sign = false;
   explicit_bits = true;
   sign          = false;
-  num           = (v & ((1ULL<<b)-1)); // clear upper bits if present
+  set_num(b >= 64 ? v : (v & ((1ULL<<b)-1))); // clear upper bits if present
   bits          = b;
   I(calc_bits() <= bits);
 }
@@ -158,11 +163,14 @@ Lconst::Lconst(std::string_view orig_txt) {
   explicit_bits = false;
   sign          = false;
   bits          = 0;
-  num           = 0;
+  small         = true;
+  small_num     = 0;
 
   if (orig_txt.empty())
     return;
 
+  small = false;  // parse in num, set_num at the end
+
   // Skip leading _ as needed
 
   std::string_view txt { orig_txt };
@@ -238,6 +246,7 @@ Lconst::Lconst(std::string_view orig_txt) {
 
         I(!negative);
 
+        set_num(num);
         return;
       }
     }
@@ -317,6 +326,8 @@ Lconst::Lconst(std::string_view orig_txt) {
     bits = nbits_used;
   }
 
+  set_num(num);
+
   I(bits);
 }
 
@@ -324,13 +335,27 @@ void Lconst::dump() const {
   if (explicit_str)
     fmt::print("str:{} bits:{}\n", to_string(), bits);
   else
-    fmt::print("num:{} sign:{} bits:{} explicit_bits:{} explicit_sign:{}\n", num.str(), sign, bits, explicit_bits, explicit_sign);
+    fmt::print("num:{} sign:{} bits:{} explicit_bits:{} explicit_sign:{}\n", get_num().str(), sign, bits, explicit_bits, explicit_sign);
 }
 
 Lconst Lconst::add_op(const Lconst &o) const {
-  auto max_bits = std::max(bits, o.bits);
+  int64_t small_res;
+  if (small && o.small && !__builtin_add_overflow(small_num, o.small_num, &small_res)
+      && small_res != std::numeric_limits<int64_t>::min()) {
+    uint16_t res_bits = small_res == 0 ? 0 : small_msb_bits(small_res);
+
+    auto res_sign = sign && o.sign;
+    if (res_sign)
+      res_bits++;
+
+    auto res_explicit_str  = explicit_str && o.explicit_str;
+    auto res_explicit_sign = explicit_sign && o.explicit_sign && sign == o.sign;
+
+    return Lconst(res_explicit_str, res_explicit_sign, false, res_sign, res_bits, small_res);
+  }
 
-  Number res_num = get_num(max_bits) + o.get_num(max_bits);
+  Number tmp, o_tmp;
+  Number res_num = ref_num(tmp) + o.ref_num(o_tmp);
 
   uint16_t res_bits=0u;
   if (res_num<0)
@@ -349,13 +374,27 @@ Lconst Lconst::add_op(const Lconst &o) const {
   auto res_explicit_sign = explicit_sign && o.explicit_sign && sign == o.sign;
   bool res_explicit_bits = false;
 
-  return Lconst(res_explicit_str, res_explicit_sign, res_explicit_bits, res_sign, res_bits, res_num);
+  return Lconst(res_explicit_str, res_explicit_sign, res_explicit_bits, res_sign, res_bits, std::move(res_num));
 }
 
 Lconst Lconst::sub_op(const Lconst &o) const {
-  auto max_bits = std::max(bits, o.bits);
+  int64_t small_res;
+  if (small && o.small && !__builtin_sub_overflow(small_num, o.small_num, &small_res) && small_res != 0
+      && small_res != std::numeric_limits<int64_t>::min()) {
+    uint16_t res_bits = small_msb_bits(small_res);
 
-  Number res_num = get_num(max_bits) - o.get_num(max_bits);
+    auto res_sign = sign && o.sign;
+    if (res_sign)
+      res_bits++;
+
+    auto res_explicit_str  = explicit_str && o.explicit_str;
+    auto res_explicit_sign = explicit_sign && o.explicit_sign && sign == o.sign;
+
+    return Lconst(res_explicit_str, res_explicit_sign, false, res_sign, res_bits, small_res);
+  }
+
+  Number tmp, o_tmp;
+  Number res_num = ref_num(tmp) - o.ref_num(o_tmp);
 
   uint16_t res_bits=0u;
   if (res_num<0)
@@ -372,47 +411,77 @@ Lconst Lconst::sub_op(const Lconst &o) const {
   auto res_explicit_sign = explicit_sign && o.explicit_sign && sign == o.sign;
   bool res_explicit_bits = false;
 
-  return Lconst(res_explicit_str, res_explicit_sign, res_explicit_bits, res_sign, res_bits, res_num);
+  return Lconst(res_explicit_str, res_explicit_sign, res_explicit_bits, res_sign, res_bits, std::move(res_num));
 }
 
 Lconst Lconst::lsh_op(uint16_t amount) const {
   auto res_bits = bits + amount;
-  auto res_num  = num << amount;
 
-  return Lconst(explicit_str, explicit_sign, explicit_bits, sign, res_bits, res_num);
+  if (small && (small_num == 0 || (small_num != std::numeric_limits<int64_t>::min() && small_msb_bits(small_num) + amount < 63))) {
+    int64_t small_res = static_cast<int64_t>(static_cast<uint64_t>(small_num) << amount);  // two's complement, no UB
+    return Lconst(explicit_str, explicit_sign, explicit_bits, sign, res_bits, small_res);
+  }
+
+  Number tmp;
+  Number res_num = ref_num(tmp) << amount;
+
+  return Lconst(explicit_str, explicit_sign, explicit_bits, sign, res_bits, std::move(res_num));
 }
 
 Lconst Lconst::or_op(const Lconst &o) const {
   auto   res_bits = std::max(bits, o.bits);
-  Number res_num  = get_num(res_bits) | o.get_num(res_bits);
 
   auto res_explicit_str  = explicit_str && o.explicit_str;
   auto res_explicit_sign = explicit_sign && o.explicit_sign && sign == o.sign;
   bool res_explicit_bits = explicit_bits && explicit_bits;
   auto res_sign = sign && o.sign;
 
-  return Lconst(res_explicit_str, res_explicit_sign, res_explicit_bits, res_sign, res_bits, res_num);
+  if (small && o.small)  // two's complement like cpp_int
+    return Lconst(res_explicit_str, res_explicit_sign, res_explicit_bits, res_sign, res_bits, small_num | o.small_num);
+
+  Number tmp, o_tmp;
+  Number res_num = ref_num(tmp) | o.ref_num(o_tmp);
+
+  return Lconst(res_explicit_str, res_explicit_sign, res_explicit_bits, res_sign, res_bits, std::move(res_num));
 }
 
 Lconst Lconst::and_op(const Lconst &o) const {
   auto   res_bits = std::max(bits, o.bits);
-  Number res_num  = get_num(res_bits) & o.get_num(res_bits);
 
   auto res_explicit_str  = explicit_str && o.explicit_str;
   auto res_explicit_sign = explicit_sign && o.explicit_sign && sign == o.sign;
   bool res_explicit_bits = explicit_bits && explicit_bits;
   auto res_sign = sign && o.sign;
 
-  return Lconst(res_explicit_str, res_explicit_sign, res_explicit_bits, res_sign, res_bits, res_num);
+  if (small && o.small)  // two's complement like cpp_int
+    return Lconst(res_explicit_str, res_explicit_sign, res_explicit_bits, res_sign, res_bits, small_num & o.small_num);
+
+  Number tmp, o_tmp;
+  Number res_num = ref_num(tmp) & o.ref_num(o_tmp);
+
+  return Lconst(res_explicit_str, res_explicit_sign, res_explicit_bits, res_sign, res_bits, std::move(res_num));
 }
 
 bool Lconst::eq_op(const Lconst &o) const {
-  auto b = num & o.num;  // zero-extend or drop bits from negative
-  if (num<0 && o.num>0)
-    return b == o.num;
-  if (num>0 && o.num<0)
-    return b == num;
-  return (b==num) && (b==o.num);
+  if (small && o.small) {
+    auto b = small_num & o.small_num;
+    if (small_num<0 && o.small_num>0)
+      return b == o.small_num;
+    if (small_num>0 && o.small_num<0)
+      return b == small_num;
+    return (b==small_num) && (b==o.small_num);
+  }
+
+  Number      tmp, o_tmp;
+  const auto &a_num = ref_num(tmp);
+  const auto &o_num = o.ref_num(o_tmp);
+
+  Number b = a_num & o_num;  // zero-extend or drop bits from negative
+  if (a_num<0 && o_num>0)
+    return b == o_num;
+  if (a_num>0 && o_num<0)
+    return b == a_num;
+  return (b==a_num) && (b==o_num);
 }
 
 Lconst Lconst::adjust_bits(uint16_t amount) const {
@@ -420,17 +489,21 @@ Lconst Lconst::adjust_bits(uint16_t amount) const {
 
   auto res_bits = amount;
 
+  if (small && amount < 63)
+    return Lconst(explicit_str, explicit_sign, true, sign, res_bits, small_num & ((int64_t(1)<<amount)-1));
+
   Number r(1);
-  Number res_num = num & ((r<<amount)-1);
+  Number tmp;
+  Number res_num = ref_num(tmp) & ((r<<amount)-1);
 
-  return Lconst(explicit_str, explicit_sign, true, sign, res_bits, res_num);
+  return Lconst(explicit_str, explicit_sign, true, sign, res_bits, std::move(res_num));
 }
 
 std::string Lconst::to_string() const {
   I(explicit_str);
 
   std::string str;
-  Number tmp = num;
+  Number tmp = get_num();
   while(tmp) {
     unsigned char ch = static_cast<unsigned char>(tmp & 0xFF);
     str.append(1, ch);
@@ -494,6 +567,8 @@ std::string Lconst::to_pyrope() const {
 
 long int Lconst::to_i() const {
   I(is_i());
+  if (small)
+    return small_num;
   return static_cast<long int>(num);
 }
 
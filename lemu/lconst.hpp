@@ -1,6 +1,8 @@
 //  This file is distributed under the BSD 3-Clause License. See LICENSE for details.
 #pragma once
 
+#include <cstdint>
+#include <limits>
 #include <vector>
 
 #include "iassert.hpp"
@@ -76,19 +78,52 @@ protected:
   bool     sign;
 
   uint16_t bits;
+
+  // Values that fit in an int64_t are kept in small_num, and the operations avoid the cpp_int arithmetic. num is only
+  // used (and valid) when !small. Results that do not fit are promoted to num.
+  bool     small;
+  int64_t  small_num;
   Number   num;
 
   void pyrope_bits(std::string *str) const;
 
   std::string_view skip_underscores(std::string_view txt) const;
 
-  Lconst(bool str, bool a, bool b, bool c, uint16_t d, Number n) : explicit_str(str), explicit_sign(a), explicit_bits(b), sign(c), bits(d), num(n) {}
+  Lconst(bool str, bool a, bool b, bool c, uint16_t d, Number n) : explicit_str(str), explicit_sign(a), explicit_bits(b), sign(c), bits(d) {
+    set_num(std::move(n));
+  }
+  Lconst(bool str, bool a, bool b, bool c, uint16_t d, int64_t n)
+      : explicit_str(str), explicit_sign(a), explicit_bits(b), sign(c), bits(d), small(true), small_num(n) {}
+
+  void set_num(Number n) {
+    if (n.backend().size() == 1  // one limb, cheap check before the int64 range compares
+        && n >= std::numeric_limits<int64_t>::min() && n <= std::numeric_limits<int64_t>::max()) {
+      small     = true;
+      small_num = static_cast<int64_t>(n);
+      num       = 0;
+    } else {
+      small = false;
+      num   = std::move(n);
+    }
+  }
+
+  // msb(abs(v))+1, v must be non-zero and not int64_t min
+  static uint16_t small_msb_bits(int64_t v) {
+    uint64_t a = v < 0 ? -static_cast<uint64_t>(v) : static_cast<uint64_t>(v);
+    return 64 - __builtin_clzll(a);
+  }
 
   uint16_t calc_bits() const {
-    if (num == 0) {
+    if (small) {
+      if (small_num == 0)
+        return 1;
+      if (small_num > 0)
+        return small_msb_bits(small_num)+(sign?1:0);
+    } else if (num == 0) {
       return 1;
     }
-    uint16_t v = msb(num)+1+(sign?1:0);
+    Number   tmp;
+    uint16_t v = msb(ref_num(tmp))+1+(sign?1:0);
     return v;
   }
   bool same_explicit_bits(const Lconst &o) const {
@@ -98,15 +133,17 @@ protected:
     return s1 || s2;
   }
 
-  Number get_num() const { return num; }
-  Number get_num(uint16_t b) const {
-    if (num >= 0) {
-      assert(b>=bits);
+  Number get_num() const { return small ? Number(small_num) : num; }
+  // No copy when big (and the small case is a cheap cpp_int)
+  const Number &ref_num(Number &tmp) const {
+    if (!small)
       return num;
-    } else {
-      assert(b>=bits);
-      return num;
-    }
+    tmp = small_num;
+    return tmp;
+  }
+  Number get_num(uint16_t b) const {
+    assert(b>=bits);
+    return get_num();
   }
 public:
   using Container=std::vector<unsigned char>;
@@ -135,7 +172,7 @@ public:
 
   bool     is_unsigned() const { return !sign; }
   // WARNING: unsigned can still be negative. It is a way to indicate as many 1s are needed
-  bool     is_negative() const { return sign && num < 0; }
+  bool     is_negative() const { return sign && (small ? small_num < 0 : num < 0); }
   bool     is_explicit_sign() const { return explicit_sign; }
   bool     is_explicit_bits() const { return explicit_bits; }
   bool     is_string() const { return explicit_str; }
@@ -171,28 +208,26 @@ public:
 #endif
 
   bool operator==(const Lconst &other) const {
+    if (small && other.small)
+      return small_num == other.small_num && same_explicit_bits(other);
     return get_num() == other.get_num() && same_explicit_bits(other);
   }
-  bool operator!=(const Lconst &other) const {
-    return get_num() != other.get_num() || !same_explicit_bits(other);
-  }
+  bool operator!=(const Lconst &other) const { return !(*this == other); }
 
   bool operator==(int other) const {
     if (bits>63)
       return false;
+    if (small)
+      return small_num == other && !explicit_bits;
     return get_num() == other && !explicit_bits;
   }
-  bool operator!=(int other) const {
-    if (bits>63)
-      return true;
-    return get_num() != other || explicit_bits;
-  }
+  bool operator!=(int other) const { return !(*this == other); }
 
-  bool operator<(const Lconst &other) const  { return num <  other.num; }
-  bool operator<=(const Lconst &other) const { return num <= other.num; }
-  bool operator>(const Lconst &other) const  { return num >  other.num; }
-  bool operator>=(const Lconst &other) const { return num >= other.num; }
+  bool operator<(const Lconst &other) const  { return small && other.small ? small_num <  other.small_num : get_num() <  other.get_num(); }
+  bool operator<=(const Lconst &other) const { return small && other.small ? small_num <= other.small_num : get_num() <= other.get_num(); }
+  bool operator>(const Lconst &other) const  { return small && other.small ? small_num >  other.small_num : get_num() >  other.get_num(); }
+  bool operator>=(const Lconst &other) const { return small && other.small ? small_num >= other.small_num : get_num() >= other.get_num(); }
 
-  Number get_raw_num() const { return num; } // for debugging mostly
+  Number get_raw_num() const { return get_num(); } // for debugging mostly
 };
 
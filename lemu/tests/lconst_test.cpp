@@ -1363,3 +1363,128 @@ TEST_F(Lconst_test, lconst_add) {
     EXPECT_EQ(a.get_bits(), 2);
   }
 }
+
+TEST_F(Lconst_test, small_vs_cpp_int) {
+  using boost::multiprecision::cpp_int;
+
+  Lrand<int64_t>        rnd;
+  Lrand_range<int>      shift(0, 70);
+  Lrand_range<uint16_t> nbits(1, 80);
+
+  auto ref_eq = [](const cpp_int &x, const cpp_int &y) {  // Lconst::eq_op semantics
+    cpp_int b = x & y;
+    if (x < 0 && y > 0) return b == y;
+    if (x > 0 && y < 0) return b == x;
+    return b == x && b == y;
+  };
+  auto res_bits = [](const cpp_int &v, bool sign) -> uint16_t {
+    uint16_t b = v == 0 ? 0 : msb(v < 0 ? cpp_int(-v) : v) + 1;
+    return sign ? b + 1 : b;
+  };
+
+  for (int i = 0; i < 20000; ++i) {
+    int64_t a = rnd.any() >> (i % 64);  // all the sizes, both signs
+    int64_t b = rnd.any() >> ((i * 7) % 64);
+
+    Lconst l_a(std::to_string(a));
+    Lconst l_b(std::to_string(b));
+    cpp_int c_a(a);
+    cpp_int c_b(b);
+
+    EXPECT_EQ(l_a.get_raw_num(), c_a);
+    EXPECT_EQ(l_a.is_negative(), a < 0);
+
+    auto add = l_a + l_b;
+    EXPECT_EQ(add.get_raw_num(), c_a + c_b);
+    EXPECT_EQ(add.get_bits(), res_bits(c_a + c_b, a < 0 && b < 0));
+
+    if (a != b) {
+      auto sub = l_a - l_b;
+      EXPECT_EQ(sub.get_raw_num(), c_a - c_b);
+      EXPECT_EQ(sub.get_bits(), res_bits(c_a - c_b, a < 0 && b < 0));
+    }
+
+    EXPECT_EQ(l_a.and_op(l_b).get_raw_num(), c_a & c_b);
+    EXPECT_EQ(l_a.or_op(l_b).get_raw_num(), c_a | c_b);
+    EXPECT_EQ(l_a.eq_op(l_b), ref_eq(c_a, c_b));
+
+    auto amount = shift.any();
+    auto lsh    = l_a << static_cast<uint16_t>(amount);
+    EXPECT_EQ(lsh.get_raw_num(), c_a << amount);
+    EXPECT_EQ(lsh.get_bits(), l_a.get_bits() + amount);
+
+    auto adj = l_a.adjust_bits(nbits.any());
+    EXPECT_EQ(adj.get_raw_num(), c_a & ((cpp_int(1) << adj.get_bits()) - 1));
+
+    EXPECT_EQ(l_a < l_b, a < b);
+    EXPECT_EQ(l_a == l_b, a == b);
+
+    // serialize round trip keeps the small/big value
+    Lconst l_c(l_a.serialize());
+    EXPECT_EQ(l_c.get_raw_num(), l_a.get_raw_num());
+  }
+
+  // promotion and demotion around the int64_t limits
+  auto max = Lconst(static_cast<uint64_t>(std::numeric_limits<int64_t>::max()));
+  auto big = max + Lconst(1);
+  EXPECT_EQ(big.get_raw_num(), cpp_int(std::numeric_limits<int64_t>::max()) + 1);
+  EXPECT_EQ(big.get_bits(), 64);
+  auto back = big - Lconst(2);
+  EXPECT_EQ(back.get_raw_num(), cpp_int(std::numeric_limits<int64_t>::max()) - 1);
+  EXPECT_EQ(back.get_bits(), 63);
+  auto small = (big + Lconst(1LL << 60)) - big;  // demoted, fits in to_i (62 bits)
+  EXPECT_EQ(small.get_raw_num(), cpp_int(1) << 60);
+  EXPECT_EQ(small.to_i(), 1LL << 60);
+  EXPECT_EQ((Lconst(1) << 100).get_raw_num(), cpp_int(1) << 100);
+  EXPECT_EQ(Lconst(~0ULL).get_raw_num(), cpp_int(~0ULL));
+}
+
+TEST_F(Lconst_test, bench_ops) {
+  using boost::multiprecision::cpp_int;
+
+  constexpr int n_vals = 1024;
+  constexpr int n_iter = 20;  // quick, increase for a real measurement
+
+  Lrand<uint32_t> rnd;
+
+  std::vector<Lconst>  small_vals;
+  std::vector<Lconst>  big_vals;  // over 64 bits, cpp_int path
+  std::vector<cpp_int> cpp_vals;
+  for (int i = 0; i < n_vals; ++i) {
+    uint64_t v = (rnd.any() >> (i % 32)) | 1;  // odd, the sub_op below never reaches zero
+    small_vals.emplace_back(Lconst(v));
+    big_vals.emplace_back((Lconst(v) << 70) + Lconst(1));
+    cpp_vals.emplace_back(cpp_int(v));
+  }
+
+  auto run = [&](const std::string &name, const std::vector<Lconst> &vals) {
+    Lbench b("lconst_bench_" + name);
+
+    uint64_t chk = 0;
+    for (int j = 0; j < n_iter; ++j) {
+      for (int i = 1; i < n_vals; ++i) {
+        auto r = vals[i].add_op(vals[i - 1]).and_op(vals[i]).or_op(vals[i - 1]).lsh_op(3).sub_op(vals[i]);
+        chk += r.get_bits() + (r.eq_op(vals[i]) ? 1 : 0);
+      }
+    }
+    auto secs = b.get_secs();
+    fmt::print("lconst {} ops: {:.1f} Mops/s (chk:{})\n", name, 6.0 * n_iter * (n_vals - 1) / secs / 1e6, chk);
+  };
+
+  run("small", small_vals);
+  run("big", big_vals);
+
+  {
+    Lbench b("lconst_bench_cpp_int");
+
+    cpp_int chk = 0;
+    for (int j = 0; j < n_iter; ++j) {
+      for (int i = 1; i < n_vals; ++i) {
+        cpp_int r = ((((cpp_vals[i] + cpp_vals[i - 1]) & cpp_vals[i]) | cpp_vals[i - 1]) << 3) - cpp_vals[i];
+        chk += (r == cpp_vals[i]) ? 1 : 0;
+      }
+    }
+    auto secs = b.get_secs();
+    fmt::print("cpp_int ops: {:.1f} Mops/s (chk:{})\n", 6.0 * n_iter * (n_vals - 1) / secs / 1e6, chk.str());
+  }
+}
@@ -7,10 +7,12 @@
 #include <unistd.h>
 
 #include <cctype>
+#include <cstring>
 #include <iomanip>
 #include <iostream>
 #include <regex>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -264,12 +266,22 @@ int main(int argc, char** argv) {
   I_setup();
 
   bool option_quiet = false;
+  bool option_profile = false;
+  std::string profile_file = "lgshell_profile.json";
+  int option_stream = 0;
 
   std::string cmd;
 
   for(int i=1;i<argc;++i) {
     if (argv[i][0] == '-') {
       if (strcasecmp(argv[1], "-q") == 0) option_quiet = true;
+      if (strncmp(argv[i], "--profile", 9) == 0) {  // --profile or --profile=file.json
+        option_profile = true;
+        if (argv[i][9] == '=') profile_file = argv[i] + 10;
+      }
+      if (strncmp(argv[i], "--stream", 8) == 0) {  // --stream or --stream=max_in_flight
+        option_stream = argv[i][8] == '=' ? atoi(argv[i] + 9) : std::thread::hardware_concurrency();
+      }
     } else {
       if (cmd.empty())
         cmd.append(argv[i]);
@@ -279,10 +291,13 @@ int main(int argc, char** argv) {
   }
 
   Main_api::init();
+  Main_api::set_profile(option_profile);
+  Main_api::set_stream(option_stream);
 
   if (!cmd.empty()) {
     fmt::print("livehd cmd {}\n", cmd);
     Main_api::parse_inline(cmd);
+    Main_api::report_profile(profile_file);
     exit(0);
   }
 
@@ -485,6 +500,8 @@ int main(int argc, char** argv) {
     }
   }
 
+  Main_api::report_profile(profile_file);
+
   if (!option_quiet) std::cerr << "See you soon\n";
 
   if (history) rx.history_save(history_file);
@@ -5,6 +5,8 @@
 #include "cloud_api.hpp"
 #include "inou_lef_api.hpp"
 #include "eprp_utils.hpp"
+#include "lbench_sampler.hpp"
+#include "mmap_gc.hpp"
 
 std::string Main_api::main_path;
 
@@ -52,5 +54,27 @@ void Main_api::init() {
   Cloud_api::setup(Pass::eprp);  // cloud.*
 
   main_path = Eprp_utils::get_exe_path();
+
+  // Streaming pipes run the submodules first (black boxes are not in the stream)
+  Pass::eprp.set_children([](LGraph *lg) {
+    std::vector<LGraph *> subs;
+    lg->each_sub_fast([lg, &subs](Node &node, Lg_type_id lgid) {
+      (void)node;
+      auto *sub_lg = LGraph::open(lg->get_path(), lgid);
+      if (sub_lg) subs.emplace_back(sub_lg);
+    });
+    return subs;
+  });
+
+  // LGBENCH_SAMPLE memory curves also track the lgraph mmaps
+  Lbench_sampler::instance().add_gauge("mmap_kb", []() { return static_cast<int64_t>(mmap_lib::mmap_gc::get_mmap_bytes() / 1024); });
+}
+
+void Main_api::report_profile(const std::string &json_file) {
+  if (!Pass::eprp.is_profile()) return;
+
+  Pass::eprp.print_profile();
+  if (!Pass::eprp.dump_profile(json_file))
+    warn(fmt::format("could not write profile {}", json_file));
 }
 
@@ -41,6 +41,10 @@ public:
 
   static bool has_errors() { return Pass::eprp.has_errors(); }
 
+  static void set_profile(bool on) { Pass::eprp.set_profile(on); }
+  static void set_stream(int max_in_flight) { Pass::eprp.set_stream(max_in_flight); }
+  static void report_profile(const std::string &json_file);
+
   static void init();
 };
 
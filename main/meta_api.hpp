@@ -1,5 +1,7 @@
 //  This file is distributed under the BSD 3-Clause License. See LICENSE for details.
 
+#include <algorithm>
+#include <fstream>
 #include <regex>
 #include <string>
 
@@ -59,6 +61,49 @@ protected:
     glibrary->copy_lgraph(name, dest);
   }
 
+  static void snapshot(Eprp_var &var) {
+    auto        path = var.get("path");
+    auto        name = var.get("name");
+    std::string snap(var.get("snap"));
+    assert(!name.empty());
+
+    auto *glibrary = Graph_library::instance(path);
+    if (snap.empty()) snap = absl::StrCat(name, "__snap");
+
+    glibrary->snapshot_lgraph(name, snap);
+
+    LGraph *lg = LGraph::open(path, snap);
+    if (lg) var.add(lg);
+  }
+
+  static void commit(Eprp_var &var) {
+    auto path = var.get("path");
+    auto snap = var.get("snap");
+    auto name = var.get("name");
+
+    auto *glibrary = Graph_library::instance(path);
+    if (var.get("discard") == "true") {
+      var.lgs.erase(std::remove_if(var.lgs.begin(), var.lgs.end(), [&](LGraph *lg) { return lg->get_name() == snap; }),
+                    var.lgs.end());
+      glibrary->discard_snapshot(snap);
+      return;
+    }
+    if (name.empty()) {
+      Main_api::error(fmt::format("lgraph.commit needs the name of the lgraph to replace with {}", snap));
+      return;
+    }
+
+    // commit closes both lgraphs, pass the new one
+    var.lgs.erase(std::remove_if(var.lgs.begin(), var.lgs.end(),
+                                 [&](LGraph *lg) { return lg->get_name() == snap || lg->get_name() == name; }),
+                  var.lgs.end());
+
+    if (!glibrary->commit_snapshot(snap, name)) return;
+
+    LGraph *lg = LGraph::open(path, name);
+    if (lg) var.add(lg);
+  }
+
   static void match(Eprp_var &var) {
     auto path  = var.get("path");
     auto match = var.get("match");
@@ -89,10 +134,57 @@ protected:
   }
 
   static void stats(Eprp_var &var) {
+    if (var.get("format") != "json") {
+      for (const auto &lg : var.lgs) {
+        assert(lg);
+        lg->print_stats();
+      }
+      return;
+    }
+
+    rapidjson::StringBuffer                          s;
+    rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(s);
+
+    writer.StartObject();
+    writer.Key("lgraph");
+    writer.StartArray();
     for (const auto &lg : var.lgs) {
       assert(lg);
-      lg->print_stats();
+      lg->dump_stats_json(writer);
     }
+    writer.EndArray();
+    writer.EndObject();
+
+    auto file = var.get("file");
+    if (file.empty()) {
+      fmt::print("{}\n", s.GetString());
+      return;
+    }
+
+    std::ofstream fs(std::string(file), std::ios::out | std::ios::trunc);
+    if (!fs.is_open()) {
+      Main_api::error(fmt::format("lgraph.stats could not open {} file", file));
+      return;
+    }
+    fs << s.GetString() << "\n";
+  }
+
+  static void compact(Eprp_var &var) {
+    for (const auto &lg : var.lgs) {
+      assert(lg);
+      if (var.get("order") == "rcm")
+        lg->compact(LGraph::Compact_order::Rcm);
+      else
+        lg->compact(LGraph::Compact_order::Forward);
+      lg->sync();
+    }
+  }
+
+  static void checkpoint(Eprp_var &var) {
+    // The lgraph locks and graph_library files now, the mmaps in the background (the pipeline continues)
+    Graph_library::checkpoint_all();
+    auto ticket = mmap_lib::mmap_gc::checkpoint();
+    if (var.get("wait") == "true") mmap_lib::mmap_gc::wait_checkpoint(ticket);
   }
 
   static void dump(Eprp_var &var) {
@@ -170,6 +262,8 @@ public:
 
     //---------------------
     Eprp_method m3("lgraph.stats", "print the stats from the passed graphs", &Meta_api::stats);
+    m3.add_label_optional("format", "txt or json (per module memory, edge encoding, and hierarchy totals)", "txt");
+    m3.add_label_optional("file", "json output file (default stdout)", "");
 
     eprp.register_method(m3);
 
@@ -224,5 +318,34 @@ public:
     m11.add_label_required("dest", "lgraph destination name");
 
     eprp.register_method(m11);
+
+    //---------------------
+    Eprp_method m12("lgraph.compact", "renumber nodes and drop deleted entries", &Meta_api::compact);
+    m12.add_label_optional("order", "node order: fwd (topological) or rcm (reverse Cuthill-McKee, more short edges)", "fwd");
+
+    eprp.register_method(m12);
+
+    //---------------------
+    Eprp_method m13("lgraph.checkpoint", "write the lgraphs to disk in the background (durability barrier)", &Meta_api::checkpoint);
+    m13.add_label_optional("wait", "true blocks until this and the previous checkpoints are on disk", "false");
+
+    eprp.register_method(m13);
+
+    //---------------------
+    Eprp_method m14("lgraph.snapshot", "copy-on-write copy of a lgraph (reflink), passes the snapshot", &Meta_api::snapshot);
+    m14.add_label_optional("path", "lgraph path", "lgdb");
+    m14.add_label_required("name", "lgraph name");
+    m14.add_label_optional("snap", "snapshot name (default name__snap)", "");
+
+    eprp.register_method(m14);
+
+    //---------------------
+    Eprp_method m15("lgraph.commit", "replace a lgraph with its snapshot (or discard it)", &Meta_api::commit);
+    m15.add_label_optional("path", "lgraph path", "lgdb");
+    m15.add_label_required("snap", "snapshot name");
+    m15.add_label_optional("name", "lgraph to replace", "");
+    m15.add_label_optional("discard", "true drops the snapshot, the lgraph is unchanged", "false");
+
+    eprp.register_method(m15);
   }
 };
@@ -83,5 +83,17 @@ if [ $? -ne 0 ]; then
   exit 1
 fi
 
+echo "lgraph.open name:trivial path:mlgdb |> lgraph.stats format:json file:${SHELL_ODIR}/trivial_stats.json" | ${LGSHELL}
+if [ $? -ne 0 ] || ! grep -q '"short_edges"' ${SHELL_ODIR}/trivial_stats.json; then
+  echo "FAIL: lgraph.stats json for trivial"
+  exit 1
+fi
+
+echo "lgraph.open name:trivial path:mlgdb |> lgraph.compact order:rcm |> lgraph.stats" | ${LGSHELL}
+if [ $? -ne 0 ]; then
+  echo "FAIL: lgraph.compact for trivial"
+  exit 1
+fi
+
 exit 0
 
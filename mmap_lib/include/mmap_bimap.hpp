@@ -2,9 +2,11 @@
 
 #pragma once
 
+#include <memory>
 #include <string_view>
 
 #include "mmap_map.hpp"
+#include "mmap_str_pool.hpp"
 
 namespace mmap_lib {
 template <typename Key, typename T>
@@ -26,6 +28,14 @@ public:
     key2val.clear();
     val2key.clear();
   }
+
+  // Call before the first access (see map::set_policy)
+  void set_policy(const mmap_policy &p) {
+    key2val.set_policy(p);
+    val2key.set_policy(p);
+  }
+  [[nodiscard]] const mmap_policy &get_policy() const { return key2val.get_policy(); }
+
   const_iterator set(Key &&key, T &&val) {
     val2key.set(val, key);
     return key2val.set(key, val);
@@ -116,4 +126,130 @@ public:
   [[nodiscard]] T                get_val(const const_iterator &it) const { return key2val.get(it); }
 };
 
+// bimap<Key, std::string_view> with the text in a str_pool. Both directions store the 32-bit handle, so the text is
+// stored once even when several str_bimaps share the pool (e.g. all the name attributes of an LGraph).
+template <typename Key>
+class str_bimap {
+public:
+  using Key2val_type = typename mmap_lib::map<Key, uint32_t>;
+  using Val2key_type = typename mmap_lib::map<uint32_t, Key>;
+  Key2val_type key2val;
+  Val2key_type val2key;
+
+  using iterator       = typename Key2val_type::iterator;
+  using const_iterator = typename Key2val_type::const_iterator;
+
+private:
+  std::shared_ptr<str_pool> pool;
+
+  void erase_val2key(uint32_t handle, const Key &key) {
+    if (val2key.has(handle) && val2key.get(handle) == key)  // the text may point to a newer key
+      val2key.erase(handle);
+  }
+
+public:
+  explicit str_bimap(std::string_view _path, std::string_view _map_name, std::string_view _pool_name)
+      : key2val(_path, std::string(_map_name) + "_k2v")
+      , val2key(_path, std::string(_map_name) + "_v2k")
+      , pool(str_pool::shared(_path, _pool_name)) {}
+  explicit str_bimap(std::string_view _path, std::string_view _map_name)
+      : str_bimap(_path, _map_name, std::string(_map_name) + "_str") {}
+
+  // The pool is not cleared, other str_bimaps may use it (see str_pool::clear_shared)
+  void clear() {
+    key2val.clear();
+    val2key.clear();
+  }
+
+  // Call before the first access (see map::set_policy). The pool is shared, so no other str_bimap can have used it
+  void set_policy(const mmap_policy &p) {
+    key2val.set_policy(p);
+    val2key.set_policy(p);
+    pool->set_policy(p);
+  }
+  [[nodiscard]] const mmap_policy &get_policy() const { return key2val.get_policy(); }
+
+  const_iterator set(const Key &key, std::string_view val) {
+    const auto handle = pool->insert(val);
+
+    auto it = key2val.find(key);
+    if (it != key2val.end()) {
+      const auto old_handle = key2val.get(it);
+      if (old_handle == handle) return it;
+      erase_val2key(old_handle, key);
+    }
+
+    val2key.set(handle, key);
+    return key2val.set(key, handle);
+  }
+
+  [[nodiscard]] bool has_key(const Key &key) const { return key2val.has(key); }
+  [[nodiscard]] bool has_val(std::string_view val) const {
+    const auto handle = pool->find(val);
+    return handle && val2key.has(handle);
+  }
+
+  [[nodiscard]] std::string_view get_val(const Key &key) const { return pool->get(key2val.get(key)); }
+  [[nodiscard]] Key              get_key(std::string_view val) const { return val2key.get(pool->find(val)); }
+
+  [[nodiscard]] iterator       find(const Key &key) { return key2val.find(key); }
+  [[nodiscard]] const_iterator find(const Key &key) const { return key2val.find(key); }
+  [[nodiscard]] const_iterator find_val(std::string_view val) const {
+    const auto handle = pool->find(val);
+    if (handle == 0) return key2val.end();
+
+    const auto it = val2key.find(handle);
+    if (it == val2key.end()) return key2val.end();
+
+    const auto it2 = key2val.find(val2key.get(it));
+    assert(it2 != key2val.end());
+    return it2;
+  }
+
+  [[nodiscard]] iterator       begin() { return key2val.begin(); }
+  [[nodiscard]] const_iterator begin() const { return key2val.cbegin(); }
+  [[nodiscard]] const_iterator cbegin() const { return key2val.cbegin(); }
+
+  [[nodiscard]] iterator       end() { return key2val.end(); }
+  [[nodiscard]] const_iterator end() const { return key2val.cend(); }
+  [[nodiscard]] const_iterator cend() const { return key2val.cend(); }
+
+  iterator erase(const_iterator pos) {
+    erase_val2key(key2val.get(pos), key2val.get_key(pos));
+    return key2val.erase(pos);
+  }
+
+  iterator erase(iterator pos) {
+    erase_val2key(key2val.get(pos), key2val.get_key(pos));
+    return key2val.erase(pos);
+  }
+
+  size_t erase_key(const Key &key) {
+    auto it = key2val.find(key);
+    if (it == key2val.end()) return 0;
+
+    erase(it);
+
+    return 1;
+  }
+
+  void reserve(size_t sz) {
+    key2val.reserve(sz);
+    val2key.reserve(sz);
+  }
+
+  [[nodiscard]] size_t size() const { return key2val.size(); }
+  [[nodiscard]] bool   empty() const { return key2val.empty(); }
+
+  [[nodiscard]] size_t capacity() const { return key2val.capacity(); }
+
+  [[nodiscard]] Key get_key(const iterator &it) const { return key2val.get_key(it); }
+  [[nodiscard]] Key get_key(const const_iterator &it) const { return key2val.get_key(it); }
+
+  [[nodiscard]] std::string_view get_val(const iterator &it) const { return pool->get(key2val.get(it)); }
+  [[nodiscard]] std::string_view get_val(const const_iterator &it) const { return pool->get(key2val.get(it)); }
+
+  [[nodiscard]] const str_pool &get_pool() const { return *pool; }
+};
+
 }  // namespace mmap_lib
@@ -5,13 +5,26 @@
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <unistd.h>
 
+#include <atomic>
 #include <cassert>
+#include <cerrno>
 #include <climits>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
 #include <functional>
+#include <iostream>
 #include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 
 #ifndef MMAP_LIB_LIKELY
 #define MMAP_LIB_LIKELY(x) __builtin_expect((x), 1)
@@ -21,47 +34,329 @@
 #endif
 
 namespace mmap_lib {
+// Allocation policy of a container mmap. The default comes from the MMAP_LIB_POLICY environment variable, a comma
+// separated list of: hugepage, populate, sequential, random, anonymous (e.g. MMAP_LIB_POLICY=hugepage,populate)
+struct mmap_policy {
+  enum class Access : uint8_t { Normal, Sequential, Random };
+
+  bool   hugepage  = false;  // MADV_HUGEPAGE: anonymous mmaps, or files in tmpfs/filesystems with large folios
+  bool   populate  = false;  // prefault on mmap/remap, no page faults in the first traversal
+  Access access    = Access::Normal;  // MADV_SEQUENTIAL (more readahead) or MADV_RANDOM (no readahead)
+  bool   anonymous = false;  // no file even for named containers (temporary graphs, not persistent)
+
+  static mmap_policy parse(std::string_view txt) {
+    mmap_policy p;
+    while (!txt.empty()) {
+      auto pos = txt.find(',');
+      auto tok = txt.substr(0, pos);
+      txt      = pos == std::string_view::npos ? std::string_view() : txt.substr(pos + 1);
+
+      if (tok == "hugepage")
+        p.hugepage = true;
+      else if (tok == "populate")
+        p.populate = true;
+      else if (tok == "sequential")
+        p.access = Access::Sequential;
+      else if (tok == "random")
+        p.access = Access::Random;
+      else if (tok == "anonymous")
+        p.anonymous = true;
+      else if (!tok.empty())
+        std::cerr << "WARNING: mmap_lib unknown policy '" << tok << "' (hugepage,populate,sequential,random,anonymous)\n";
+    }
+    return p;
+  }
+
+  // Policy for the containers created from now on
+  static mmap_policy &get_default() {
+    static mmap_policy def = parse(getenv("MMAP_LIB_POLICY") ? getenv("MMAP_LIB_POLICY") : "");
+    return def;
+  }
+  static void set_default(const mmap_policy &p) { get_default() = p; }
+};
+
+struct mmap_gc_stats {
+  uint64_t hits;       // accesses (once per epoch) to a mapped container
+  uint64_t misses;     // file mmaps that had been evicted by the gc (remap after recycle_older)
+  uint64_t evictions;  // entries recycled by the gc (not by the container)
+  int      open_mmaps;
+  int      open_fds;
+  size_t   mmap_bytes;  // mapped by all the entries (anonymous and file backed)
+  uint64_t synced_fds;  // files and directories made durable by the finished checkpoints
+};
+
+// Access state of a container, a field of the container itself. touch updates it, the gc reads it when it recycles
+struct mmap_gc_access {
+  uint64_t epoch  = 0;      // epoch of the last access (upper bits) and tag of the thread that did it (tag_bits)
+  uint64_t hits   = 0;      // accesses (once per epoch) while mapped
+  bool     mapped = false;  // set by the gc (under its lock)
+};
+
 struct mmap_gc_entry {
+  static constexpr int      tag_bits = 16;
+  static constexpr uint64_t tag_mask = (UINT64_C(1) << tag_bits) - 1;
+
   static inline int global_age = 1;
   int               age;  // signed (to do quadrants in cleanup)
+  uint64_t          last_access;  // mmap_gc epoch when mapped
+  mmap_gc_access *  access;       // container field updated by touch (nullptr if not tracked)
+  uint64_t          owner;        // tag of the thread that mapped it (if not tracked)
   mmap_gc_entry() {
-    age  = global_age++;
-    size = 0;
-    fd   = -1;
+    age          = global_age++;
+    last_access  = 0;
+    access       = nullptr;
+    owner        = 0;
+    size        = 0;
+    fd          = -1;
   }
   std::string                       name;  // Mostly for debugging
   int                               fd;
   size_t                            size;
   void *                            base;
   std::function<bool(void *, bool)> gc_function;
+  mmap_policy                       policy;
+
+  uint64_t get_last_access() const {
+    if (access == nullptr) return last_access;
+    return std::max(last_access, __atomic_load_n(&access->epoch, __ATOMIC_RELAXED) >> tag_bits);
+  }
+
+  // Thread that used it last, only that thread recycles it
+  uint64_t get_owner() const {
+    if (access == nullptr) return owner;
+    return __atomic_load_n(&access->epoch, __ATOMIC_RELAXED) & tag_mask;
+  }
+};
+
+// Background writeback of the file backed mmaps. The jobs own a dup of the fds, so mmap_gc can recycle (close/munmap)
+// while the flush is in flight. Jobs complete in order, a ticket is done when all the previous ones are done too.
+// A -1 fd in a durable job syncs all the filesystems (too many files to track).
+class mmap_flusher {
+  struct job {
+    std::vector<int> fds;
+    bool             durable;
+    uint64_t         ticket;
+  };
+
+  std::mutex              mtx;
+  std::condition_variable cv_work;
+  std::condition_variable cv_done;
+  std::deque<job>         pending;
+  uint64_t                last_ticket = 0;
+  uint64_t                done_ticket = 0;
+  bool                    stop        = false;
+  std::thread             worker;
+  std::atomic<uint64_t>   n_synced{0};
+
+  static void flush_fd(int fd, bool durable) {
+    if (durable) {
+      ::fdatasync(fd);
+      return;
+    }
+#ifdef __linux__
+    ::sync_file_range(fd, 0, 0, SYNC_FILE_RANGE_WRITE);  // start writeback, do not wait
+#else
+    ::fsync(fd);
+#endif
+  }
+
+  // No malloc/free in the worker: the first one creates a per-thread malloc arena (64MB of address space), and
+  // mmap_gc users run with tight RLIMIT_AS. The submitter pops the finished jobs.
+  void run() {
+    std::unique_lock<std::mutex> lock(mtx);
+    while (true) {
+      cv_work.wait(lock, [this] { return stop || last_ticket > done_ticket; });
+      if (last_ticket == done_ticket) return;  // stop, and everything flushed
+
+      const job *j = nullptr;
+      for (const auto &e : pending) {
+        if (e.ticket > done_ticket) {
+          j = &e;  // deque push_back/pop_front keep the reference valid
+          break;
+        }
+      }
+      assert(j);
+
+      lock.unlock();
+      for (auto fd : j->fds) {
+        if (fd < 0) {
+          if (j->durable) ::sync();
+          continue;
+        }
+        flush_fd(fd, j->durable);
+        ::close(fd);
+        if (j->durable) n_synced.fetch_add(1, std::memory_order_relaxed);
+      }
+      lock.lock();
+
+      done_ticket = j->ticket;
+      cv_done.notify_all();
+    }
+  }
+
+public:
+  ~mmap_flusher() {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      stop = true;
+    }
+    cv_work.notify_all();
+    if (worker.joinable()) worker.join();
+  }
+
+  uint64_t submit(std::vector<int> &&fds, bool durable) {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!worker.joinable()) worker = std::thread(&mmap_flusher::run, this);
+
+    while (!pending.empty() && pending.front().ticket <= done_ticket) pending.pop_front();
+
+    ++last_ticket;
+    pending.push_back({std::move(fds), durable, last_ticket});
+    cv_work.notify_one();
+    return last_ticket;
+  }
+
+  void wait(uint64_t ticket) {
+    std::unique_lock<std::mutex> lock(mtx);
+    cv_done.wait(lock, [this, ticket] { return done_ticket >= ticket; });
+  }
+
+  bool is_done(uint64_t ticket) {
+    std::lock_guard<std::mutex> lock(mtx);
+    return done_ticket >= ticket;
+  }
+
+  uint64_t get_last_ticket() {
+    std::lock_guard<std::mutex> lock(mtx);
+    return last_ticket;
+  }
+
+  uint64_t get_n_synced() const { return n_synced.load(std::memory_order_relaxed); }
 };
 
+// Thread safety: the pool and the counters are protected by mtx, so different threads can open/grow/recycle their
+// own containers. The same container is not thread safe, but it can move to another thread (e.g: opened by the main
+// thread, then used by a pool worker). A container belongs to the last thread that accessed it: touch claims it
+// under mtx when the thread changes. When the fd/mmap limits are hit, the gc only recycles the entries of the calling
+// thread. If the thread has nothing to recycle, the limits overshoot instead of unmapping a container in use.
 class mmap_gc {
 protected:
   using gc_pool_type = absl::flat_hash_map<void *, mmap_gc_entry>;  // pointer stability for delete
   static inline gc_pool_type mmap_gc_pool;
 
+  static inline std::mutex mtx;  // mmap_gc_pool, counters, epoch updates. The *_int/protected methods expect it held
+
   static inline int n_open_mmaps = 0;
   static inline int n_open_fds   = 0;
 
+  // Read by monitors (Lbench sampler) from other threads
+  static inline std::atomic<size_t> n_mmap_bytes{0};
+
   static inline int n_max_mmaps = 512;
   static inline int n_max_fds   = 512;
 
+  // The epoch advances with every new mmap. A container keeps the epoch of its last access in its own field, and
+  // the entry points to it, so touch does not look up or write the pool. The LRU order is exact up to the mmaps
+  // created in between.
+  static inline std::atomic<uint64_t> epoch{1};
+
+  // Per thread tag (1..tag_mask) for the container ownership, 0 until the thread uses mmap_gc
+  static inline std::atomic<uint64_t> n_tags{0};
+  static inline thread_local uint64_t self_tag = 0;
+
+  static uint64_t get_self_tag() {
+    if (MMAP_LIB_UNLIKELY(self_tag == 0)) self_tag = 1 + n_tags.fetch_add(1) % mmap_gc_entry::tag_mask;
+    return self_tag;
+  }
+
+  static uint64_t get_stamp() { return (epoch.load(std::memory_order_relaxed) << mmap_gc_entry::tag_bits) | get_self_tag(); }
+
+  static inline uint64_t n_misses       = 0;
+  static inline uint64_t n_evictions    = 0;
+  static inline uint64_t n_retired_hits = 0;  // hits of the entries no longer in the pool
+
+  // Only to count misses, cleared when too many names are evicted (e.g: files deleted after the eviction)
+  static inline absl::flat_hash_set<std::string> evicted_names;
+  static constexpr size_t                         max_evicted_names = 4096;
+
+  static inline mmap_flusher flusher;
+
+  // Files recycled (closed/munmapped) since the last checkpoint. Their dirty pages are only in the page cache, so the
+  // next checkpoint reopens them to sync
+  static inline absl::flat_hash_set<std::string> recycled_files;
+  static constexpr size_t                         max_recycled_files = 4096;
+  static inline bool                              recycled_overflow  = false;  // the checkpoint syncs everything
+
+  // Containers whose files are not complete yet (e.g: map incremental rehash), finished before a flush
+  static inline absl::flat_hash_map<const void *, std::function<void()>> flush_hooks;
+
+  static std::string_view get_dirname(std::string_view name) {
+    auto pos = name.rfind('/');
+    return pos == std::string_view::npos ? std::string_view(".") : name.substr(0, pos == 0 ? 1 : pos);
+  }
+
+  static uint64_t flush_submit(bool durable) {
+    std::vector<int>                    fds;
+    absl::flat_hash_set<std::string_view> dirs;  // new files are only durable with their directory entry
+    for (const auto &it : mmap_gc_pool) {
+      if (it.second.fd < 0) continue;
+
+      dirs.insert(get_dirname(it.second.name));
+      int fd = ::dup(it.second.fd);
+      if (fd < 0) {  // out of fds, flush in foreground
+        if (durable) ::fdatasync(it.second.fd);
+        continue;
+      }
+      fds.emplace_back(fd);
+    }
+
+    if (recycled_overflow) {
+      fds.emplace_back(-1);
+    } else {
+      for (const auto &name : recycled_files) {
+        int fd = ::open(name.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd >= 0) {
+          fds.emplace_back(fd);
+          dirs.insert(get_dirname(name));
+        } else if (errno != ENOENT) {  // not deleted, but no fd for it
+          fds.emplace_back(-1);
+          break;
+        }
+      }
+    }
+
+    if (durable) {
+      for (auto dir : dirs) {
+        int fd = ::open(std::string(dir).c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd >= 0) fds.emplace_back(fd);
+      }
+      recycled_files.clear();
+      recycled_overflow = false;
+    }
+
+    return flusher.submit(std::move(fds), durable);
+  }
+
   static void recycle_older() {
-    // Recycle around 1/2 of the newer open fds with mmap
+    // Recycle around 1/2 of the least recently used open fds with mmap
 
     int may_recycle_fds   = 0;
     int may_recycle_mmaps = 0;
 
+    const auto self = get_self_tag();
+
     std::vector<mmap_gc_entry> sorted;
-    for (auto it : mmap_gc_pool) {
+    for (const auto &it : mmap_gc_pool) {
       if (it.second.fd < 0) continue;
+      if (it.second.get_owner() != self) continue;  // may be in use by another thread right now
       may_recycle_fds++;
       if (it.second.base) may_recycle_mmaps++;
 
       assert(it.first == it.second.base);
       sorted.emplace_back(it.second);
+      sorted.back().last_access = it.second.get_last_access();
     }
+    if (sorted.empty()) return;  // nothing of this thread, overshoot the limits
 
     int n_recycle_fds   = may_recycle_fds == 1 ? 1 : may_recycle_fds / 2;
     int n_recycle_mmaps = may_recycle_mmaps == 1 ? 1 : may_recycle_mmaps / 2;
@@ -77,7 +372,10 @@ protected:
       << " n_open_fds:" << n_open_fds << " n_max_fds:" << n_max_fds << "\n";
 #endif
 
-    std::sort(sorted.begin(), sorted.end(), [](const mmap_gc_entry &a, const mmap_gc_entry &b) { return a.age < b.age; });
+    std::sort(sorted.begin(), sorted.end(), [](const mmap_gc_entry &a, const mmap_gc_entry &b) {
+      if (a.last_access != b.last_access) return a.last_access < b.last_access;
+      return a.age < b.age;
+    });
 
     if (MMAP_LIB_UNLIKELY(mmap_gc_entry::global_age > 32768)) {  // infrequent but enough for coverage/testing
       mmap_gc_entry::global_age = sorted.size();
@@ -96,7 +394,8 @@ protected:
     }
 #ifndef NDEBUG
     if (sorted.size() > 2) {
-      assert(sorted[0].age < sorted[1].age);
+      assert(sorted[0].last_access < sorted[1].last_access
+             || (sorted[0].last_access == sorted[1].last_access && sorted[0].age < sorted[1].age));
       assert(sorted[0].age);
     }
 #endif
@@ -110,8 +409,11 @@ protected:
       if (done) {
         if (e.base) n_recycle_mmaps--;
         n_recycle_fds--;
+        if (evicted_names.size() >= max_evicted_names) evicted_names.clear();
+        evicted_names.insert(e.name);
         mmap_gc_pool.erase(it);
         n_gc++;
+        n_evictions++;
       }
     }
 #if 0
@@ -144,16 +446,38 @@ protected:
     if (it->second.fd >= 0) {
       ::close(it->second.fd);
       n_open_fds--;
+
+      if (recycled_files.size() >= max_recycled_files) {
+        recycled_files.clear();
+        recycled_overflow = true;
+      }
+      if (!recycled_overflow) recycled_files.insert(it->second.name);
     }
 
     ::munmap(it->first, it->second.size);
     n_open_mmaps--;
+    n_mmap_bytes -= it->second.size;
+
+    if (auto *access = it->second.access) {  // the container counts again from zero when mapped again
+      n_retired_hits += __atomic_exchange_n(&access->hits, 0, __ATOMIC_RELAXED);
+      __atomic_store_n(&access->mapped, false, __ATOMIC_RELAXED);
+    }
 
     // std::cerr << "mmap_gc_pool del name:" << it->second.name << " fd:" << it->second.fd << " base:" << it->first << std::endl;
 
     return true;
   }
 
+  static void try_collect_fd_int() {
+    // std::cerr << "try_collect_fd\n";
+    if (n_open_fds < n_max_fds) {  // readjust max
+      n_max_fds = 1 + 3 * n_open_fds / 4;
+    } else {
+      n_max_fds = n_open_fds / 2;
+    }
+    recycle_older();
+  }
+
   static void try_collect_mmap() {
     // std::cerr << "try_collect_mmap\n";
     if (n_open_mmaps < n_max_mmaps) {  // readjust max
@@ -164,7 +488,38 @@ protected:
     recycle_older();
   }
 
-  static std::tuple<void *, size_t> mmap_step(std::string_view name, int fd, size_t size) {
+  // madvise for the policy. Bytes below populated are already prefaulted (remap)
+  static void advise(void *base, size_t size, bool anon, const mmap_policy &policy, size_t populated = 0) {
+#ifdef MADV_HUGEPAGE
+    if (policy.hugepage) ::madvise(base, size, MADV_HUGEPAGE);
+#endif
+    if (policy.access == mmap_policy::Access::Sequential)
+      ::madvise(base, size, MADV_SEQUENTIAL);
+    else if (policy.access == mmap_policy::Access::Random)
+      ::madvise(base, size, MADV_RANDOM);
+
+#ifdef MADV_POPULATE_WRITE
+    // After MADV_HUGEPAGE so that the prefault already uses hugepages. Read for files (a write fault dirties them)
+    if (policy.populate && populated < size) {
+      ::madvise(static_cast<char *>(base) + populated, size - populated, anon ? MADV_POPULATE_WRITE : MADV_POPULATE_READ);
+    }
+#else
+    (void)anon;
+    (void)populated;
+#endif
+  }
+
+  static int mmap_flags(bool anon, const mmap_policy &policy) {
+    int flags = anon ? (MAP_ANONYMOUS | MAP_PRIVATE) : MAP_SHARED;
+#if !defined(MADV_POPULATE_WRITE) && defined(MAP_POPULATE)
+    if (policy.populate) flags |= MAP_POPULATE;  // older kernels, no hugepage prefault
+#else
+    (void)policy;
+#endif
+    return flags;
+  }
+
+  static std::tuple<void *, size_t> mmap_step(std::string_view name, int fd, size_t size, const mmap_policy &policy) {
     if (size & 0xFFF) {
       size >>= 12;
       size++;
@@ -173,7 +528,8 @@ protected:
     assert((size & 0xFFF) == 0);
 
     if (fd < 0) {
-      void *base = ::mmap(0, size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, fd, 0);  // superpages
+      void *base = ::mmap(0, size, PROT_READ | PROT_WRITE, mmap_flags(true, policy), fd, 0);
+      if (base != MAP_FAILED) advise(base, size, true, policy);
       return {base, size};
     }
 
@@ -197,7 +553,8 @@ protected:
       size = s.st_size;
     }
 
-    void *base = ::mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);  // no superpages
+    void *base = ::mmap(0, size, PROT_READ | PROT_WRITE, mmap_flags(false, policy), fd, 0);
+    if (base != MAP_FAILED) advise(base, size, false, policy);
 
     return std::make_tuple(base, size);
   }
@@ -205,14 +562,54 @@ protected:
 public:
   /* LCOV_EXCL_START */
   static void dump() {
-    for (auto it : mmap_gc_pool) {
-      std::cerr << "name:" << it.second.name << " base:" << it.first << " age:" << it.second.age << " fd:" << it.second.fd
-                << std::endl;
+    std::lock_guard<std::mutex> lock(mtx);
+    dump_int();
+  }
+  static void dump_int() {
+    for (const auto &it : mmap_gc_pool) {
+      std::cerr << "name:" << it.second.name << " base:" << it.first << " age:" << it.second.age
+                << " last_access:" << it.second.get_last_access() << " fd:" << it.second.fd << std::endl;
     }
+    std::cerr << "misses:" << n_misses << " evictions:" << n_evictions << std::endl;
   }
   /* LCOV_EXCL_STOP */
 
+  // Called by the containers on every access (reload) with the access passed to mmap, before checking if the
+  // container is mapped. Only the container field is written (once per epoch), the gc reads it when it recycles.
+  static inline void touch(mmap_gc_access &access) {
+    if (MMAP_LIB_LIKELY(access.epoch == ((epoch.load(std::memory_order_relaxed) << mmap_gc_entry::tag_bits) | self_tag)))
+      return;
+    touch_slow(access);
+  }
+
+  static void touch_slow(mmap_gc_access &access) {
+    const auto tag = get_self_tag();
+    if ((__atomic_load_n(&access.epoch, __ATOMIC_RELAXED) & mmap_gc_entry::tag_mask) == tag) {
+      __atomic_store_n(&access.epoch, get_stamp(), __ATOMIC_RELAXED);
+      if (__atomic_load_n(&access.mapped, __ATOMIC_RELAXED)) __atomic_fetch_add(&access.hits, 1, __ATOMIC_RELAXED);
+      return;
+    }
+    // Last used by another thread: claim it under the lock. Either that thread's gc sees the new owner, or it
+    // already recycled the container and the caller sees it unmapped (and maps it again)
+    std::lock_guard<std::mutex> lock(mtx);
+    __atomic_store_n(&access.epoch, get_stamp(), __ATOMIC_RELAXED);
+    if (access.mapped) __atomic_fetch_add(&access.hits, 1, __ATOMIC_RELAXED);
+  }
+
+  static mmap_gc_stats get_stats() {
+    std::lock_guard<std::mutex> lock(mtx);
+    uint64_t hits = n_retired_hits;
+    for (const auto &it : mmap_gc_pool) {
+      if (it.second.access) hits += __atomic_load_n(&it.second.access->hits, __ATOMIC_RELAXED);
+    }
+    return {hits, n_misses, n_evictions, n_open_mmaps, n_open_fds, n_mmap_bytes.load(), flusher.get_n_synced()};
+  }
+
+  // Thread safe, meant for periodic monitors
+  static size_t get_mmap_bytes() { return n_mmap_bytes.load(std::memory_order_relaxed); }
+
   static void delete_file(void *base) {
+    std::lock_guard<std::mutex> lock(mtx);
     auto it = mmap_gc_pool.find(base);
     assert(it != mmap_gc_pool.end());
     assert(it->second.fd >= 0);
@@ -227,6 +624,7 @@ public:
   // mmap_map.hpp:    mmap_txt_fd = mmap_gc::open(mmap_name + "txt");
   // mmap_vector.hpp: mmap_fd     = mmap_gc::open(mmap_name);
   static int open(const std::string &name) {
+    std::lock_guard<std::mutex> lock(mtx);
 #if 0
     std::cerr << "mmap_gc_pool open filename:" << name 
       << " n_open_fds=" << n_open_fds
@@ -249,7 +647,7 @@ public:
       n_open_fds++;
       return fd;
     }
-    try_collect_fd();
+    try_collect_fd_int();
     fd = ::open(name.c_str(), O_RDWR | O_CREAT, 0644);
     if (fd >= 0) {
       n_open_fds++;
@@ -257,7 +655,7 @@ public:
     }
 
     /* LCOV_EXCL_STOP */
-    dump();  // We were not able to find fds to recycle
+    dump_int();  // We were not able to find fds to recycle
     assert(false);
     /* LCOV_EXCL_START */
 
@@ -267,6 +665,7 @@ public:
   // mmap_map.hpp:    mmap_gc::recycle(mmap_base);
   // mmap_vector.hpp: mmap_gc::recycle(mmap_base);
   static void recycle(void *base) {
+    std::lock_guard<std::mutex> lock(mtx);
     // Remove from gc
     auto it = mmap_gc_pool.find(base);
     assert(it != mmap_gc_pool.end());
@@ -282,11 +681,14 @@ public:
   // this, std::placeholders::_1)); mmap_map.hpp:    std::tie(base, size)      = mmap_gc::mmap(mmap_name, fd, size,
   // std::bind(&map<MaxLoadFactor100, Key, T, Hash>::gc_function, this, std::placeholders::_1));
   static std::tuple<void *, size_t> mmap(std::string_view name, int fd, size_t size,
-                                         std::function<bool(void *, bool)> gc_function) {
-    auto [base, final_size] = mmap_step(name, fd, size);
+                                         std::function<bool(void *, bool)> gc_function,
+                                         const mmap_policy &                policy       = mmap_policy::get_default(),
+                                         mmap_gc_access *                   access       = nullptr) {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto [base, final_size] = mmap_step(name, fd, size, policy);
     if (base == MAP_FAILED) {
       try_collect_mmap();
-      std::tie(base, final_size) = mmap_step(name, fd, size);
+      std::tie(base, final_size) = mmap_step(name, fd, size, policy);
       /* LCOV_EXCL_START */
       if (base == MAP_FAILED) {
         std::cerr << "ERROR mmap_lib::mmap could not check allocate " << size / 1024 << "KBs for " << name << std::endl;
@@ -295,6 +697,15 @@ public:
       /* LCOV_EXCL_STOP */
     }
     n_open_mmaps++;
+    n_mmap_bytes += final_size;
+
+    if (fd >= 0 && !evicted_names.empty()) {
+      auto it = evicted_names.find(std::string(name));
+      if (it != evicted_names.end()) {
+        n_misses++;
+        evicted_names.erase(it);
+      }
+    }
 
     mmap_gc_entry entry;
     entry.name        = name;
@@ -302,6 +713,14 @@ public:
     entry.size        = final_size;
     entry.gc_function = gc_function;
     entry.base        = base;
+    entry.policy      = policy;
+    entry.owner        = get_self_tag();
+    entry.access       = access;
+    entry.last_access = epoch.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (access) {
+      __atomic_store_n(&access->epoch, get_stamp(), __ATOMIC_RELAXED);
+      __atomic_store_n(&access->mapped, true, __ATOMIC_RELAXED);
+    }
 
     assert(mmap_gc_pool.find(base) == mmap_gc_pool.end());
     // std::cerr << "mmap_gc_pool add name:" << name << " fd:" << fd << " base:" << base << std::endl;
@@ -320,6 +739,7 @@ public:
     }
     assert((new_size & 0xFFF) == 0);
 
+    std::lock_guard<std::mutex> lock(mtx);
     auto it = mmap_gc_pool.find(mmap_old_base);
     assert(it != mmap_gc_pool.end());
 
@@ -369,6 +789,10 @@ public:
 #endif
     auto entry = it->second;
     entry.size = new_size;
+    n_mmap_bytes += new_size;
+    n_mmap_bytes -= old_size;
+
+    if (new_size > old_size) advise(base, new_size, entry.fd < 0, entry.policy, old_size);
 
     // std::cerr << "mmap_gc_pool del name:" << entry.name << " fd:" << entry.fd << " base:" << mmap_old_base << std::endl;
     mmap_gc_pool.erase(it);  // old mmap_old_base
@@ -380,14 +804,52 @@ public:
     return std::make_tuple(base, new_size);
   }
 
-  static void try_collect_fd() {
-    // std::cerr << "try_collect_fd\n";
-    if (n_open_fds < n_max_fds) {  // readjust max
-      n_max_fds = 1 + 3 * n_open_fds / 4;
-    } else {
-      n_max_fds = n_open_fds / 2;
+  // Start the writeback of all the file backed mmaps in the background (not durable, it is a hint to the kernel).
+  // Returns a ticket for wait_checkpoint/is_checkpoint_done
+  static uint64_t flush_async() {
+    run_flush_hooks();
+    std::lock_guard<std::mutex> lock(mtx);
+    return flush_submit(false);
+  }
+
+  // Durability barrier: once the ticket is done, the data written before the call is in stable storage. This covers
+  // the open file mmaps, the files recycled since the last checkpoint, and their directories. The caller can keep
+  // computing (even modify the mmaps) while the checkpoint is in flight
+  static uint64_t checkpoint() {
+    run_flush_hooks();
+    std::lock_guard<std::mutex> lock(mtx);
+    return flush_submit(true);
+  }
+
+  // A container registers a hook while its file misses entries (they are only in an anonymous mmap). Flushes and
+  // file copies (run_flush_hooks) complete it first. The hook runs in the calling thread, so the container must not
+  // be in use by another thread.
+  static void set_flush_hook(const void *owner, std::function<void()> fn) {
+    std::lock_guard<std::mutex> lock(mtx);
+    flush_hooks[owner] = std::move(fn);
+  }
+  static void clear_flush_hook(const void *owner) {
+    std::lock_guard<std::mutex> lock(mtx);
+    flush_hooks.erase(owner);
+  }
+  static void run_flush_hooks() {
+    std::vector<std::function<void()>> pending;
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      if (flush_hooks.empty()) return;
+      for (const auto &it : flush_hooks) pending.emplace_back(it.second);
     }
-    recycle_older();
+    for (auto &fn : pending) fn();  // clears its own hook
+  }
+
+  static void wait_checkpoint(uint64_t ticket) { flusher.wait(ticket); }
+  static void wait_checkpoint() { flusher.wait(flusher.get_last_ticket()); }  // all the submitted ones
+
+  static bool is_checkpoint_done(uint64_t ticket) { return flusher.is_done(ticket); }
+
+  static void try_collect_fd() {
+    std::lock_guard<std::mutex> lock(mtx);
+    try_collect_fd_int();
   }
 
 };
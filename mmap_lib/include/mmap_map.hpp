@@ -419,6 +419,14 @@ struct hash<std::string_view> {
 	}
 };
 
+// Keys that wrap an index (node ids, pin ids...) can use a direct-indexed table: the id is the hash. Specialize
+// for key types that wrap an index (see core/node.hpp).
+template <typename T>
+struct dense_key {
+	static constexpr bool value = std::is_integral<T>::value;
+	static uint64_t get(T const& key) { return static_cast<uint64_t>(key); }
+};
+
 // std::enable_if_t<is_array_serializable<T>::value && !std::is_same_v<T,std::string_view>, int> = 0
 
 template<class T>
@@ -474,6 +482,11 @@ private:
   static constexpr bool    using_val_sview      = is_array_serializable<T>::value;
   static constexpr bool    using_sview          = using_key_sview || using_val_sview;
 	static constexpr size_t  InitialNumElements   = 1024;
+	static constexpr size_t  RehashStepBuckets    = 16;      // old buckets migrated per insert/erase during incremental rehash
+	static constexpr size_t  RehashMinBuckets     = 1 << 16; // default for set_incremental_rehash
+	static constexpr size_t  ShrinkOccupancy      = 16;      // shrink to 1/4 buckets when less than 1/16 are used
+	static constexpr float   DenseRatio           = 2.0f;    // default for set_dense
+	static constexpr uint16_t FormatVersion       = 1;       // bump when the header layout or the hashing changes
 	static constexpr int     InitialInfoNumBits   = 5;
 	static constexpr uint8_t InitialInfoInc       = 1 << InitialInfoNumBits;
 	static constexpr uint8_t InitialInfoHashShift = sizeof(size_t) * 8 - InitialInfoNumBits;
@@ -706,17 +719,19 @@ private:
     if (iter_cntr && !force_recycle)
       return true;
 
+    if (rehash_old.base && !force_recycle)  // The old table is not backed by a file, and the new one is incomplete
+      return true;
+
     if (mmap_base != base) {  // WARNING: Possible because 2 mmaps can be active during rehash
       return false;
     }
 
-    if(mmap_fd >= 0 && empty()) {
+    mmap_base = nullptr;
+    if(mmap_fd >= 0 && *mNumElements == 0) {  // not empty(), it may reload inside the gc
       unlink(mmap_name.c_str());
+      mmap_size = 0;  // the reload starts a new table, the zero header of a new file is not a table
     }
-
-    mmap_base = nullptr;
-    // NOTE: preserve mmap_size to avoid read file in reload
-    // mmap_size = 0;
+    // NOTE: otherwise preserve mmap_size to avoid read file in reload
     mmap_fd   = -1;
 
     return false;
@@ -761,7 +776,7 @@ private:
     auto gc_func = std::bind(&map<MaxLoadFactor100, Key, T, Hash>::gc_done, this, std::placeholders::_1, std::placeholders::_2);
 
     void *base = nullptr;
-    std::tie(base, size) = mmap_gc::mmap(name, fd, size, gc_func);
+    std::tie(base, size) = mmap_gc::mmap(name, fd, size, gc_func, policy);
 
 		return std::make_tuple(reinterpret_cast<uint64_t *>(base),size);
 	}
@@ -807,7 +822,7 @@ private:
     {
       auto  gc_func             = std::bind(&map<MaxLoadFactor100, Key, T, Hash>::gc_done, this, std::placeholders::_1, std::placeholders::_2);
       void* base                = nullptr;
-      std::tie(base, mmap_size) = mmap_gc::mmap(mmap_name, mmap_fd, new_mmap_size, gc_func);
+      std::tie(base, mmap_size) = mmap_gc::mmap(mmap_name, mmap_fd, new_mmap_size, gc_func, policy, &mmap_access);
       mmap_base                 = reinterpret_cast<uint64_t*>(base);
     }
 
@@ -816,6 +831,9 @@ private:
 		mMaxNumElementsAllowed = &mmap_base[2];
 		mInfoInc               = reinterpret_cast<InfoType *>(&mmap_base[3]);
 		mInfoHashShift         = reinterpret_cast<InfoType *>(&mmap_base[4]);
+		mDense                 = reinterpret_cast<uint16_t *>(&mmap_base[3]) + 2; // upper half, unused by mInfoInc
+		mVersion               = reinterpret_cast<uint16_t *>(&mmap_base[3]) + 3; // 0 in files from older maps
+		mMaxId                 = reinterpret_cast<uint32_t *>(&mmap_base[4]) + 1;
 
 		mInfo = reinterpret_cast<uint8_t*>(&mmap_base[5]);
 		if (*mMask == n_entries - 1 || n_entries==0) {
@@ -823,6 +841,12 @@ private:
 			assert(calc_mmap_size(*mMask+1)<=mmap_size);
 			assert(mInfo[*mMask+1] == 1); // Sentinel
 			mKeyVals = reinterpret_cast<Node*>(&mmap_base[5+(*mMask+9)/sizeof(uint64_t)]);
+			if (MMAP_LIB_UNLIKELY(*mVersion != FormatVersion))
+				upgrade_format();
+			if constexpr (dense_key<Key>::value) {
+				if (MMAP_LIB_UNLIKELY(*mMaxId == 0 && *mNumElements > 1))  // file from before max_id was tracked
+					*mMaxId = scan_max_id();
+			}
     }else{
 			assert(*mMaxNumElementsAllowed <= n_entries); // less due to load factor
 			assert(*mNumElements==0);
@@ -832,6 +856,9 @@ private:
 			mInfo[n_entries] = 1; // Sentinel
       *mInfoInc       = InitialInfoInc;
       *mInfoHashShift = InitialInfoHashShift;
+      *mDense         = 0;
+      *mVersion       = FormatVersion;
+      *mMaxId         = 0;
 			mKeyVals = reinterpret_cast<Node*>(&mmap_base[5+(*mMask+9)/sizeof(uint64_t)]); // 9 to be 8 byte aligned
 		}
 	}
@@ -871,11 +898,12 @@ private:
 
     auto gc_func = std::bind(&map<MaxLoadFactor100, Key, T, Hash>::gc_txt_done, this, std::placeholders::_1, std::placeholders::_2);
     void *base = nullptr;
-    std::tie(base, mmap_txt_size) = mmap_gc::mmap(mmap_name + "txt", mmap_txt_fd, new_mmap_txt_size, gc_func);
+    std::tie(base, mmap_txt_size) = mmap_gc::mmap(mmap_name + "txt", mmap_txt_fd, new_mmap_txt_size, gc_func, policy, &mmap_txt_access);
 		mmap_txt_base = reinterpret_cast<uint64_t *>(base);
 	}
 
 	__attribute__((inline)) void reload() const {
+    mmap_gc::touch(mmap_access);  // before the check, claims the map for this thread
     if (MMAP_LIB_UNLIKELY(mmap_base==nullptr)) {
       assert(mmap_base == nullptr);
       assert(mmap_fd < 0);
@@ -885,6 +913,7 @@ private:
       assert(mmap_base);
     }
     if constexpr (using_sview) {
+      mmap_gc::touch(mmap_txt_access);
       if (MMAP_LIB_UNLIKELY(mmap_txt_base == nullptr)) {
         assert(mmap_txt_base == nullptr);
         assert(mmap_txt_fd < 0);
@@ -900,16 +929,31 @@ private:
 	// Lower bits are used for indexing into the vector (2^n size)
 	// The upper 1-5 bits need to be a reasonable good hash, to save comparisons.
 	void keyToIdx(const Key &key, int& idx, InfoType& info) const {
+    reload();
+
+    keyToIdx(key, idx, info, *mMask, *mInfoInc, *mInfoHashShift, *mDense);
+	}
+
+	// Same hashing for a table with the given mask/info (the old table during an incremental rehash)
+	void keyToIdx(const Key &key, int& idx, InfoType& info, uint64_t mask, InfoType info_inc, InfoType info_hash_shift, bool dense) const {
 		static constexpr size_t bad_hash_prevention =
 			std::is_same<::mmap_lib::hash<key_type>, hasher>::value
 			? 1
 			: (mmap_map_BITNESS == 64 ? UINT64_C(0xb3727c1f779b8d8b) : UINT32_C(0xda4afe47));
 
-    reload();
-
-    idx = Hash::operator()(key) * bad_hash_prevention;
-		info = static_cast<InfoType>(*mInfoInc + static_cast<InfoType>(idx >> *mInfoHashShift));
-		idx &= *mMask;
+    // full width hash: an int idx made the shift undefined and broke the info ordering (set missed existing keys)
+    size_t h;
+    if constexpr (dense_key<Key>::value) {
+      if (dense)
+        h = dense_key<Key>::get(key);  // direct-indexed, no hashing
+      else
+        h = Hash::operator()(key) * bad_hash_prevention;
+    } else {
+      (void)dense;
+      h = Hash::operator()(key) * bad_hash_prevention;
+    }
+		info = static_cast<InfoType>(info_inc + static_cast<InfoType>(h >> info_hash_shift));
+		idx = static_cast<int>(h & mask);
 	}
 
 	// forwards the index by one, wrapping around at the end
@@ -973,11 +1017,14 @@ private:
 		// TODO we don't need to move everything, just the last one for the same bucket.
 		mKeyVals[idx].destroy(*this);
 
-		while (mInfo[idx+1] >= 2 * *mInfoInc) {
-			mInfo[idx] = static_cast<uint8_t>(mInfo[idx+1] - *mInfoInc);
-			//mKeyVals[idx] = std::move(mKeyVals[idx+1]);
-      std::memmove(&mKeyVals[idx], &mKeyVals[idx+1], sizeof(Node));
-			++idx;
+		// wrap around like next_idx, or an entry pushed from the last bucket to the first becomes unreachable
+		auto next = next_idx(idx);
+		while (mInfo[next] >= 2 * *mInfoInc) {
+			mInfo[idx] = static_cast<uint8_t>(mInfo[next] - *mInfoInc);
+			//mKeyVals[idx] = std::move(mKeyVals[next]);
+      std::memmove(&mKeyVals[idx], &mKeyVals[next], sizeof(Node));
+			idx  = next;
+			next = next_idx(idx);
 		}
 
 		mInfo[idx] = 0;
@@ -1023,6 +1070,89 @@ private:
 			return -1; //*mMask == 0 ? 0 : *mMask + 1;
 		}
 
+	// findIdx in the old table during an incremental rehash. The old table is never updated while buckets are
+	// migrated, so entries below rehash_old.pos are stale copies (already moved, maybe erased after).
+	template <typename Other>
+		int rehash_findIdx(Other const& key) const {
+			assert(rehash_old.base);
+
+			int idx;
+			InfoType info;
+			keyToIdx(key, idx, info, rehash_old.mask, rehash_old.info_inc, rehash_old.info_hash_shift, rehash_old.dense);
+
+			do {
+				if (info == rehash_old.info[idx] && equals(key, rehash_old.keyvals[idx].getFirst())) {
+					if (static_cast<size_t>(idx) < rehash_old.pos)
+						return -1;
+					return idx;
+				}
+				idx  = (idx + 1) & rehash_old.mask;
+				info = static_cast<InfoType>(info + rehash_old.info_inc);
+			} while (info <= rehash_old.info[idx]);
+
+			return -1;
+		}
+
+	// Lookup in both tables (read only, no migration)
+	template <typename Other>
+		Node *findNode(Other const& key) const {
+			auto idx = findIdx(key);
+			if (MMAP_LIB_LIKELY(idx >= 0))
+				return &mKeyVals[idx];
+			if (MMAP_LIB_LIKELY(rehash_old.base == nullptr))
+				return nullptr;
+
+			idx = rehash_findIdx(key);
+			if (idx < 0)
+				return nullptr;
+			return &rehash_old.keyvals[idx];
+		}
+
+	// findIdx for calls that return an iterator. Iterators only walk the new table, so finish the migration if
+	// the key is still in the old table.
+	template <typename Other>
+		int findIdx_sync(Other const& key) const {
+			auto idx = findIdx(key);
+			if (MMAP_LIB_UNLIKELY(idx < 0 && rehash_old.base && rehash_findIdx(key) >= 0)) {
+				const_cast<Self *>(this)->rehash_finish();
+				idx = findIdx(key);
+			}
+			return idx;
+		}
+
+	// Remove a key not yet migrated. The shift down moves entries from higher positions, so it never moves an
+	// entry to the already migrated buckets unless the cluster wraps around. In that (rare) case, finish the
+	// migration and let the caller handle the key in the new table.
+	template <typename Other>
+		bool rehash_erase(Other const& key) {
+			if (rehash_old.base == nullptr)
+				return false;
+
+			auto idx = rehash_findIdx(key);
+			if (idx < 0)
+				return false;
+
+			auto *info = rehash_old.info;
+			for (size_t next = (idx + 1) & rehash_old.mask; info[next] >= 2 * rehash_old.info_inc; next = (next + 1) & rehash_old.mask) {
+				if (next < rehash_old.pos) {
+					rehash_finish();
+					return false;
+				}
+			}
+
+			int next = (idx + 1) & rehash_old.mask;
+			while (info[next] >= 2 * rehash_old.info_inc) {
+				info[idx] = static_cast<uint8_t>(info[next] - rehash_old.info_inc);
+				std::memmove(&rehash_old.keyvals[idx], &rehash_old.keyvals[next], sizeof(Node));
+				idx  = next;
+				next = (idx + 1) & rehash_old.mask;
+			}
+			info[idx] = 0;
+
+			--rehash_old.pending;
+			return true;
+		}
+
 	// inserts a keyval that is guaranteed to be new, e.g. when the hashmap is resized.
 	// @return index where the element was created
 	size_t insert_move(Node&& keyval) {
@@ -1093,6 +1223,9 @@ private:
   static inline uint64_t static_mMaxNumElementsAllowed = 0;
   static inline InfoType static_InitialInfoInc         = InitialInfoInc;
   static inline InfoType static_InitialInfoHashShift   = InitialInfoHashShift;
+  static inline uint16_t static_mDense                 = 0;
+  static inline uint16_t static_mVersion               = FormatVersion;
+  static inline uint32_t static_mMaxId                 = 0;
 
   void setup_pointers() {
 
@@ -1103,6 +1236,9 @@ private:
 		mMaxNumElementsAllowed = &static_mMaxNumElementsAllowed;
 		mInfoInc               = &static_InitialInfoInc;
 		mInfoHashShift         = &static_InitialInfoHashShift;
+		mDense                 = &static_mDense;
+		mVersion               = &static_mVersion;
+		mMaxId                 = &static_mMaxId;
 
     for(auto &ent:last_sview_insert) {
       ent.first = 0; // clear to invalid possition
@@ -1114,8 +1250,9 @@ public:
 
 	explicit map(std::string_view _path, std::string_view _map_name)
 		: Hash{Hash{}}
-	  , mmap_path(_path.empty()?".":_path)
-	  , mmap_name{_map_name.empty()?"":(std::string(_path) + std::string("/") + std::string(_map_name))} {
+	  , policy(mmap_policy::get_default())
+	  , mmap_name{(_map_name.empty() || policy.anonymous)?"":(std::string(_path) + std::string("/") + std::string(_map_name))}
+	  , mmap_path(_path.empty()?".":_path) {
 
     if (mmap_path != ".") {
 			struct stat sb;
@@ -1129,7 +1266,8 @@ public:
 	}
 
 	explicit map()
-		: Hash{Hash{}} {
+		: Hash{Hash{}}
+	  , policy(mmap_policy::get_default()) {
 
     setup_pointers();
 	}
@@ -1141,6 +1279,17 @@ public:
 	void swap(map& o) = delete;
 
 	void clear() {
+		mmap_gc::touch(mmap_access);
+		if constexpr (using_sview) {
+			mmap_gc::touch(mmap_txt_access);
+		}
+		if (rehash_old.base != nullptr) {
+      auto *base = rehash_old.base;
+      rehash_old = Rehash_state();
+      mmap_gc::recycle(base);
+      if (!mmap_name.empty())
+        mmap_gc::clear_flush_hook(this);
+		}
 		if (mmap_base != nullptr) {
       mmap_gc::recycle(mmap_base);
 		}
@@ -1212,7 +1361,7 @@ public:
 
 	// Returns 1 if key is found, 0 otherwise.
 	[[nodiscard]] bool has(const key_type& key) const {
-		return findIdx(key)>=0;
+		return findNode(key) != nullptr;
 	}
 
   // FIXME: enable_if T or Key is array_serializable
@@ -1236,17 +1385,17 @@ public:
 
   template<typename T_ = T, typename = std::enable_if_t<is_array_serializable<T_>::value>>
   [[nodiscard]] T get(key_type const& key) const {
-    const auto idx = findIdx(key);
-    assert(idx>=0);
+    const auto *node = findNode(key);
+    assert(node);
 
-    return get_sview(mKeyVals[idx].getSecond());
+    return get_sview(node->getSecond());
   }
   template<typename T_ = T, typename = std::enable_if_t<!is_array_serializable<T_>::value>>
   [[nodiscard]] const T &get(key_type const& key) const {
-    const auto idx = findIdx(key);
-    assert(idx>=0);
+    const auto *node = findNode(key);
+    assert(node);
 
-    return mKeyVals[idx].getSecond();
+    return node->getSecond();
   }
 
   template<typename T_ = T, typename = std::enable_if_t<is_array_serializable<T_>::value>>
@@ -1285,10 +1434,10 @@ public:
 	[[nodiscard]] T *ref(key_type const &key) {
     static_assert(!using_val_sview,"mmap_lib::map::ref can not be called for array_serializable. Use get_sview instead.\n");
 
-		auto idx = findIdx(key);
-		assert(idx>=0);
+		auto *node = findNode(key);
+		assert(node);
 
-    return &mKeyVals[idx].getSecond();
+    return &node->getSecond();
 	}
 
 	[[nodiscard]] T *ref(const value_type& it) {
@@ -1303,7 +1452,7 @@ public:
 	}
 
 	[[nodiscard]] const_iterator find(const key_type& key) const {
-		const auto idx = findIdx(key);
+		const auto idx = findIdx_sync(key);
     if (idx<0)
       return end();
 		return const_iterator{this, mKeyVals + idx, mInfo + idx};
@@ -1311,14 +1460,14 @@ public:
 
 	template <typename OtherKey>
 		[[nodiscard]] const_iterator find(const OtherKey& key, is_transparent_tag /*unused*/) const {
-			const auto idx = findIdx(key);
+			const auto idx = findIdx_sync(key);
       if (idx<0)
         return cend();
 			return const_iterator{this, mKeyVals + idx, mInfo + idx};
 		}
 
 	[[nodiscard]] iterator find(const key_type& key) {
-		const auto idx = findIdx(key);
+		const auto idx = findIdx_sync(key);
     if (idx<0)
       return end();
 		return iterator{this, mKeyVals + idx, mInfo + idx};
@@ -1326,7 +1475,7 @@ public:
 
 	template <typename OtherKey>
 		[[nodiscard]] iterator find(const OtherKey& key, is_transparent_tag /*unused*/) {
-			const auto idx = findIdx(key);
+			const auto idx = findIdx_sync(key);
       if (idx<0)
         return end();
 			return iterator{this, mKeyVals + idx, mInfo + idx};
@@ -1334,6 +1483,8 @@ public:
 
 	[[nodiscard]] iterator begin() {
     reload();
+    if (MMAP_LIB_UNLIKELY(rehash_old.base != nullptr))
+      rehash_finish();
 
 		if (empty()) {
 			return end();
@@ -1345,6 +1496,8 @@ public:
 	}
 	[[nodiscard]] const_iterator cbegin() const {
     reload();
+    if (MMAP_LIB_UNLIKELY(rehash_old.base != nullptr))
+      const_cast<Self *>(this)->rehash_finish();
 
 		if (empty()) {
 			return cend();
@@ -1389,6 +1542,12 @@ public:
 	}
 
 	size_t erase(const key_type& key) {
+		if (MMAP_LIB_UNLIKELY(rehash_old.base != nullptr)) {
+			rehash_step();
+			if (rehash_erase(key))
+				return 1;
+		}
+
 		int idx;
 		InfoType info;
 		keyToIdx(key, idx, info);
@@ -1398,6 +1557,7 @@ public:
 			if (info == mInfo[idx] && equals(key, mKeyVals[idx].getFirst())) {
 				shiftDown(idx);
 				--(*mNumElements);
+				try_shrink();
 				return 1;
 			}
       idx  = next_idx(idx);
@@ -1408,7 +1568,38 @@ public:
 		return 0;
 	}
 
+	// Tables with at least min_buckets are rehashed incrementally: the old table stays alive and each insert/erase
+	// migrates a few buckets, lookups check both tables. Avoids multi-second stalls when a big table doubles. 0
+	// disables it (the whole table is rehashed at once).
+	void set_incremental_rehash(size_t min_buckets) {
+		rehash_min_buckets = min_buckets;
+	}
+
+	// Shrink the table (and file) after mass erases. Only erase(key) shrinks, erase(iterator) keeps the table so that
+	// the iteration is not invalidated.
+	void set_shrink(bool enable) {
+		shrink_enabled = enable;
+	}
+
+	// Keys with dense_key (integers, node/pin ids) switch to a direct-indexed table at the next resize when
+	// max_id fits in ratio times the buckets that the load factor needs (the table grows to fit max_id). Trades up to
+	// ratio times the memory for no hashing and no conflicts. Back to hashing at the next resize if max_id grows too
+	// much. 0 disables it.
+	void set_dense(float ratio) {
+		dense_ratio = ratio;
+	}
+
+	[[nodiscard]] bool is_dense() const {
+		reload();
+		return *mDense;
+	}
+
+	[[nodiscard]] bool is_rehashing() const {
+		return rehash_old.base != nullptr;
+	}
+
 	void reserve(size_t count) {
+		reload(); // a reopened map may be bigger than InitialNumElements (rehash can shrink)
 		auto newSize = InitialNumElements > *mMask + 1 ? InitialNumElements : *mMask + 1;
 		while (calcMaxNumElementsAllowed(newSize) < count && newSize != 0) {
 			newSize *= 2;
@@ -1419,17 +1610,28 @@ public:
 	}
 
 	[[nodiscard]] size_type size() const {
-		return *mNumElements;
+		reload(); // a reopened map may not have read the counters yet
+		return *mNumElements + rehash_old.pending;
 	}
 
 	[[nodiscard]] bool empty() const {
-		return 0 == *mNumElements;
+		return 0 == size();
 	}
 
+	// Call before the first access. Anonymous drops the file backup (the contents of the file are not loaded)
+	void set_policy(const mmap_policy &p) {
+		assert(mmap_base == nullptr && mmap_fd < 0);
+		policy = p;
+		if (policy.anonymous)
+			mmap_name.clear();
+	}
+	[[nodiscard]] const mmap_policy &get_policy() const { return policy; }
+
   [[nodiscard]] inline std::string_view get_name() const { return mmap_name; }
   [[nodiscard]] inline std::string_view get_path() const { return mmap_path; }
 
 	[[nodiscard]] size_t capacity() const {
+		mmap_gc::touch(mmap_access);
 		if (mmap_base)
 			return *mMaxNumElementsAllowed;
 		return calcMaxNumElementsAllowed(InitialNumElements);
@@ -1461,30 +1663,89 @@ public:
 #endif
 
 private:
-	void rehash(size_t numBuckets) {
+	// Largest dense_key id in the table (saturates)
+	uint32_t scan_max_id() const {
+		uint64_t max_id = 0;
+		for (size_t i = 0; i <= *mMask; ++i) {
+			if (mInfo[i])
+				max_id = std::max(max_id, dense_key<Key>::get(mKeyVals[i].getFirst()));
+		}
+		return max_id > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(max_id);
+	}
+
+	// A file from an older map (other hashing): the entries are valid but not in their buckets, insert them again
+	__attribute__((noinline,cold)) void upgrade_format() const {
+		if (*mNumElements)
+			const_cast<Self *>(this)->rehash(*mMask + 1, true);
+		else
+			*mVersion = FormatVersion;
+	}
+
+	void rehash(size_t numBuckets, bool force = false) {
 		assert(MMAP_LIB_UNLIKELY((numBuckets & (numBuckets - 1)) == 0)); // rehash only allowed for power of two
 
     reload();
+    if (rehash_old.base)
+      rehash_finish();
+
+		bool dense = false;
+		if constexpr (dense_key<Key>::value) {
+			if (dense_ratio > 0) {
+				*mMaxId = scan_max_id();  // set only grows it, the erased ids may be gone
+
+				size_t dense_buckets = InitialNumElements;
+				while (dense_buckets <= *mMaxId)
+					dense_buckets *= 2;
+				if (dense_buckets <= numBuckets * dense_ratio) {
+					dense      = true;
+					numBuckets = std::max(numBuckets, dense_buckets);
+				}
+			}
+		}
 
 		const size_t oldMaxElements = *mMask + 1;
-		if (oldMaxElements >= numBuckets)
+		if (!force && oldMaxElements == numBuckets && dense == static_cast<bool>(*mDense))
 			return; // done
 
+		assert(numBuckets >= InitialNumElements);
+		assert(calcMaxNumElementsAllowed(numBuckets) > *mNumElements);
+		peak_buckets = std::max(peak_buckets, std::max(oldMaxElements, numBuckets));
+
+    const bool incremental = !force && rehash_min_buckets && oldMaxElements >= rehash_min_buckets;
+
     if (mmap_fd >= 0) {
       mmap_gc::delete_file(mmap_base);
       mmap_fd = -1;
     }
 
     uint64_t     *old_mmap_base = mmap_base;
-		const size_t  old_mmap_size = mmap_size;
 
 		Node* const oldKeyVals        = mKeyVals;
 		uint8_t const* const oldInfo  = mInfo;
 
     assert(mmap_fd == -1);
+    if (incremental) {
+      // set before setup_mmap so that a gc triggered by the new mmap does not collect the old table
+      rehash_old.base            = old_mmap_base;
+      rehash_old.keyvals         = oldKeyVals;
+      rehash_old.info            = const_cast<uint8_t *>(oldInfo);
+      rehash_old.mask            = *mMask;
+      rehash_old.info_inc        = *mInfoInc;
+      rehash_old.info_hash_shift = *mInfoHashShift;
+      rehash_old.dense           = *mDense;
+      rehash_old.pos             = 0;
+      rehash_old.pending         = *mNumElements;
+      if (!mmap_name.empty())  // the new file is incomplete until rehash_done
+        mmap_gc::set_flush_hook(this, [this]() { rehash_finish(); });
+    }
+    const uint32_t old_max_id = *mMaxId;
+
     mmap_base = nullptr;
 		setup_mmap(numBuckets);
 
+    *mDense = dense;
+    *mMaxId = old_max_id;
+
     assert(old_mmap_base != mmap_base);
     assert(oldKeyVals != mKeyVals);
     assert(oldInfo != mInfo);
@@ -1494,6 +1755,10 @@ private:
 
 		//std::cout << "resize sz:" << numBuckets << " mmap_name:" << mmap_name << "\n";
 
+		if (incremental) {
+			return; // buckets migrated by rehash_step
+		}
+
 		for (size_t i = 0; i < oldMaxElements; ++i) {
 			if (oldInfo[i] != 0) {
 				insert_move(std::move(oldKeyVals[i]));
@@ -1506,6 +1771,37 @@ private:
     mmap_gc::recycle(old_mmap_base);
 	}
 
+	// Migrate the next RehashStepBuckets buckets of the old table
+	void rehash_step() {
+		assert(rehash_old.base);
+
+		auto end = std::min<size_t>(rehash_old.pos + RehashStepBuckets, rehash_old.mask + 1);
+		for (auto i = rehash_old.pos; i < end && rehash_old.pending; ++i) {
+			if (rehash_old.info[i] == 0)
+				continue;
+			insert_move(std::move(rehash_old.keyvals[i]));
+			--rehash_old.pending;
+		}
+		rehash_old.pos = end;
+
+		if (rehash_old.pos > rehash_old.mask || rehash_old.pending == 0)
+			rehash_done();
+	}
+
+	void rehash_finish() {
+		while (rehash_old.base)
+			rehash_step();
+	}
+
+	void rehash_done() {
+		assert(rehash_old.pending == 0);
+		auto *base = rehash_old.base;
+		rehash_old = Rehash_state();
+		mmap_gc::recycle(base);  // gc_done returns false (not mmap_base)
+		if (!mmap_name.empty())
+			mmap_gc::clear_flush_hook(this);
+	}
+
 	size_t mask() const {
 		return *mMask;
 	}
@@ -1577,6 +1873,11 @@ private:
 
 	template <typename Arg, typename Data>
 		iterator doCreate(Arg&& key, Data&& val) {
+			if (MMAP_LIB_UNLIKELY(rehash_old.base != nullptr)) {
+				rehash_step();
+				rehash_erase(key); // if still in the old table, move it to the new one
+			}
+
 			while (true) {
 				int idx;
 				InfoType info;
@@ -1599,7 +1900,7 @@ private:
 				auto const insertion_info = info;
         if (!found) {
           // unlikely that this evaluates to true
-          if (MMAP_LIB_UNLIKELY(*mNumElements >= *mMaxNumElementsAllowed)) {
+          if (MMAP_LIB_UNLIKELY(size() >= *mMaxNumElementsAllowed)) {
             increase_size();
             continue;
           }
@@ -1614,6 +1915,12 @@ private:
             idx  = next_idx(idx);
             info = next_info(info);
           }
+
+          if constexpr (dense_key<Key>::value) {
+            auto id = dense_key<Key>::get(key);
+            if (id > *mMaxId)
+              *mMaxId = id > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(id);
+          }
         }
 
 				auto& l = mKeyVals[insertion_idx];
@@ -1707,6 +2014,12 @@ private:
 			return;
 		}
 
+		if (rehash_old.base) {
+			rehash_finish();
+			if (*mNumElements < *mMaxNumElementsAllowed)
+				return;
+		}
+
 		auto const maxNumElementsAllowed = calcMaxNumElementsAllowed(*mMask + 1);
 		if (*mNumElements < maxNumElementsAllowed && try_increase_info()) {
 			return;
@@ -1719,10 +2032,37 @@ private:
 		// it seems we have a really bad hash function! don't try to resize again
 		assert(*mNumElements * 2 >= calcMaxNumElementsAllowed(*mMask + 1));
 
-		rehash((*mMask + 1) * 2);
+		// Quad expansion if the table was that big before (it shrank after erases), double otherwise
+		auto numBuckets = (*mMask + 1) * 2;
+		if (peak_buckets >= numBuckets * 2)
+			numBuckets *= 2;
+
+		rehash(numBuckets);
+	}
+
+	// Quad shrink. The 1/16 threshold leaves the new table at 1/4 load, far from the next expansion
+	void try_shrink() {
+		if (!shrink_enabled || iter_cntr || rehash_old.base)
+			return;
+
+		const size_t buckets = *mMask + 1;
+		if (buckets <= InitialNumElements || *mNumElements * ShrinkOccupancy >= buckets)
+			return;
+
+		rehash(std::max(InitialNumElements, buckets / 4));
 	}
 
 	void destroy() {
+    if (rehash_old.base) {
+      if (mmap_name.empty()) {
+        auto *base = rehash_old.base;
+        rehash_old = Rehash_state();
+        mmap_gc::recycle(base);
+      } else {
+        rehash_finish();  // the file must have all the entries
+      }
+    }
+
     if (mmap_base) {
       mmap_gc::recycle(mmap_base);
       assert(mmap_base == nullptr);
@@ -1738,9 +2078,28 @@ private:
     }
   }
 
+	// Old table while an incremental rehash is in progress (base==nullptr otherwise)
+	struct Rehash_state {
+		uint64_t *base            = nullptr;
+		Node     *keyvals         = nullptr;
+		uint8_t  *info            = nullptr;
+		uint64_t  mask            = 0;
+		InfoType  info_inc        = 0;
+		InfoType  info_hash_shift = 0;
+		bool      dense           = false;
+		size_t    pos             = 0; // buckets below pos are already migrated
+		size_t    pending         = 0; // entries at or after pos
+	};
+
 	// members are sorted so no padding occurs
   std::array<std::pair<uint32_t,uint32_t>,8> last_sview_insert;
 
+	mutable Rehash_state rehash_old;
+	size_t               rehash_min_buckets = RehashMinBuckets;
+	size_t               peak_buckets       = 0;  // largest table so far, to pick double or quad expansion
+	bool                 shrink_enabled     = true;
+	float                dense_ratio        = DenseRatio;
+
 	mutable Node      *mKeyVals = nullptr;
 	mutable uint8_t   *mInfo = nullptr;
 	mutable uint64_t  *mNumElements;
@@ -1748,15 +2107,21 @@ private:
 	mutable uint64_t  *mMaxNumElementsAllowed;
 	mutable InfoType  *mInfoInc;
 	mutable InfoType  *mInfoHashShift;
-	const std::string  mmap_name;
+	mutable uint16_t  *mDense;  // direct-indexed (dense_key) table
+	mutable uint16_t  *mVersion;
+	mutable uint32_t  *mMaxId;  // largest dense_key id inserted (saturates)
+	mmap_policy        policy;
+	std::string        mmap_name;  // empty for anonymous
 	const std::string  mmap_path;
 	mutable int        mmap_fd       = -1;
 	mutable size_t     mmap_size     = 0;
 	mutable uint64_t  *mmap_base     = 0;
+	mutable mmap_gc_access mmap_access;  // mmap_gc::touch
   mutable int        iter_cntr     = 0;
 	mutable int        mmap_txt_fd   = -1;
 	mutable size_t     mmap_txt_size = 0;
 	mutable uint64_t  *mmap_txt_base = 0;
+	mutable mmap_gc_access mmap_txt_access;
 #ifndef NDEBUG
 	size_t conflicts = 0;
 #endif
@@ -0,0 +1,455 @@
+//  This file is distributed under the BSD 3-Clause License. See LICENSE for details.
+
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include "mmap_gc.hpp"
+#include "mmap_map.hpp"
+
+namespace mmap_lib {
+
+// Persistent hash set. Only a valid bitmap and the keys are stored (no robin-hood info byte, no data).
+//
+// mmap layout (uint64_t words):
+//   [0] mask (buckets-1), [1] number of elements, [2] max elements allowed (load factor)
+//   [3...] valid bitmap, 1 bit per bucket
+//   keys (one per bucket, only meaningful when the valid bit is set)
+//
+// Linear probing with backward shift erase (no tombstones). The iterator walks the valid bitmap, so 64 empty
+// buckets are skipped with a single word check.
+//
+// NOTE: erase while iterating may visit a key twice if the erase pulls back a key that wrapped around from
+// the first buckets. Collect the keys first if that matters.
+template <typename Key, typename Hash = hash<Key>, size_t MaxLoadFactor100 = 75>
+class set : private Hash {
+  static_assert(!is_array_serializable<Key>::value, "mmap_lib::set only supports fixed size keys\n");
+  static_assert(!std::is_same<Key, std::string>::value, "mmap_lib::set does not support std::string keys\n");
+  static_assert(std::is_trivially_copyable<Key>::value, "mmap_lib::set keys are stored in the mmap (trivially copyable)\n");
+  static_assert(MaxLoadFactor100 > 10 && MaxLoadFactor100 < 100, "MaxLoadFactor100 needs to be >10 && < 100");
+
+  static constexpr size_t InitialNumElements = 1024;  // multiple of 64 (bitmap words)
+  static constexpr size_t ShrinkOccupancy    = 16;    // shrink to 1/4 buckets when less than 1/16 are used
+  static constexpr size_t HeaderWords        = 3;
+
+public:
+  using key_type   = Key;
+  using value_type = Key;
+  using size_type  = size_t;
+  using hasher     = Hash;
+  using Self       = set<Key, Hash, MaxLoadFactor100>;
+
+  class const_iterator {
+  public:
+    using difference_type   = std::ptrdiff_t;
+    using value_type        = Key;
+    using reference         = const Key &;
+    using pointer           = const Key *;
+    using iterator_category = std::forward_iterator_tag;
+
+    const_iterator(const Self *_set, size_t _idx) : set_ptr(_set), idx(_idx) { set_ptr->iter_new(); }
+    const_iterator(const const_iterator &o) : set_ptr(o.set_ptr), idx(o.idx) { set_ptr->iter_new(); }
+    ~const_iterator() { set_ptr->iter_free(); }
+
+    const_iterator &operator=(const const_iterator &o) {
+      o.set_ptr->iter_new();
+      set_ptr->iter_free();
+      set_ptr = o.set_ptr;
+      idx     = o.idx;
+      return *this;
+    }
+
+    const_iterator &operator++() {
+      idx = set_ptr->next_valid(idx + 1);
+      return *this;
+    }
+
+    const_iterator operator++(int) {
+      const_iterator tmp(*this);
+      ++(*this);
+      return tmp;
+    }
+
+    reference operator*() const { return set_ptr->mKeys[idx]; }
+    pointer   operator->() const { return &set_ptr->mKeys[idx]; }
+
+    bool operator==(const const_iterator &o) const { return idx == o.idx; }
+    bool operator!=(const const_iterator &o) const { return idx != o.idx; }
+
+  private:
+    friend class set;
+    const Self *set_ptr;
+    size_t      idx;
+  };
+  using iterator = const_iterator;  // keys can not be modified in place
+
+  explicit set(std::string_view _path, std::string_view _set_name)
+      : Hash{Hash{}}
+      , policy(mmap_policy::get_default())
+      , mmap_path(_path.empty() ? "." : _path)
+      , mmap_name{(_set_name.empty() || policy.anonymous) ? "" : (std::string(_path) + std::string("/") + std::string(_set_name))} {
+    if (mmap_path != ".") {
+      struct stat sb;
+      if (stat(mmap_path.c_str(), &sb) != 0 || !S_ISDIR(sb.st_mode)) {
+        int e = mkdir(mmap_path.c_str(), 0755);
+        assert(e >= 0);
+      }
+    }
+  }
+
+  explicit set() : Hash{Hash{}}, policy(mmap_policy::get_default()) {}
+
+  set(set &&o)        = delete;
+  set &operator=(set &&o) = delete;
+  set(const set &o)   = delete;
+  set &operator=(set const &o) = delete;
+
+  virtual ~set() {
+    if (mmap_base) {
+      mmap_gc::recycle(mmap_base);
+      assert(mmap_base == nullptr);
+    }
+  }
+
+  void clear() {
+    mmap_gc::touch(mmap_access);
+    if (mmap_base != nullptr) {
+      mmap_gc::recycle(mmap_base);
+    }
+    if (!mmap_name.empty()) {
+      unlink(mmap_name.c_str());
+    }
+    mmap_base = nullptr;
+    mmap_size = 0;
+  }
+
+  // true if the key was inserted (false if it was already there)
+  bool insert(const Key &key) {
+    reload();
+
+    size_t idx = find_idx(key);
+    if (is_valid(idx)) return false;
+
+    if (MMAP_LIB_UNLIKELY(*mNumElements >= *mMaxNumElementsAllowed)) {
+      rehash((*mMask + 1) * 2);
+      idx = find_idx(key);
+    }
+
+    mKeys[idx] = key;
+    set_valid(idx);
+    ++(*mNumElements);
+    return true;
+  }
+
+  [[nodiscard]] bool has(const Key &key) const {
+    mmap_gc::touch(mmap_access);
+    if (MMAP_LIB_UNLIKELY(mmap_base == nullptr)) {
+      if (mmap_name.empty()) return false;
+      reload();
+    }
+    return is_valid(find_idx(key));
+  }
+
+  [[nodiscard]] const_iterator find(const Key &key) const {
+    reload();
+    auto idx = find_idx(key);
+    if (!is_valid(idx)) return end();
+    return const_iterator(this, idx);
+  }
+
+  size_t erase(const Key &key) {
+    reload();
+    auto idx = find_idx(key);
+    if (!is_valid(idx)) return 0;
+
+    erase_idx(idx);
+    try_shrink();
+    return 1;
+  }
+
+  // Returns the iterator to the next key. No shrink, so the iteration can continue
+  const_iterator erase(const const_iterator &it) {
+    assert(it.set_ptr == this);
+    assert(is_valid(it.idx));
+
+    erase_idx(it.idx);
+    if (is_valid(it.idx)) return const_iterator(this, it.idx);  // a later key was shifted back to this bucket
+
+    return const_iterator(this, next_valid(it.idx + 1));
+  }
+
+  [[nodiscard]] Key get(const const_iterator &it) const {
+    assert(is_valid(it.idx));
+    return mKeys[it.idx];
+  }
+
+  void reserve(size_t n) {
+    reload();
+    size_t buckets = *mMask + 1;
+    while (calcMaxNumElementsAllowed(buckets) <= n) buckets *= 2;
+    if (buckets != *mMask + 1) rehash(buckets);
+  }
+
+  [[nodiscard]] const_iterator begin() const {
+    reload();
+    return const_iterator(this, next_valid(0));
+  }
+  [[nodiscard]] const_iterator cbegin() const { return begin(); }
+
+  [[nodiscard]] const_iterator end() const {
+    reload();
+    return const_iterator(this, *mMask + 1);
+  }
+  [[nodiscard]] const_iterator cend() const { return end(); }
+
+  [[nodiscard]] size_t size() const {
+    mmap_gc::touch(mmap_access);
+    if (MMAP_LIB_UNLIKELY(mmap_base == nullptr)) {
+      if (mmap_name.empty()) return 0;
+      reload();
+    }
+    return *mNumElements;
+  }
+
+  [[nodiscard]] bool empty() const { return size() == 0; }
+
+  [[nodiscard]] size_t capacity() const {
+    mmap_gc::touch(mmap_access);
+    if (mmap_base) return *mMaxNumElementsAllowed;
+    return calcMaxNumElementsAllowed(InitialNumElements);
+  }
+
+  void set_shrink(bool enable) { shrink_enabled = enable; }
+
+  // Call before the first access. Anonymous drops the file backup (the contents of the file are not loaded)
+  void set_policy(const mmap_policy &p) {
+    assert(mmap_base == nullptr && mmap_fd < 0);
+    policy = p;
+    if (policy.anonymous) mmap_name.clear();
+  }
+  [[nodiscard]] const mmap_policy &get_policy() const { return policy; }
+
+  [[nodiscard]] inline std::string_view get_name() const { return mmap_name; }
+  [[nodiscard]] inline std::string_view get_path() const { return mmap_path; }
+
+private:
+  void iter_new() const { ++iter_cntr; }
+  void iter_free() const {
+    assert(iter_cntr > 0);
+    --iter_cntr;
+  }
+
+  static size_t calc_mmap_size(size_t buckets) {
+    return (HeaderWords + buckets / 64) * sizeof(uint64_t) + buckets * sizeof(Key);
+  }
+
+  size_t calcMaxNumElementsAllowed(size_t buckets) const { return (buckets * MaxLoadFactor100) / 100; }
+
+  bool gc_done(void *base, bool force_recycle) const {
+    if (iter_cntr && !force_recycle) return true;
+
+    if (base != mmap_base) return false;  // old table recycled at the end of rehash
+
+    if (mmap_fd >= 0 && *mNumElements == 0) {
+      unlink(mmap_name.c_str());
+    }
+
+    mmap_base = nullptr;
+    // NOTE: preserve mmap_size to avoid read file in reload
+    mmap_fd = -1;
+
+    return false;
+  }
+
+  __attribute__((noinline, cold)) void setup_mmap(size_t n_buckets) const {
+    assert(mmap_base == nullptr);
+
+    auto new_mmap_size = mmap_size;
+
+    if (mmap_name.empty()) {
+      assert(mmap_fd == -1);
+      if (n_buckets == 0) n_buckets = InitialNumElements;
+      new_mmap_size = calc_mmap_size(n_buckets);
+    } else {
+      if (mmap_fd < 0) {
+        mmap_fd = mmap_gc::open(mmap_name);
+        assert(mmap_fd >= 0);
+      }
+
+      if (n_buckets) {  // force a size
+        new_mmap_size = calc_mmap_size(n_buckets);
+      } else if (mmap_size == 0) {  // first reload
+        int sz = pread(mmap_fd, &n_buckets, 8, 0);
+        if (sz != 8) {
+          n_buckets = InitialNumElements;
+        } else {
+          n_buckets++;  // We read mMask at base 0
+          assert(n_buckets >= InitialNumElements);
+        }
+        new_mmap_size = calc_mmap_size(n_buckets);
+      } else {
+        assert(new_mmap_size);  // preserve last size
+      }
+    }
+
+    auto  gc_func             = std::bind(&Self::gc_done, this, std::placeholders::_1, std::placeholders::_2);
+    void *base                = nullptr;
+    std::tie(base, mmap_size) = mmap_gc::mmap(mmap_name, mmap_fd, new_mmap_size, gc_func, policy, &mmap_access);
+    mmap_base                 = reinterpret_cast<uint64_t *>(base);
+
+    mMask                  = &mmap_base[0];
+    mNumElements           = &mmap_base[1];
+    mMaxNumElementsAllowed = &mmap_base[2];
+    mValid                 = &mmap_base[HeaderWords];
+
+    if (*mMask == 0) {  // new file (or anonymous mmap), zero filled
+      assert(n_buckets);
+      *mMask                  = n_buckets - 1;
+      *mMaxNumElementsAllowed = calcMaxNumElementsAllowed(n_buckets);
+    } else {
+      assert(n_buckets == 0 || *mMask == n_buckets - 1);
+      assert(calc_mmap_size(*mMask + 1) <= mmap_size);
+    }
+
+    mKeys = reinterpret_cast<Key *>(&mValid[(*mMask + 1) / 64]);
+    hash_shift = 64 - __builtin_ctzll(*mMask + 1);
+  }
+
+  __attribute__((inline)) void reload() const {
+    mmap_gc::touch(mmap_access);  // before the check, claims the set for this thread
+    if (MMAP_LIB_UNLIKELY(mmap_base == nullptr)) {
+      assert(mmap_fd < 0);
+      setup_mmap(0);
+      assert(mmap_base);
+    }
+  }
+
+  // Fibonacci hashing: the upper bits of the product are well mixed even with a weak (identity) Hash
+  inline size_t home_idx(const Key &key) const {
+    return static_cast<size_t>((Hash::operator()(key) * UINT64_C(0x9E3779B97F4A7C15)) >> hash_shift);
+  }
+
+  inline size_t next_idx(size_t idx) const { return (idx + 1) & *mMask; }
+
+  inline bool is_valid(size_t idx) const { return (mValid[idx >> 6] >> (idx & 63)) & 1; }
+  inline void set_valid(size_t idx) { mValid[idx >> 6] |= UINT64_C(1) << (idx & 63); }
+  inline void clear_valid(size_t idx) { mValid[idx >> 6] &= ~(UINT64_C(1) << (idx & 63)); }
+
+  // bucket with the key, or the empty bucket where it should be inserted
+  size_t find_idx(const Key &key) const {
+    size_t idx = home_idx(key);
+    while (is_valid(idx)) {
+      if (mKeys[idx] == key) return idx;
+      idx = next_idx(idx);
+    }
+    return idx;
+  }
+
+  // first valid bucket at or after idx (mask+1 if none)
+  size_t next_valid(size_t idx) const {
+    const size_t n_buckets = *mMask + 1;
+    if (idx >= n_buckets) return n_buckets;
+
+    size_t   w    = idx >> 6;
+    uint64_t bits = mValid[w] & (~UINT64_C(0) << (idx & 63));
+    while (bits == 0) {
+      if (++w >= n_buckets / 64) return n_buckets;
+      bits = mValid[w];
+    }
+    return (w << 6) + __builtin_ctzll(bits);
+  }
+
+  // Backward shift: move back any key in the run that can reach the hole (keeps lookups tombstone free)
+  void erase_idx(size_t hole) {
+    size_t idx = next_idx(hole);
+    while (is_valid(idx)) {
+      const size_t home = home_idx(mKeys[idx]);
+      // distance to home is larger than the distance to the hole (modulo buckets)
+      if (((idx - home) & *mMask) >= ((idx - hole) & *mMask)) {
+        mKeys[hole] = mKeys[idx];
+        hole        = idx;
+      }
+      idx = next_idx(idx);
+    }
+    clear_valid(hole);
+    --(*mNumElements);
+  }
+
+  void try_shrink() {
+    if (!shrink_enabled || iter_cntr) return;
+
+    const size_t buckets = *mMask + 1;
+    if (buckets <= InitialNumElements || *mNumElements * ShrinkOccupancy >= buckets) return;
+
+    rehash(std::max(InitialNumElements, buckets / 4));
+  }
+
+  void rehash(size_t n_buckets) {
+    assert((n_buckets & (n_buckets - 1)) == 0);
+    assert(n_buckets >= InitialNumElements);
+    assert(calcMaxNumElementsAllowed(n_buckets) > *mNumElements);
+
+    if (mmap_fd >= 0) {
+      mmap_gc::delete_file(mmap_base);  // the mapping stays valid until recycle
+      mmap_fd = -1;
+    }
+
+    uint64_t *const old_valid   = mValid;
+    Key *const      old_keys    = mKeys;
+    const size_t    old_buckets = *mMask + 1;
+
+    uint64_t *const old_base = mmap_base;  // no fd now, so the gc does not collect it
+    mmap_base                = nullptr;
+    setup_mmap(n_buckets);
+    assert(*mNumElements == 0);
+
+    for (size_t w = 0; w < old_buckets / 64; ++w) {
+      auto bits = old_valid[w];
+      while (bits) {
+        const auto &key = old_keys[(w << 6) + __builtin_ctzll(bits)];
+        bits &= bits - 1;
+
+        auto idx = find_idx(key);
+        assert(!is_valid(idx));
+        mKeys[idx] = key;
+        set_valid(idx);
+        ++(*mNumElements);
+      }
+    }
+
+    mmap_gc::recycle(old_base);
+  }
+
+  static inline uint64_t static_zero = 0;
+
+  mmap_policy       policy;
+  const std::string mmap_path;
+  std::string       mmap_name;  // empty for anonymous
+
+  mutable uint64_t *mMask                  = &static_zero;
+  mutable uint64_t *mNumElements           = &static_zero;
+  mutable uint64_t *mMaxNumElementsAllowed = &static_zero;
+  mutable uint64_t *mValid                 = nullptr;
+  mutable Key *     mKeys                  = nullptr;
+  mutable int       hash_shift             = 64;
+
+  mutable int       mmap_fd     = -1;
+  mutable size_t    mmap_size   = 0;
+  mutable uint64_t *mmap_base   = nullptr;
+  mutable mmap_gc_access mmap_access;  // mmap_gc::touch
+  mutable int       iter_cntr   = 0;
+  bool              shrink_enabled = true;
+};
+
+}  // namespace mmap_lib
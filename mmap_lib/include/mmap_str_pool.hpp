@@ -0,0 +1,150 @@
+//  This file is distributed under the BSD 3-Clause License. See LICENSE for details.
+
+#pragma once
+
+#include <cassert>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+#include "mmap_map.hpp"
+#include "mmap_vector.hpp"
+
+namespace mmap_lib {
+
+// Persistent string interning pool. Each distinct string is stored once and identified by a 32-bit handle, so
+// maps/bimaps can store the handle instead of a private copy of the text (see str_bimap).
+//
+// Storage:
+//   txt: vector<uint64_t>, handle is the word index. Word 0 has the number of strings (handle 0 is invalid).
+//        txt[h] = len | next_same_hash<<32, the text starts at txt[h+1] (padded to 8 bytes)
+//   idx: map<hash, handle> with the last string inserted for each 64-bit hash. Collisions are chained with
+//        next_same_hash.
+//
+// Strings are never removed (only clear). get returns a string_view to the mmap, it is invalidated by the next
+// insert that grows the pool (same as the map txt).
+class str_pool {
+  mmap_lib::vector<uint64_t>        txt;
+  mmap_lib::map<uint64_t, uint32_t> idx;
+
+  static inline std::mutex                                     shared_pools_mutex;
+  static inline std::map<std::string, std::weak_ptr<str_pool>> shared_pools;
+
+  static uint64_t hash_txt(std::string_view str) { return hash_bytes(str.data(), str.size()); }
+
+  // head is the chain start for h (0 if none)
+  uint32_t find_int(std::string_view str, uint64_t h, uint32_t &head) const {
+    const auto it = idx.find(h);
+    if (it == idx.end()) {
+      head = 0;
+      return 0;
+    }
+
+    head            = idx.get(it);
+    uint32_t handle = head;
+    while (handle) {
+      if (get(handle) == str) return handle;
+      handle = static_cast<uint32_t>(txt[handle] >> 32);
+    }
+    return 0;
+  }
+
+public:
+  explicit str_pool(std::string_view _path, std::string_view _name)
+      : txt(_path, std::string(_name) + "_txt"), idx(_path, std::string(_name) + "_idx") {}
+  explicit str_pool() {}
+
+  // Pool shared by all the users of the same path/name. It is released with the last user (files stay)
+  static std::shared_ptr<str_pool> shared(std::string_view path, std::string_view name) {
+    std::lock_guard<std::mutex> guard(shared_pools_mutex);
+
+    auto &entry = shared_pools[std::string(path) + "/" + std::string(name)];
+    auto  pool  = entry.lock();
+    if (!pool) {
+      pool  = std::make_shared<str_pool>(path, name);
+      entry = pool;
+    }
+    return pool;
+  }
+
+  // Remove the contents (and files). No handle from this pool can be live anywhere
+  static void clear_shared(std::string_view path, std::string_view name) {
+    std::shared_ptr<str_pool> pool;
+    {
+      std::lock_guard<std::mutex> guard(shared_pools_mutex);
+      auto it = shared_pools.find(std::string(path) + "/" + std::string(name));
+      if (it != shared_pools.end()) {
+        pool = it->second.lock();
+        shared_pools.erase(it);
+      }
+    }
+    if (pool) {
+      pool->clear();
+    } else {
+      str_pool tmp(path, name);  // not open, remove the files
+      tmp.clear();
+    }
+  }
+
+  // Handle for str, the text is only added if it was not already in the pool
+  uint32_t insert(std::string_view str) {
+    const auto h = hash_txt(str);
+    uint32_t   next;
+    auto       handle = find_int(str, h, next);
+    if (handle) return handle;
+
+    assert(str.size() < UINT32_MAX);
+
+    if (txt.empty()) txt.emplace_back(0);  // number of strings, handle 0 is invalid
+
+    handle = txt.size();
+    assert(handle == txt.size());  // more than 32GB of text (handle does not fit)
+    txt.emplace_back(str.size() | (static_cast<uint64_t>(next) << 32));
+
+    const auto n_words = (str.size() + 7) / 8;
+    txt.reserve(txt.size() + n_words);
+    for (size_t i = 0; i < n_words; ++i) txt.emplace_back(0);
+    if (n_words) std::memcpy(txt.ref(handle + 1), str.data(), str.size());
+
+    idx.set(h, handle);
+    txt.set(0, txt[0] + 1);
+
+    return handle;
+  }
+
+  // 0 if not in the pool
+  [[nodiscard]] uint32_t find(std::string_view str) const {
+    uint32_t head;
+    return find_int(str, hash_txt(str), head);
+  }
+
+  [[nodiscard]] bool has(std::string_view str) const { return find(str) != 0; }
+
+  [[nodiscard]] std::string_view get(uint32_t handle) const {
+    assert(handle && handle < txt.size());
+    const uint64_t *ptr = txt.ref(handle);
+    return std::string_view(reinterpret_cast<const char *>(ptr + 1), static_cast<uint32_t>(*ptr));
+  }
+
+  void clear() {
+    txt.clear();
+    idx.clear();
+  }
+
+  void set_policy(const mmap_policy &p) {
+    txt.set_policy(p);
+    idx.set_policy(p);
+  }
+
+  // number of different strings
+  [[nodiscard]] size_t size() const { return txt.empty() ? 0 : txt[0]; }
+  [[nodiscard]] bool   empty() const { return size() == 0; }
+
+  // bytes used by the text (headers and padding included)
+  [[nodiscard]] size_t txt_bytes() const { return txt.size() * sizeof(uint64_t); }
+};
+
+}  // namespace mmap_lib
@@ -6,6 +6,7 @@
 #include <sys/types.h>
 
 #include <functional>
+#include <utility>
 #include <vector>
 
 #include "iassert.hpp"
@@ -93,6 +94,23 @@ protected:
   int                                     pending_parent;  // Must be signed
   int                                     pending_child;
 
+  // Compacted preorder copy (freeze). Struct of arrays, the traversals scan them linearly. The children of pos
+  // start at pos+1, and the next sibling is at pos+size[pos]. Any change to the tree drops it.
+  struct Frozen {
+    std::vector<X>          data;
+    std::vector<Tree_index> index;
+    std::vector<uint32_t>   size;  // subtree size (self included)
+    std::vector<uint32_t>   post;  // preorder positions in postorder
+  };
+  Frozen frozen;
+  bool   frozen_valid = false;
+
+  void unfreeze() {
+    if (!frozen_valid) return;
+    frozen       = Frozen();
+    frozen_valid = false;
+  }
+
   void adjust_to_level(Tree_level level);
 
   Tree_pos create_space(const Tree_index &parent, const X &data) {
@@ -306,6 +324,52 @@ public:
     CTree_sibling_iterator end() const { return CTree_sibling_iterator(invalid_index(), t); }
   };
 
+  class Tree_frozen_iterator {
+  public:
+    class CTree_frozen_iterator {
+    public:
+      CTree_frozen_iterator(size_t _i, const uint32_t *_order, const Frozen *_f) : i(_i), order(_order), f(_f) {}
+      CTree_frozen_iterator operator++() {
+        CTree_frozen_iterator it(i, order, f);
+        ++i;
+        return it;
+      };
+      bool operator!=(const CTree_frozen_iterator &other) {
+        I(f == other.f);
+        return i != other.i;
+      }
+      std::pair<const Tree_index &, const X &> operator*() const {
+        auto pos = order ? order[i] : i;
+        return {f->index[pos], f->data[pos]};
+      }
+
+      // Preorder only: the next ++ goes past the children of the current node (its next sibling or up)
+      void skip_subtree() {
+        I(order == nullptr);
+        i += f->size[i] - 1;
+      }
+
+    private:
+      size_t          i;
+      const uint32_t *order;  // nullptr for preorder
+      const Frozen *  f;
+    };
+
+  protected:
+    size_t          b;
+    size_t          e;
+    const uint32_t *order;
+    const Frozen *  f;
+
+  public:
+    Tree_frozen_iterator() = delete;
+    explicit Tree_frozen_iterator(size_t _b, size_t _e, const uint32_t *_order, const Frozen *_f)
+        : b(_b), e(_e), order(_order), f(_f) {}
+
+    CTree_frozen_iterator begin() const { return CTree_frozen_iterator(b, order, f); }
+    CTree_frozen_iterator end() const { return CTree_frozen_iterator(e, order, f); }
+  };
+
   tree();
   tree(std::string_view _path, std::string_view _map_name);
 
@@ -318,6 +382,7 @@ public:
 
     data_stack.clear();
     pointers_stack.clear();
+    unfreeze();
   }
 
   [[nodiscard]] bool empty() const { return data_stack.empty(); }
@@ -335,6 +400,7 @@ public:
     I((int)data_stack.size() > index.level);
     I((int)data_stack[index.level].size() > index.pos);
 
+    unfreeze();
     data_stack[index.level][index.pos] = data;
   }
 
@@ -342,6 +408,8 @@ public:
     I((int)data_stack.size() > leaf.level);
     I((int)data_stack[leaf.level].size() > leaf.pos);
 
+    unfreeze();
+
     return &data_stack[leaf.level][leaf.pos];
   }
   const X &get_data(const Tree_index &leaf) const {
@@ -397,6 +465,19 @@ public:
     return Tree_sibling_iterator(get_first_child(start_index), this);
   }
 
+  // Build the compacted preorder layout. Worth it for read-only phases that traverse the whole tree many times
+  void freeze();
+  [[nodiscard]] bool is_frozen() const { return frozen_valid; }
+
+  Tree_frozen_iterator frozen_preorder() const {
+    I(frozen_valid);
+    return Tree_frozen_iterator(0, frozen.index.size(), nullptr, &frozen);
+  }
+  Tree_frozen_iterator frozen_postorder() const {
+    I(frozen_valid);
+    return Tree_frozen_iterator(0, frozen.post.size(), frozen.post.data(), &frozen);
+  }
+
   bool is_leaf(const Tree_index &index) const { return (*ref_first_child_pos(index)) == -1; }
 
   bool is_root(const Tree_index &index) const { return index.is_root(); }
@@ -474,6 +555,7 @@ const Tree_index tree<X>::add_child(const Tree_index &parent, const X &data) {
 
   auto child_level = parent_level + 1;
 
+  unfreeze();
   adjust_to_level(child_level);
 
   auto *parent_lc_pos = ref_last_child_pos(parent);
@@ -507,6 +589,8 @@ const Tree_index tree<X>::add_next_sibling(const Tree_index &sibling, const X &d
 
   I(sibling_level > 0);  // No siblings to root
 
+  unfreeze();
+
   auto  parent        = get_parent(sibling);
   auto *parent_lc_pos = ref_last_child_pos(parent);
 
@@ -570,6 +654,7 @@ const Tree_index tree<X>::get_depth_preorder_next(const Tree_index &child) const
 
 template <typename X>
 void tree<X>::set_root(const X &data) {
+  unfreeze();
   adjust_to_level(0);
 
   if (data_stack[0].empty()) {
@@ -612,6 +697,44 @@ void tree<X>::each_top_down_fast(std::function<void(const Tree_index &self, cons
   }
 }
 
+template <typename X>
+void tree<X>::freeze() {
+  unfreeze();
+  frozen_valid = true;
+  if (empty()) return;
+
+  size_t n = 0;
+  for (const auto &level : data_stack) n += level.size();  // upper bound (4-child chunks)
+  frozen.data.reserve(n);
+  frozen.index.reserve(n);
+  frozen.size.reserve(n);
+
+  // The open ancestors are closed (subtree size known) when the preorder goes back to their level, and they close
+  // deepest first: postorder
+  std::vector<uint32_t> open;
+  auto                  close_until = [this, &open](Tree_level level) {
+    while (!open.empty() && frozen.index[open.back()].level >= level) {
+      auto pos         = open.back();
+      frozen.size[pos] = frozen.index.size() - pos;
+      frozen.post.emplace_back(pos);
+      open.pop_back();
+    }
+  };
+
+  for (const auto &ti : depth_preorder()) {
+    close_until(ti.level);
+
+    open.emplace_back(frozen.index.size());
+    frozen.data.emplace_back(get_data(ti));
+    frozen.index.emplace_back(ti);
+    frozen.size.emplace_back(0);
+  }
+  close_until(0);
+
+  I(frozen.post.size() == frozen.index.size());
+  I(frozen.size[0] == frozen.index.size());
+}
+
 template <typename X>
 const Tree_index tree<X>::get_child(const Tree_index &top) const {
   auto *fc = ref_first_child_pos(top);
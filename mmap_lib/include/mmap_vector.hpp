@@ -92,7 +92,9 @@ protected:
 
     void *base;
     std::tie(base, mmap_size) = mmap_gc::mmap(mmap_name, mmap_fd, mmap_size,
-                                              std::bind(&vector<T>::gc_done, this, std::placeholders::_1, std::placeholders::_2));
+                                              std::bind(&vector<T>::gc_done, this, std::placeholders::_1, std::placeholders::_2),
+                                              policy,
+                                              &mmap_access);
 
     entries_capacity = (mmap_size - 4096) / sizeof(T);
     mmap_base        = reinterpret_cast<uint8_t *>(base);
@@ -101,6 +103,7 @@ protected:
   }
 
   __attribute__((noinline)) T *reserve_int(size_t n) const {
+    mmap_gc::touch(mmap_access);
     if (mmap_base == nullptr) {
       assert(mmap_fd < 0);
       assert(mmap_size == 0);
@@ -144,8 +147,10 @@ protected:
   mutable size_t    entries_capacity;  // size/sizeof - space_control
   mutable size_t    mmap_size;
   mutable int       mmap_fd;
+  mutable mmap_gc_access mmap_access;  // mmap_gc::touch
+  mmap_policy       policy;
   const std::string mmap_path;
-  const std::string mmap_name;
+  std::string       mmap_name;  // empty for anonymous
 
   bool gc_done(void *base, bool force_recycle) const {
     assert(base == mmap_base);
@@ -165,6 +170,7 @@ protected:
   size_t calc_min_mmap_size() const { return sizeof(T) * MMAPA_MIN_ENTRIES + 4096; }
 
   __attribute__((inline)) T *ref_base() const {
+    mmap_gc::touch(mmap_access);  // before the check, claims the vector for this thread
     if (MMAP_LIB_LIKELY(mmap_base != nullptr)) {
       return (T *)(mmap_base + 4096);
     }
@@ -191,8 +197,9 @@ public:
       , entries_capacity(0)
       , mmap_size(0)
       , mmap_fd(-1)
+      , policy(mmap_policy::get_default())
       , mmap_path(_path.empty() ? "." : _path)
-      , mmap_name{std::string(_path) + std::string("/") + std::string(_map_name)} {
+      , mmap_name{policy.anonymous ? "" : std::string(_path) + std::string("/") + std::string(_map_name)} {
     if (mmap_path != ".") {
       struct stat sb;
       if (stat(mmap_path.c_str(), &sb) != 0 || !S_ISDIR(sb.st_mode)) {
@@ -202,7 +209,8 @@ public:
     }
   }
 
-  explicit vector() : mmap_base(0), entries_size(nullptr), entries_capacity(0), mmap_size(0), mmap_fd(-1) {}
+  explicit vector()
+      : mmap_base(0), entries_size(nullptr), entries_capacity(0), mmap_size(0), mmap_fd(-1), policy(mmap_policy::get_default()) {}
 
   ~vector() {
     if (mmap_base) {
@@ -299,6 +307,7 @@ public:
   }
 
   void clear() {
+    mmap_gc::touch(mmap_access);
     if (mmap_base == nullptr) {
       assert(mmap_base == nullptr);
       assert(mmap_fd < 0);
@@ -316,6 +325,14 @@ public:
     assert(entries_size == nullptr);
   }
 
+  // Call before the first access. Anonymous drops the file backup (the contents of the file are not loaded)
+  void set_policy(const mmap_policy &p) {
+    assert(mmap_base == nullptr && mmap_fd < 0);
+    policy = p;
+    if (policy.anonymous) mmap_name.clear();
+  }
+  [[nodiscard]] const mmap_policy &get_policy() const { return policy; }
+
   [[nodiscard]] inline std::string_view get_name() const { return mmap_name; }
   [[nodiscard]] inline std::string_view get_path() const { return mmap_path; }
 
@@ -332,6 +349,7 @@ public:
   }
 
   [[nodiscard]] size_t size() const {
+    mmap_gc::touch(mmap_access);
     if (MMAP_LIB_LIKELY(entries_size != nullptr)) {
       return *entries_size;
     }
@@ -16,6 +16,9 @@
 #include "mmap_map.hpp"
 #include "mmap_vector.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <random>
 #include <type_traits>
 
 #define BENCHSIZE 10000
@@ -89,6 +92,110 @@ void random_mmap_map(int max) {
   }
 }
 
+static size_t file_size(const std::string &name) {
+  struct stat sb;
+  if (stat(name.c_str(), &sb) != 0)
+    return 0;
+  return sb.st_size;
+}
+
+// Worst-case insert latency while the map grows (each resize doubles the table)
+void insert_latency_mmap_map(int n_inserts) {
+  for (auto incremental : {false, true}) {
+    Lrand<int> rng;
+
+    std::string name = std::string("insert_latency_mmap_map ") + (incremental ? "(incremental rehash) " : "(full rehash) ")
+                       + std::to_string(n_inserts);
+    Lbench b(name);
+
+    mmap_lib::map<uint32_t,uint32_t> map("lgdb_bench","bench_map_use_latency.data");
+    map.clear();
+    map.set_incremental_rehash(incremental ? 1024 : 0);
+
+    std::vector<double> lat;
+    lat.reserve(n_inserts);
+
+    for (int i = 0; i < n_inserts; ++i) {
+      uint32_t key = rng.any();
+      auto start = std::chrono::steady_clock::now();
+      map.set(key, i);
+      auto stop = std::chrono::steady_clock::now();
+      lat.emplace_back(std::chrono::duration<double, std::micro>(stop - start).count());
+    }
+
+    std::sort(lat.begin(), lat.end());
+    fmt::print("{} size:{} p50:{:.2f}us p99.9:{:.2f}us max:{:.0f}us\n", name, map.size(), lat[lat.size() / 2],
+               lat[lat.size() * 999 / 1000], lat.back());
+  }
+}
+
+// Insert/erase phases (like cprop/dce removing most of the entries). Reports the file size after each phase
+void erase_phases_mmap_map(int n_inserts) {
+  for (auto shrink : {false, true}) {
+    Lrand<int> rng;
+
+    std::string name = std::string("erase_phases_mmap_map ") + (shrink ? "(shrink) " : "(no shrink) ") + std::to_string(n_inserts);
+    Lbench b(name);
+
+    mmap_lib::map<uint32_t,uint32_t> map("lgdb_bench","bench_map_use_phases.data");
+    map.clear();
+    map.set_shrink(shrink);
+
+    std::vector<uint32_t> keys;
+    for (int phase = 0; phase < 4; ++phase) {
+      for (int i = 0; i < n_inserts; ++i) {
+        uint32_t key = rng.any();
+        map.set(key, i);
+        keys.emplace_back(key);
+      }
+      auto full_size = file_size("lgdb_bench/bench_map_use_phases.data");
+
+      // erase 95% of the entries
+      std::vector<uint32_t> kept;
+      for (auto key : keys) {
+        if (rng.max(20) == 0)
+          kept.emplace_back(key);
+        else
+          map.erase(key);
+      }
+      keys.swap(kept);
+
+      fmt::print("{} phase:{} size:{} file {}KB -> {}KB\n", name, phase, map.size(), full_size / 1024,
+                 file_size("lgdb_bench/bench_map_use_phases.data") / 1024);
+    }
+  }
+}
+
+// Near contiguous ids (Node/Node_pin compact ids): identity indexing vs hashing
+void dense_mmap_map(int n_inserts) {
+  for (auto dense : {false, true}) {
+    Lrand<int> rng;
+
+    std::vector<uint32_t> keys;
+    for (uint32_t i = 1; keys.size() < static_cast<size_t>(n_inserts); i += 1 + rng.max(3)) keys.emplace_back(i);
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(7));
+
+    std::string name = std::string("dense_mmap_map ") + (dense ? "(dense) " : "(hashed) ") + std::to_string(n_inserts);
+    Lbench b(name);
+
+    mmap_lib::map<uint32_t,uint32_t> map("lgdb_bench","bench_map_use_dense.data");
+    map.clear();
+    if (!dense)
+      map.set_dense(0);
+
+    for (auto key : keys) map.set(key, key);
+    b.sample("insert");
+
+    uint64_t total = 0;
+    for (int rep = 0; rep < 4; ++rep) {
+      for (auto key : keys) total += map.get(key);
+    }
+    b.sample("lookup");
+
+    fmt::print("{} dense:{} total:{}\n", name, map.is_dense(), total);
+  }
+}
+
 void random_abseil_map(int max) {
   Lrand<int> rng;
 
@@ -185,6 +292,9 @@ int main(int argc, char **argv) {
   bool run_random_abseil_map  = false;
   bool run_random_ska_map     = false;
   bool run_random_vector_map  = false;
+  bool run_insert_latency     = false;
+  bool run_erase_phases       = false;
+  bool run_dense              = false;
 
   if (argc>1) {
     if (strcasecmp(argv[1],"std")==0)
@@ -201,6 +311,12 @@ int main(int argc, char **argv) {
       run_random_ska_map = true;
     else if (strcasecmp(argv[1],"vector")==0)
       run_random_vector_map = true;
+    else if (strcasecmp(argv[1],"latency")==0)
+      run_insert_latency = true;
+    else if (strcasecmp(argv[1],"phases")==0)
+      run_erase_phases = true;
+    else if (strcasecmp(argv[1],"dense")==0)
+      run_dense = true;
   }else{
     run_random_std_map     = true;
     run_random_robin_map   = true;
@@ -209,6 +325,9 @@ int main(int argc, char **argv) {
     run_random_abseil_map  = true;
     run_random_ska_map     = true;
     run_random_vector_map  = true;
+    run_insert_latency     = true;
+    run_erase_phases       = true;
+    run_dense              = true;
   }
 
   //const std::vector<int> nums = {100000, 500000, 1000000, 2000000, 3000000, 4000000, 5000000, 6000000, 7000000, 8000000, 9000000, 10000000};
@@ -237,6 +356,15 @@ int main(int argc, char **argv) {
       random_mmap_map(i);
   }
 
+  if (run_insert_latency)
+    insert_latency_mmap_map(4000000);
+
+  if (run_erase_phases)
+    erase_phases_mmap_map(1000000);
+
+  if (run_dense)
+    dense_mmap_map(4000000);
+
   return 0;
 }
 
@@ -15,6 +15,7 @@
 #include "robin_hood.hpp"
 
 #include "mmap_map.hpp"
+#include "mmap_set.hpp"
 
 #define BENCH_OUT_SIZE 500
 #define BENCH_INN_SIZE 200
@@ -250,6 +251,63 @@ void random_mmap_set(int max, std::string_view name) {
 
 }
 
+void random_mmap_lib_set(int max, std::string_view name) {
+  Lrand<int> rng;
+
+  std::string type_test("mmap_lib_set ");
+  if (name.empty())
+    type_test += "(effemeral)";
+  else
+    type_test += "(persistent)";
+
+  Lbench b(type_test);
+
+  mmap_lib::set<uint32_t> map(name.empty()?"":"lgdb_bench", name);
+
+  for (int n = 1; n < BENCH_OUT_SIZE; ++n) {
+    for (int i = 0; i < BENCH_INN_SIZE; ++i) {
+      auto pos = rng.max(max);
+      map.insert(pos);
+      pos = rng.max(max); map.erase(pos);
+      pos = rng.max(max);
+      if (map.has(pos))
+        map.erase(pos);
+    }
+  }
+
+  b.sample("insert/erase dense");
+  int conta = 0;
+  for (int i = 0; i < BENCH_INN_SIZE; ++i) {
+    for (auto it = map.begin(), end = map.end(); it != end;++it) {
+      conta++;
+    }
+    map.insert(rng.max(max));
+    auto pos = rng.max(max);
+    if (map.has(pos))
+      map.erase(pos);
+  }
+  b.sample("traversal sparse");
+
+  printf("inserts random %d\n",conta);
+  conta = 0;
+
+  for (int i = 0; i < max; ++i) {
+    map.erase(rng.max(max));
+    map.erase(rng.max(max));
+    map.erase(rng.max(max));
+    map.erase(rng.max(max));
+  }
+
+  for (int i = 0; i < BENCH_INN_SIZE; ++i) {
+    for (auto it = map.begin(), end = map.end(); it != end;++it) {
+      conta++;
+    }
+  }
+  b.sample("traversal dense");
+
+  printf("inserts random %d\n",conta);
+}
+
 void random_abseil_set(int max) {
   Lrand<int> rng;
 
@@ -559,6 +617,7 @@ int main(int argc, char **argv) {
   bool run_random_std_set    = false;
   bool run_random_robin_set  = false;
   bool run_random_mmap_set = false;
+  bool run_random_mmap_lib_set = false;
   bool run_random_abseil_set = false;
   bool run_random_ska_set    = false;
   bool run_random_vector_set = false;
@@ -570,6 +629,8 @@ int main(int argc, char **argv) {
       run_random_robin_set = true;
     else if (strcasecmp(argv[1],"mmap")==0)
       run_random_mmap_set = true;
+    else if (strcasecmp(argv[1],"mmap_set")==0)
+      run_random_mmap_lib_set = true;
     else if (strcasecmp(argv[1],"abseil")==0)
       run_random_abseil_set = true;
     else if (strcasecmp(argv[1],"ska")==0)
@@ -580,6 +641,7 @@ int main(int argc, char **argv) {
     run_random_std_set    = true;
     run_random_robin_set  = true;
     run_random_mmap_set = true;
+    run_random_mmap_lib_set = true;
     run_random_abseil_set = true;
     run_random_ska_set    = true;
     run_random_vector_set = true;
@@ -607,6 +669,11 @@ int main(int argc, char **argv) {
       random_mmap_set(i,"");
       random_mmap_set(i,"mmap_map_set.data");
     }
+
+    if (run_random_mmap_lib_set) {
+      random_mmap_lib_set(i,"");
+      random_mmap_lib_set(i,"mmap_lib_set.data");
+    }
   }
 
   return 0;
@@ -142,6 +142,31 @@ void use_mmap_vector(int max) {
   }
 }
 
+void use_mmap_vector_file(int max) {
+
+  Lbench b("mmap_vector_file " + std::to_string(max));
+
+  // file backed, traversed after a reload. Compare MMAP_LIB_POLICY settings (hugepage,populate,sequential...)
+  for (int n = 1; n < NITERS; ++n) {
+    {
+      mmap_lib::vector<uint32_t> map("lgdb_bench", "bench_vector_use_vector");
+      map.clear();
+      for (int i = 0; i < max; ++i) {
+        map.emplace_back(i);
+      }
+    }
+    mmap_lib::vector<uint32_t> map("lgdb_bench", "bench_vector_use_vector");
+    int conta = max*NIT;
+    for(int i=0;i<NIT;++i) {
+      for(auto v:map) {
+        (void)v;
+        conta--;
+      }
+    }
+    assert(conta==0);
+  }
+}
+
 int main(int argc, char **argv) {
 
   bool run_use_std_vector = false;
@@ -149,6 +174,7 @@ int main(int argc, char **argv) {
   bool run_use_abseil_map = false;
   bool run_use_mmap_map = false;
   bool run_use_mmap_vector     = false;
+  bool run_use_mmap_vector_file = false;
 
   if (argc>1) {
     if (strcasecmp(argv[1],"std_vector")==0)
@@ -161,12 +187,15 @@ int main(int argc, char **argv) {
       run_use_mmap_map = true;
     else if (strcasecmp(argv[1],"mmap_vector")==0)
       run_use_mmap_vector = true;
+    else if (strcasecmp(argv[1],"mmap_vector_file")==0)
+      run_use_mmap_vector_file = true;
   }else{
     run_use_std_vector  = true;
     run_use_robin_map   = true;
     run_use_mmap_map    = true;
     run_use_abseil_map  = true;
     run_use_mmap_vector = true;
+    run_use_mmap_vector_file = true;
   }
 
   //const std::vector<int> nums = {100000, 500000, 1000000, 2000000, 3000000, 4000000, 5000000, 6000000, 7000000, 8000000, 9000000, 10000000};
@@ -186,6 +215,9 @@ int main(int argc, char **argv) {
 
     if (run_use_mmap_vector)
       use_mmap_vector(i);
+
+    if (run_use_mmap_vector_file)
+      use_mmap_vector_file(i);
   }
 
   return 0;
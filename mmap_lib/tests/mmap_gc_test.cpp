@@ -4,11 +4,15 @@
 #include <sys/time.h>
 #include <sys/resource.h>
 
+#include <atomic>
+#include <thread>
+
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "lrand.hpp"
 
 #include "mmap_gc.hpp"
+#include "mmap_map.hpp"
 
 using testing::HasSubstr;
 
@@ -50,6 +54,250 @@ static bool trigger_clean2(void *base, bool force_recycle) {
   return false;
 }
 
+static bool trigger_clean_ok(void *base, bool force_recycle) { return false; }
+
+TEST_F(Setup_mmap_gc_test, checkpoint) {
+  // Before the rlimit tests (the flusher starts a thread)
+  std::vector<void *> bases;
+  for (int i = 0; i < 8; ++i) {
+    std::string name("mmap_gc_test_ckpt" + std::to_string(i) + ".data");
+    int fd = mmap_lib::mmap_gc::open(name);
+    ASSERT_GE(fd, 0);
+
+    void *base;
+    size_t size;
+    std::tie(base, size) = mmap_lib::mmap_gc::mmap(name, fd, 1024 * 1024, trigger_clean_ok);
+    bases.emplace_back(base);
+  }
+
+  uint64_t last = 0;
+  for (int step = 0; step < 4; ++step) {
+    for (auto *base : bases) {
+      int *value = (int *)base;
+      for (int j = 0; j < 256 * 1024; j = j + 1024) {
+        value[j] = j + step;
+      }
+    }
+    auto t1 = mmap_lib::mmap_gc::flush_async();
+    auto t2 = mmap_lib::mmap_gc::checkpoint();
+    EXPECT_LT(t1, t2);
+    EXPECT_LT(last, t1);
+    last = t2;
+  }
+
+  mmap_lib::mmap_gc::wait_checkpoint(last);
+  EXPECT_TRUE(mmap_lib::mmap_gc::is_checkpoint_done(last));
+  EXPECT_TRUE(mmap_lib::mmap_gc::is_checkpoint_done(last - 1));
+
+  // recycle while a checkpoint is in flight
+  for (auto *base : bases) {
+    ((int *)base)[0] = 33;
+  }
+  mmap_lib::mmap_gc::checkpoint();
+  for (auto *base : bases) {
+    mmap_lib::mmap_gc::recycle(base);
+  }
+  mmap_lib::mmap_gc::wait_checkpoint();
+
+  // The reads below go through the page cache, they can not tell if the data is on disk. The synced count checks that
+  // the checkpoint after the recycle still fdatasyncs the files (reopened by name)
+  auto synced = mmap_lib::mmap_gc::get_stats().synced_fds;
+  mmap_lib::mmap_gc::wait_checkpoint(mmap_lib::mmap_gc::checkpoint());
+  EXPECT_EQ(mmap_lib::mmap_gc::get_stats().synced_fds - synced, 8 + 1);  // the 8 recycled files and their directory
+
+  synced = mmap_lib::mmap_gc::get_stats().synced_fds;
+  mmap_lib::mmap_gc::wait_checkpoint(mmap_lib::mmap_gc::checkpoint());
+  EXPECT_EQ(mmap_lib::mmap_gc::get_stats().synced_fds, synced);  // nothing left to sync
+
+  for (int i = 0; i < 8; ++i) {
+    std::string name("mmap_gc_test_ckpt" + std::to_string(i) + ".data");
+    int fd = ::open(name.c_str(), O_RDONLY);
+    ASSERT_GE(fd, 0);
+    int v[2];
+    EXPECT_EQ(::read(fd, v, sizeof(v)), sizeof(v));
+    EXPECT_EQ(v[0], 33);
+    ::close(fd);
+    unlink(name.c_str());
+  }
+}
+
+TEST_F(Setup_mmap_gc_test, lru_hot_maps) {
+  // More maps than n_max_mmaps/n_max_fds. The first (oldest) maps stay hot, so the LRU must keep them mapped
+  constexpr int n_hot  = 16;
+  constexpr int n_cold = 1000;
+
+  std::vector<std::unique_ptr<mmap_lib::map<uint32_t, uint32_t>>> maps;
+  for (int i = 0; i < n_hot + n_cold; ++i) {
+    maps.emplace_back(std::make_unique<mmap_lib::map<uint32_t, uint32_t>>("lgdb_gc_lru", "map" + std::to_string(i)));
+    maps.back()->clear();
+  }
+
+  for (int i = 0; i < n_hot; ++i) {
+    maps[i]->set(i, i);
+  }
+
+  auto start = mmap_lib::mmap_gc::get_stats();
+
+  for (int i = n_hot; i < n_hot + n_cold; ++i) {
+    maps[i]->set(i, i);  // cold: touched once
+
+    for (int h = 0; h < n_hot; ++h) {
+      EXPECT_EQ(maps[h]->get(h), h);
+    }
+  }
+
+  auto end = mmap_lib::mmap_gc::get_stats();
+  EXPECT_GT(end.evictions, start.evictions);  // more than 512 open
+  EXPECT_EQ(end.misses, start.misses);        // but no hot map was evicted
+  EXPECT_GE(end.hits - start.hits, n_cold);   // the hot maps, at least once per new mmap
+
+  // evicted cold maps come back from the file
+  for (int i = n_hot; i < n_hot + n_cold; ++i) {
+    EXPECT_EQ(maps[i]->get(i), i);
+  }
+  auto reload = mmap_lib::mmap_gc::get_stats();
+  EXPECT_GT(reload.misses, end.misses);
+
+  for (auto &m : maps) {
+    m->clear();
+  }
+}
+
+TEST_F(Setup_mmap_gc_test, threads_separate_maps) {
+  // Each thread opens and grows its own maps. Together they go over the fd limit, so the pool is recycled while
+  // both threads mmap/remap
+  constexpr int n_threads = 2;
+  constexpr int n_maps    = 300;
+  constexpr int n_entries = 2000;
+
+  auto worker = [](int t) {
+    std::vector<std::unique_ptr<mmap_lib::map<uint32_t, uint32_t>>> maps;
+    for (int i = 0; i < n_maps; ++i) {
+      auto name = "t" + std::to_string(t) + "_map" + std::to_string(i);
+      maps.emplace_back(std::make_unique<mmap_lib::map<uint32_t, uint32_t>>("lgdb_gc_thread", name));
+      maps.back()->clear();
+    }
+    for (int j = 0; j < n_entries; ++j) {
+      for (int i = 0; i < n_maps; i += 10) {
+        maps[i]->set(j, j + i + t);
+      }
+      maps[j % n_maps]->set(n_entries + j, t);
+    }
+    int n_errors = 0;
+    for (int i = 0; i < n_maps; ++i) {
+      if (i % 10 == 0) {
+        for (int j = 0; j < n_entries; ++j) {
+          if (maps[i]->get(j) != static_cast<uint32_t>(j + i + t)) ++n_errors;
+        }
+      }
+      for (int j = i; j < n_entries; j += n_maps) {
+        if (maps[i]->get(n_entries + j) != static_cast<uint32_t>(t)) ++n_errors;
+      }
+      maps[i]->clear();
+    }
+    return n_errors;
+  };
+
+  std::vector<int>         errors(n_threads);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < n_threads; ++t) {
+    threads.emplace_back([&errors, &worker, t]() { errors[t] = worker(t); });
+  }
+  for (auto &th : threads) {
+    th.join();
+  }
+
+  for (int t = 0; t < n_threads; ++t) {
+    EXPECT_EQ(errors[t], 0);
+  }
+}
+
+TEST_F(Setup_mmap_gc_test, evicted_empty_map) {
+  // The gc removes the file of an empty map, the next access must start a new table
+  mmap_lib::map<uint32_t, uint32_t> empty_map("lgdb_gc_empty", "empty");
+  empty_map.clear();
+  EXPECT_FALSE(empty_map.has(1));  // mapped and empty
+
+  auto start = mmap_lib::mmap_gc::get_stats();
+
+  std::vector<std::unique_ptr<mmap_lib::map<uint32_t, uint32_t>>> maps;
+  for (int i = 0; i < 1000; ++i) {
+    maps.emplace_back(std::make_unique<mmap_lib::map<uint32_t, uint32_t>>("lgdb_gc_empty", "map" + std::to_string(i)));
+    maps.back()->clear();
+    maps.back()->set(i, i);
+  }
+  EXPECT_GT(mmap_lib::mmap_gc::get_stats().evictions, start.evictions);  // the oldest (empty_map) first
+
+  EXPECT_FALSE(empty_map.has(1));
+  empty_map.set(1, 3);
+  EXPECT_EQ(empty_map.get(1), 3);
+  EXPECT_EQ(empty_map.size(), 1);
+
+  empty_map.clear();
+  for (auto &m : maps) {
+    m->clear();
+  }
+}
+
+TEST_F(Setup_mmap_gc_test, threads_handoff_maps) {
+  // The main thread opens maps up to the fd limit, and hands some of them to a user thread. Then a worker that owns
+  // nothing goes over the limit. It must not recycle the maps in use by the user thread
+  constexpr int n_used    = 32;
+  constexpr int n_new     = 600;
+
+  std::vector<std::unique_ptr<mmap_lib::map<uint32_t, uint32_t>>> maps;
+  while (maps.size() < n_used || mmap_lib::mmap_gc::get_stats().open_fds <= 500) {
+    maps.emplace_back(std::make_unique<mmap_lib::map<uint32_t, uint32_t>>("lgdb_gc_handoff", "main" + std::to_string(maps.size())));
+    maps.back()->clear();
+    maps.back()->set(0, maps.size());
+  }
+
+  std::atomic<bool> claimed{false};
+  std::atomic<bool> stop{false};
+  int               user_errors = 0;
+  std::thread       user([&]() {
+    for (int i = 0; i < n_used; ++i) {
+      if (maps[i]->get(0) != static_cast<uint32_t>(i + 1)) ++user_errors;
+      maps[i]->set(1, i);
+    }
+    claimed = true;
+    while (!stop) std::this_thread::yield();  // still in use (e.g: a pass in the middle of an LGraph)
+    for (int i = 0; i < n_used; ++i) {
+      if (maps[i]->get(1) != static_cast<uint32_t>(i)) ++user_errors;
+    }
+  });
+  while (!claimed) std::this_thread::yield();
+
+  for (size_t i = n_used; i < maps.size(); ++i) {
+    EXPECT_EQ(maps[i]->get(0), i + 1);  // the user maps are now the least recently used
+  }
+
+  auto start = mmap_lib::mmap_gc::get_stats();
+
+  std::thread worker([]() {
+    std::vector<std::unique_ptr<mmap_lib::map<uint32_t, uint32_t>>> own;
+    for (int i = 0; i < n_new; ++i) {
+      own.emplace_back(std::make_unique<mmap_lib::map<uint32_t, uint32_t>>("lgdb_gc_handoff", "worker" + std::to_string(i)));
+      own.back()->clear();
+      own.back()->set(i, i);
+    }
+    for (auto &m : own) m->clear();
+  });
+  worker.join();
+  stop = true;
+  user.join();
+
+  auto end = mmap_lib::mmap_gc::get_stats();
+  EXPECT_GT(end.evictions, start.evictions);  // the worker recycled its own maps
+  EXPECT_EQ(end.misses, start.misses);        // but the user maps stayed mapped
+  EXPECT_EQ(user_errors, 0);
+
+  for (int i = 0; i < n_used; ++i) {
+    EXPECT_EQ(maps[i]->get(0), i + 1);
+  }
+  for (auto &m : maps) m->clear();
+}
+
 TEST_F(Setup_mmap_gc_test, mmap_limit) {
 #if 1
     struct rlimit rval;
@@ -60,6 +308,13 @@ TEST_F(Setup_mmap_gc_test, mmap_limit) {
     size_t sz = rusage.ru_maxrss;
 #else
     size_t sz = rusage.ru_maxrss * 1024L;
+    // RLIMIT_AS counts the address space (e.g: malloc arenas left by other threads), not just the rss
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (statm) {
+      size_t vm_pages = 0;
+      if (fscanf(statm, "%zu", &vm_pages) == 1) sz = std::max(sz, vm_pages * sysconf(_SC_PAGESIZE));
+      fclose(statm);
+    }
 #endif
 
     rval.rlim_cur = sz+16*1024*4096;
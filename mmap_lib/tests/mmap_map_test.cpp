@@ -1,5 +1,6 @@
 //  This file is distributed under the BSD 3-Clause License. See LICENSE for details.
 
+#include <fcntl.h>
 #include <unistd.h>
 
 #include "gmock/gmock.h"
@@ -8,6 +9,7 @@
 #include "fmt/format.h"
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "mmap_map.hpp"
 #include "mmap_bimap.hpp"
 #include "lrand.hpp"
@@ -494,6 +496,336 @@ TEST_F(Setup_mmap_map_test, lots_of_strings) {
   }
 }
 
+TEST_F(Setup_mmap_map_test, bimap_policy) {
+  unlink("lgdb_bench/mmap_map_test_bimap_anon_k2v");
+  unlink("lgdb_bench/mmap_map_test_bimap_anon_v2k");
+
+  auto p      = mmap_lib::mmap_policy::get_default();
+  p.anonymous = true;
+
+  mmap_lib::bimap<uint32_t, uint32_t> bimap("lgdb_bench", "mmap_map_test_bimap_anon");
+  bimap.set_policy(p);
+  EXPECT_TRUE(bimap.get_policy().anonymous);
+
+  for (uint32_t i = 0; i < 10000; ++i) {
+    bimap.set(i, i + 1);
+  }
+  for (uint32_t i = 0; i < 10000; ++i) {
+    EXPECT_EQ(bimap.get_val(i), i + 1);
+    EXPECT_EQ(bimap.get_key(i + 1), i);
+  }
+
+  struct stat sb;
+  EXPECT_NE(stat("lgdb_bench/mmap_map_test_bimap_anon_k2v", &sb), 0);  // no file backup
+  EXPECT_NE(stat("lgdb_bench/mmap_map_test_bimap_anon_v2k", &sb), 0);
+}
+
+TEST_F(Setup_mmap_map_test, incremental_rehash) {
+  Lrand<int> rng;
+
+  for (int n = 0; n < 2; ++n) {
+    absl::flat_hash_map<uint32_t, uint32_t> map2;
+    bool rehash_seen = false;
+    {
+      mmap_lib::map<uint32_t, uint32_t> map("lgdb_bench", "mmap_map_test_incremental");
+      map.clear();
+      map.set_incremental_rehash(1024);  // every resize is incremental
+
+      for (int i = 0; i < 200000; ++i) {
+        uint32_t key = rng.max(0xFFFFF);
+        if (rng.max(4) == 0) {
+          EXPECT_EQ(map.erase(key), map2.erase(key));
+        } else {
+          map.set(key, i);
+          map2[key] = i;
+        }
+
+        key = rng.max(0xFFFFF);
+        EXPECT_EQ(map.has(key), map2.count(key) == 1);
+        if (map2.count(key)) {
+          EXPECT_EQ(map.get(key), map2[key]);
+        }
+
+        rehash_seen = rehash_seen || map.is_rehashing();
+        EXPECT_EQ(map.size(), map2.size());
+      }
+
+      if (n == 0) {  // iterate without finishing the last migration by hand
+        size_t conta = 0;
+        for (const auto &it : map) {
+          EXPECT_EQ(map2[it.first], it.second);
+          ++conta;
+        }
+        EXPECT_EQ(conta, map2.size());
+        EXPECT_FALSE(map.is_rehashing());
+      }
+    }
+    EXPECT_TRUE(rehash_seen);
+
+    mmap_lib::map<uint32_t, uint32_t> map("lgdb_bench", "mmap_map_test_incremental");
+    EXPECT_EQ(map.size(), map2.size());
+    for (const auto &it : map2) {
+      EXPECT_TRUE(map.has(it.first));
+      EXPECT_EQ(map.get(it.first), it.second);
+    }
+  }
+}
+
+TEST_F(Setup_mmap_map_test, erase_wrap) {
+  // Close to the max load with a fixed table: clusters often wrap from the last bucket to the first, and erasing
+  // in the last bucket must shift the wrapped entries back
+  Lrand<int> rng;
+
+  mmap_lib::map<uint32_t, uint32_t> map;
+  absl::flat_hash_set<uint32_t>     map2;
+
+  for (int i = 0; i < 200000; ++i) {
+    uint32_t key = rng.max(1500);
+    if (rng.max(2) == 0) {
+      EXPECT_EQ(map.erase(key), map2.erase(key));
+    } else {
+      map.set(key, key);
+      map2.insert(key);
+    }
+
+    if ((i % 1000) == 0) {
+      for (uint32_t k = 0; k < 1500; ++k) {
+        EXPECT_EQ(map.has(k), map2.count(k) == 1);
+      }
+    }
+  }
+  EXPECT_EQ(map.size(), map2.size());
+}
+
+TEST_F(Setup_mmap_map_test, size_after_reopen) {
+  {
+    mmap_lib::map<uint32_t, uint32_t> map("lgdb_bench", "mmap_map_test_size_reopen");
+    map.clear();
+    for (uint32_t i = 0; i < 100; ++i) {
+      map.set(i, i);
+    }
+  }
+  {
+    mmap_lib::map<uint32_t, uint32_t> map("lgdb_bench", "mmap_map_test_size_reopen");
+    EXPECT_EQ(map.size(), 100);  // before any other access
+    map.clear();
+  }
+  mmap_lib::map<uint32_t, uint32_t> map("lgdb_bench", "mmap_map_test_size_reopen");
+  EXPECT_TRUE(map.empty());
+}
+
+TEST_F(Setup_mmap_map_test, checkpoint_during_rehash) {
+  mmap_lib::map<uint32_t, uint32_t> map("lgdb_bench", "mmap_map_test_ckpt_rehash");
+  map.clear();
+  map.set_incremental_rehash(1024);
+
+  uint32_t n = 0;
+  while (!map.is_rehashing()) {
+    map.set(n, n + 1);
+    ++n;
+  }
+
+  // The old table is not in the file, the checkpoint must finish the migration first
+  mmap_lib::mmap_gc::wait_checkpoint(mmap_lib::mmap_gc::checkpoint());
+  EXPECT_FALSE(map.is_rehashing());
+
+  {
+    int      fd         = ::open("lgdb_bench/mmap_map_test_ckpt_rehash", O_RDONLY);
+    uint64_t n_elements = 0;  // 2nd header word
+    ASSERT_GE(fd, 0);
+    EXPECT_EQ(::pread(fd, &n_elements, sizeof(n_elements), sizeof(uint64_t)), sizeof(n_elements));
+    EXPECT_EQ(n_elements, n);
+    ::close(fd);
+  }
+  EXPECT_EQ(map.size(), n);
+  for (uint32_t i = 0; i < n; ++i) {
+    EXPECT_EQ(map.get(i), i + 1);
+  }
+
+  map.clear();
+}
+
+TEST_F(Setup_mmap_map_test, format_upgrade) {
+  constexpr uint32_t n = 5000;
+  {
+    mmap_lib::map<uint32_t, uint32_t> map("lgdb_bench", "mmap_map_test_upgrade");
+    map.clear();
+    for (uint32_t i = 0; i < n; ++i) {
+      map.set(i * 7919, i);
+    }
+  }
+
+  // Files from older maps have a 0 version (the upper half of the 4th header word was unused)
+  constexpr off_t version_offset = 3 * sizeof(uint64_t) + 3 * sizeof(uint16_t);
+  {
+    int      fd      = ::open("lgdb_bench/mmap_map_test_upgrade", O_RDWR);
+    uint16_t version = 0;
+    ASSERT_GE(fd, 0);
+    EXPECT_EQ(::pread(fd, &version, sizeof(version), version_offset), sizeof(version));
+    EXPECT_NE(version, 0);
+    version = 0;
+    EXPECT_EQ(::pwrite(fd, &version, sizeof(version), version_offset), sizeof(version));
+    ::close(fd);
+  }
+
+  {
+    mmap_lib::map<uint32_t, uint32_t> map("lgdb_bench", "mmap_map_test_upgrade");
+    EXPECT_EQ(map.size(), n);
+    for (uint32_t i = 0; i < n; ++i) {
+      EXPECT_EQ(map.get(i * 7919), i);
+    }
+  }
+
+  {
+    int      fd      = ::open("lgdb_bench/mmap_map_test_upgrade", O_RDONLY);
+    uint16_t version = 0;
+    ASSERT_GE(fd, 0);
+    EXPECT_EQ(::pread(fd, &version, sizeof(version), version_offset), sizeof(version));
+    EXPECT_NE(version, 0);  // rehashed and rewritten with the current format
+    ::close(fd);
+  }
+
+  mmap_lib::map<uint32_t, uint32_t> map("lgdb_bench", "mmap_map_test_upgrade");
+  map.clear();
+}
+
+TEST_F(Setup_mmap_map_test, shrink) {
+  Lrand<int> rng;
+
+  auto file_size = []() {
+    struct stat sb;
+    if (stat("lgdb_bench/mmap_map_test_shrink", &sb) != 0)
+      return (size_t)0;
+    return (size_t)sb.st_size;
+  };
+
+  absl::flat_hash_map<uint32_t, uint32_t> map2;
+  {
+    mmap_lib::map<uint32_t, uint32_t> map("lgdb_bench", "mmap_map_test_shrink");
+    map.clear();
+
+    for (int phase = 0; phase < 3; ++phase) {
+      for (int i = 0; i < 200000; ++i) {
+        uint32_t key = rng.any();
+        map.set(key, i);
+        map2[key] = i;
+      }
+      auto big_capacity = map.capacity();
+      auto big_file     = file_size();
+
+      std::vector<uint32_t> keys;
+      for (const auto &it : map2) {
+        if (rng.max(100) != 0)
+          keys.emplace_back(it.first);
+      }
+      for (auto key : keys) {
+        EXPECT_EQ(map.erase(key), 1);
+        map2.erase(key);
+      }
+
+      EXPECT_EQ(map.size(), map2.size());
+      EXPECT_LT(map.capacity() * 2, big_capacity);  // the last shrink may still be migrating
+      EXPECT_LT(file_size() * 2, big_file);
+
+      size_t conta = 0;
+      for (const auto &it : map) {
+        EXPECT_EQ(map2[it.first], it.second);
+        ++conta;
+      }
+      EXPECT_EQ(conta, map2.size());
+      fmt::print("phase:{} capacity {}->{} file {}->{}\n", phase, big_capacity, map.capacity(), big_file, file_size());
+    }
+  }
+
+  mmap_lib::map<uint32_t, uint32_t> map("lgdb_bench", "mmap_map_test_shrink");
+  EXPECT_EQ(map.size(), map2.size());
+  for (const auto &it : map2) {
+    EXPECT_EQ(map.get(it.first), it.second);
+  }
+}
+
+TEST_F(Setup_mmap_map_test, dense) {
+  Lrand<int> rng;
+
+  absl::flat_hash_map<uint32_t, uint32_t> map2;
+  {
+    mmap_lib::map<uint32_t, uint32_t> map("lgdb_bench", "mmap_map_test_dense");
+    map.clear();
+
+    for (uint32_t i = 1; i < 100000; i += 1 + rng.max(3)) {  // near contiguous ids
+      map.set(i, i + 7);
+      map2[i] = i + 7;
+    }
+    EXPECT_TRUE(map.is_dense());
+
+    for (uint32_t i = 0; i < 100000; ++i) {
+      EXPECT_EQ(map.has(i), map2.count(i) == 1);
+    }
+    for (uint32_t i = 1; i < 100000; i += 1 + rng.max(8)) {
+      EXPECT_EQ(map.erase(i), map2.erase(i));
+    }
+
+    for (int i = 0; i < 100000; ++i) {  // sparse ids switch it back to hashing at the next resize
+      uint32_t key = rng.any();
+      map.set(key, i);
+      map2[key] = i;
+    }
+    EXPECT_FALSE(map.is_dense());
+    EXPECT_EQ(map.size(), map2.size());
+  }
+
+  mmap_lib::map<uint32_t, uint32_t> map("lgdb_bench", "mmap_map_test_dense");
+  EXPECT_EQ(map.size(), map2.size());
+  for (const auto &it : map2) {
+    EXPECT_EQ(map.get(it.first), it.second);
+  }
+
+  mmap_lib::map<uint32_t, uint32_t> map3;
+  map3.set_dense(0);
+  for (uint32_t i = 1; i < 10000; ++i) {
+    map3.set(i, i);
+  }
+  EXPECT_FALSE(map3.is_dense());
+}
+
+TEST_F(Setup_mmap_map_test, dense_max_id) {
+  constexpr uint32_t n = 5000;
+  {
+    mmap_lib::map<uint32_t, uint32_t> map("lgdb_bench", "mmap_map_test_dense_max");
+    map.clear();
+    map.set_dense(0);
+    for (uint32_t i = 1; i <= n; ++i) {
+      map.set(i, i);
+    }
+    EXPECT_FALSE(map.is_dense());
+  }
+
+  // Files from before max_id was tracked have a 0 (upper half of the 5th header word)
+  {
+    int      fd     = ::open("lgdb_bench/mmap_map_test_dense_max", O_RDWR);
+    uint32_t max_id = 0;
+    ASSERT_GE(fd, 0);
+    EXPECT_EQ(::pwrite(fd, &max_id, sizeof(max_id), 4 * sizeof(uint64_t) + sizeof(uint32_t)), sizeof(max_id));
+    ::close(fd);
+  }
+
+  mmap_lib::map<uint32_t, uint32_t> map("lgdb_bench", "mmap_map_test_dense_max");
+  map.reserve(2 * n);
+  EXPECT_TRUE(map.is_dense());
+
+  // a sparse id that is erased before the next resize does not keep the table hashed
+  map.set(10000000, 1);
+  EXPECT_TRUE(map.erase(10000000));
+  map.reserve(8 * n);
+  EXPECT_TRUE(map.is_dense());
+
+  EXPECT_EQ(map.size(), n);
+  for (uint32_t i = 1; i <= n; ++i) {
+    EXPECT_EQ(map.get(i), i);
+  }
+  map.clear();
+}
+
 static_assert( mmap_lib::is_array_serializable<std::string_view>::value);
 static_assert( mmap_lib::is_array_serializable<std::vector<int>>::value);
 static_assert(!mmap_lib::is_array_serializable<uint32_t>::value);
@@ -0,0 +1,122 @@
+//  This file is distributed under the BSD 3-Clause License. See LICENSE for details.
+
+#include <unistd.h>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include "absl/container/flat_hash_set.h"
+#include "mmap_set.hpp"
+#include "lrand.hpp"
+
+using testing::HasSubstr;
+
+class Setup_mmap_set_test : public ::testing::Test {
+protected:
+  void SetUp() override {
+  }
+
+  void TearDown() override {
+  }
+};
+
+TEST_F(Setup_mmap_set_test, random_insert_erase) {
+  Lrand<int> rng;
+
+  mmap_lib::set<uint32_t> set;
+  absl::flat_hash_set<uint32_t> set2;
+
+  for (int i = 0; i < 200000; ++i) {
+    uint32_t key = rng.max(50000);
+    switch (rng.max(3)) {
+      case 0:
+        EXPECT_EQ(set.insert(key), set2.insert(key).second);
+        break;
+      case 1:
+        EXPECT_EQ(set.erase(key), set2.erase(key));
+        break;
+      default:
+        EXPECT_EQ(set.has(key), set2.count(key) == 1);
+    }
+  }
+  EXPECT_EQ(set.size(), set2.size());
+
+  size_t conta = 0;
+  for (auto key : set) {
+    EXPECT_EQ(set2.count(key), 1);
+    ++conta;
+  }
+  EXPECT_EQ(conta, set2.size());
+}
+
+TEST_F(Setup_mmap_set_test, erase_while_iterating) {
+  mmap_lib::set<uint32_t> set;
+  absl::flat_hash_set<uint32_t> set2;
+
+  for (uint32_t i = 0; i < 20000; ++i) {
+    set.insert(i * 7);
+    set2.insert(i * 7);
+  }
+
+  for (auto it = set.begin(); it != set.end();) {
+    if ((*it % 3) == 0) {
+      set2.erase(*it);
+      it = set.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  EXPECT_EQ(set.size(), set2.size());
+  for (auto key : set2) {
+    EXPECT_TRUE(set.has(key));
+    EXPECT_TRUE(key % 3 != 0);
+  }
+}
+
+TEST_F(Setup_mmap_set_test, sparse_iteration) {
+  mmap_lib::set<uint64_t> set;
+
+  for (uint64_t i = 0; i < 100000; ++i) set.insert(i);
+  set.set_shrink(false);
+  for (uint64_t i = 0; i < 100000; ++i) {
+    if (i % 1000) set.erase(i);
+  }
+
+  EXPECT_EQ(set.size(), 100);
+  EXPECT_GT(set.capacity(), 100000);
+
+  uint64_t total = 0;
+  for (auto key : set) total += key;
+  EXPECT_EQ(total, 1000 * (99 * 100 / 2));
+}
+
+TEST_F(Setup_mmap_set_test, persistence) {
+  Lrand<int> rng;
+
+  absl::flat_hash_set<uint32_t> set2;
+  {
+    mmap_lib::set<uint32_t> set("lgdb_bench", "mmap_set_test_persistence");
+    set.clear();
+
+    for (int i = 0; i < 50000; ++i) {
+      uint32_t key = rng.any();
+      set.insert(key);
+      set2.insert(key);
+    }
+    EXPECT_EQ(set.size(), set2.size());
+  }
+
+  mmap_lib::set<uint32_t> set("lgdb_bench", "mmap_set_test_persistence");
+  EXPECT_EQ(set.size(), set2.size());
+  for (auto key : set2) {
+    EXPECT_TRUE(set.has(key));
+  }
+  for (auto key : set) {
+    EXPECT_EQ(set2.count(key), 1);
+  }
+
+  set.clear();
+  EXPECT_NE(access("lgdb_bench/mmap_set_test_persistence", F_OK), 0);
+  EXPECT_TRUE(set.empty());
+}
@@ -0,0 +1,139 @@
+//  This file is distributed under the BSD 3-Clause License. See LICENSE for details.
+
+#include <sys/stat.h>
+
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include "absl/container/flat_hash_map.h"
+#include "mmap_bimap.hpp"
+#include "mmap_str_pool.hpp"
+#include "lrand.hpp"
+
+using testing::HasSubstr;
+
+class Setup_mmap_str_pool_test : public ::testing::Test {
+protected:
+  void SetUp() override {
+  }
+
+  void TearDown() override {
+  }
+};
+
+TEST_F(Setup_mmap_str_pool_test, dedup) {
+  Lrand<int> rng;
+
+  mmap_lib::str_pool pool;
+  absl::flat_hash_map<std::string, uint32_t> handles;
+
+  for (int i = 0; i < 100000; ++i) {
+    std::string str = "top.cpu.alu" + std::to_string(rng.max(5000)) + "_wire";
+    if (rng.max(50) == 0) str.clear();  // empty strings are valid
+
+    auto handle = pool.insert(str);
+    EXPECT_NE(handle, 0);
+    if (handles.count(str)) {
+      EXPECT_EQ(handles[str], handle);
+    } else {
+      handles[str] = handle;
+    }
+  }
+
+  EXPECT_EQ(pool.size(), handles.size());
+  for (const auto &it : handles) {
+    EXPECT_EQ(pool.find(it.first), it.second);
+    EXPECT_EQ(pool.get(it.second), it.first);
+  }
+  EXPECT_EQ(pool.find("not_there"), 0);
+  EXPECT_FALSE(pool.has("not_there"));
+}
+
+TEST_F(Setup_mmap_str_pool_test, persistence) {
+  std::vector<std::pair<std::string, uint32_t>> handles;
+  {
+    mmap_lib::str_pool pool("lgdb_bench", "mmap_str_pool_test");
+    pool.clear();
+
+    for (int i = 0; i < 20000; ++i) {
+      std::string str = "sig_" + std::to_string(i) + std::string(i % 40, 'x');
+      handles.emplace_back(str, pool.insert(str));
+    }
+  }
+
+  mmap_lib::str_pool pool("lgdb_bench", "mmap_str_pool_test");
+  EXPECT_EQ(pool.size(), handles.size());
+  for (const auto &[str, handle] : handles) {
+    EXPECT_EQ(pool.get(handle), str);
+    EXPECT_EQ(pool.insert(str), handle);
+  }
+  EXPECT_EQ(pool.size(), handles.size());
+  pool.clear();
+}
+
+TEST_F(Setup_mmap_str_pool_test, shared_str_bimap) {
+  mmap_lib::str_pool::clear_shared("lgdb_bench", "mmap_str_pool_test_shared");
+  {
+    mmap_lib::str_bimap<uint32_t> names("lgdb_bench", "mmap_str_pool_test_names", "mmap_str_pool_test_shared");
+    mmap_lib::str_bimap<uint32_t> colors("lgdb_bench", "mmap_str_pool_test_colors", "mmap_str_pool_test_shared");
+    names.clear();
+    colors.clear();
+
+    for (uint32_t i = 1; i < 1000; ++i) {
+      names.set(i, "n" + std::to_string(i));
+      colors.set(i, "n" + std::to_string(i % 10));  // same text as some names
+    }
+    EXPECT_EQ(names.get_pool().size(), 1000);  // the colors reuse the name text (only n0 is new)
+
+    EXPECT_TRUE(names.has_val("n5"));
+    EXPECT_FALSE(names.has_val("n1000"));
+    EXPECT_EQ(names.get_key("n5"), 5);
+    EXPECT_EQ(colors.get_val(15), "n5");
+    EXPECT_FALSE(colors.has_val("n11"));  // in the pool, not in colors
+
+    names.set(5, "renamed");  // old text is not reachable from names anymore
+    EXPECT_FALSE(names.has_val("n5"));
+    EXPECT_EQ(names.get_key("renamed"), 5);
+    EXPECT_TRUE(colors.has_val("n5"));
+
+    EXPECT_EQ(names.erase_key(7), 1);
+    EXPECT_FALSE(names.has_key(7));
+    EXPECT_FALSE(names.has_val("n7"));
+    EXPECT_TRUE(names.find_val("n7") == names.end());
+    EXPECT_EQ(names.get_key(names.find_val("n8")), 8);
+  }
+
+  mmap_lib::str_bimap<uint32_t> names("lgdb_bench", "mmap_str_pool_test_names", "mmap_str_pool_test_shared");
+  EXPECT_EQ(names.size(), 998);
+  EXPECT_EQ(names.get_val(5), "renamed");
+  EXPECT_EQ(names.get_val(999), "n999");
+  for (auto it = names.begin(); it != names.end(); ++it) {
+    EXPECT_EQ(names.get_key(names.get_val(it)), names.get_key(it));
+  }
+
+  names.clear();
+  mmap_lib::str_pool::clear_shared("lgdb_bench", "mmap_str_pool_test_shared");
+}
+
+TEST_F(Setup_mmap_str_pool_test, str_bimap_policy) {
+  auto p      = mmap_lib::mmap_policy::get_default();
+  p.anonymous = true;
+
+  mmap_lib::str_bimap<uint32_t> names("lgdb_bench", "mmap_str_pool_test_anon", "mmap_str_pool_test_anon_pool");
+  names.set_policy(p);
+  EXPECT_TRUE(names.get_policy().anonymous);
+
+  for (uint32_t i = 1; i < 1000; ++i) {
+    names.set(i, "a" + std::to_string(i));
+  }
+  EXPECT_EQ(names.get_val(10), "a10");
+  EXPECT_EQ(names.get_key("a999"), 999);
+
+  struct stat sb;
+  EXPECT_NE(stat("lgdb_bench/mmap_str_pool_test_anon_k2v", &sb), 0);  // no file backup
+  EXPECT_NE(stat("lgdb_bench/mmap_str_pool_test_anon_v2k", &sb), 0);
+  EXPECT_NE(stat("lgdb_bench/mmap_str_pool_test_anon_pool_txt", &sb), 0);
+}
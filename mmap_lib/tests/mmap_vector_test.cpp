@@ -75,3 +75,29 @@ TEST_F(Setup_map_test, iter_test_set) {
   dense.set(100, 100);
 }
 
+
+TEST_F(Setup_map_test, policy) {
+
+  auto p = mmap_lib::mmap_policy::parse("hugepage,populate,random");
+  EXPECT_TRUE(p.hugepage);
+  EXPECT_TRUE(p.populate);
+  EXPECT_FALSE(p.anonymous);
+  EXPECT_EQ(p.access, mmap_lib::mmap_policy::Access::Random);
+
+  p.anonymous = true;
+  unlink("lgdb_bench/mmap_vector_test_anon");
+
+  mmap_lib::vector<int> dense("lgdb_bench", "mmap_vector_test_anon");
+  dense.set_policy(p);
+  EXPECT_TRUE(dense.get_name().empty());
+
+  for (int i = 0; i < 100000; ++i) {
+    dense.emplace_back(i);
+  }
+  for (int i = 0; i < 100000; ++i) {
+    EXPECT_EQ(dense[i], i);
+  }
+
+  struct stat sb;
+  EXPECT_NE(stat("lgdb_bench/mmap_vector_test_anon", &sb), 0);  // no file backup
+}
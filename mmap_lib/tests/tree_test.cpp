@@ -7,6 +7,8 @@
 #include "gtest/gtest.h"
 #include "fmt/format.h"
 
+#include "lbench.hpp"
+#include "lrand.hpp"
 #include "mmap_tree.hpp"
 
 class Elab_test : public ::testing::Test {
@@ -126,3 +128,101 @@ TEST_F(Elab_test, Preorder_traversal_check) {
 
   EXPECT_EQ(ast_preorder_traversal, ast_preorder_traversal_golden);
 }
+
+TEST_F(Elab_test, Frozen_traversal_check) {
+  std::vector<std::string> preorder_golden;
+  for(const auto &it:ast.depth_preorder(ast.get_root())) {
+    preorder_golden.push_back(ast.get_data(it));
+  }
+
+  std::vector<std::string> postorder_golden = {
+    "child1.0.0.0", "child1.0.0", "child1.0.1", "child1.0.2", "child1.0.3", "child1.0.4", "child1.0.5", "child1.0",
+    "child1.1.0", "child1.1.1", "child1.1.2", "child1.1", "child1.2", "root"};
+
+  EXPECT_FALSE(ast.is_frozen());
+  ast.freeze();
+  EXPECT_TRUE(ast.is_frozen());
+
+  std::vector<std::string> preorder;
+  for(const auto &[ti, data]:ast.frozen_preorder()) {
+    EXPECT_EQ(ast.get_data(ti), data);
+    preorder.push_back(data);
+  }
+  EXPECT_EQ(preorder, preorder_golden);
+
+  std::vector<std::string> postorder;
+  for(const auto &[ti, data]:ast.frozen_postorder()) {
+    EXPECT_EQ(ast.get_data(ti), data);
+    postorder.push_back(data);
+  }
+  EXPECT_EQ(postorder, postorder_golden);
+
+  std::vector<std::string> skipped;
+  auto range = ast.frozen_preorder();
+  for (auto it = range.begin(); it != range.end(); ++it) {
+    const auto &[ti, data] = *it;
+    skipped.push_back(data);
+    if (data == "child1.0") it.skip_subtree();
+  }
+  std::vector<std::string> skipped_golden = {"root", "child1.0", "child1.1", "child1.1.0", "child1.1.1", "child1.1.2", "child1.2"};
+  EXPECT_EQ(skipped, skipped_golden);
+
+  ast.add_child(ast.get_root(), "child1.3");
+  EXPECT_FALSE(ast.is_frozen());
+}
+
+TEST_F(Elab_test, Frozen_traversal_bench) {
+  // 10M nodes, LNAST like: statements with a few children each, some nested scopes
+  mmap_lib::tree<int> big;
+  Lrand<int> rnd;
+
+  big.set_root(0);
+  int n = 1;
+  std::vector<mmap_lib::Tree_index> scopes = {big.get_root()};
+  while (n < 10000000) {
+    auto scope = scopes[rnd.max(scopes.size())];
+    auto stmt  = big.add_child(scope, n++);
+    int nchild = 2 + rnd.max(4);
+    for (int i = 0; i < nchild; ++i) {
+      auto c = big.add_child(stmt, n++);
+      if (rnd.max(64) == 0) scopes.emplace_back(c);
+    }
+  }
+
+  uint64_t sum_golden = 0;
+  {
+    Lbench b("mmap_lib.tree.preorder_10M");
+    for (int rep = 0; rep < 4; ++rep) {
+      for (const auto &ti : big.depth_preorder()) {
+        sum_golden += big.get_data(ti);
+      }
+    }
+  }
+
+  {
+    Lbench b("mmap_lib.tree.freeze_10M");
+    big.freeze();
+  }
+
+  uint64_t sum = 0;
+  {
+    Lbench b("mmap_lib.tree.frozen_preorder_10M");
+    for (int rep = 0; rep < 4; ++rep) {
+      for (const auto &[ti, data] : big.frozen_preorder()) {
+        sum += data;
+      }
+    }
+  }
+  EXPECT_EQ(sum, sum_golden);
+
+  sum = 0;
+  {
+    Lbench b("mmap_lib.tree.frozen_postorder_10M");
+    for (int rep = 0; rep < 4; ++rep) {
+      for (const auto &[ti, data] : big.frozen_postorder()) {
+        sum += data;
+      }
+    }
+  }
+  EXPECT_EQ(sum, sum_golden);
+}
@@ -17,6 +17,7 @@ void Pass_bitwidth::setup() {
   Eprp_method m1("pass.bitwidth", "MIT algorithm for bitwidth optimization", &Pass_bitwidth::trans);
 
   m1.add_label_optional("max_iterations", "maximum number of iterations to try", "10");
+  m1.set_streamable();  // per lgraph state only (bwmap), submodules are streamed first
 
   register_pass(m1);
 }
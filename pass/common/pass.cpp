@@ -2,6 +2,13 @@
 
 #include <sys/stat.h>
 
+#include <algorithm>
+
+#include "absl/container/flat_hash_map.h"
+#include "lbench.hpp"
+#include "lgraph.hpp"
+#include "thread_pool.hpp"
+
 //Eprp Pass::eprp;
 
 Pass_plugin::Map_setup Pass_plugin::registry;
@@ -110,3 +117,54 @@ bool Pass::setup_directory(std::string_view dir) const {
 
   return true;
 }
+
+void Pass::each_lgraph_bottom_up(const Eprp_var::Eprp_lgs &lgs, bool parallel, const std::function<void(LGraph *)> &fn) const {
+  // LGraph::open is not thread safe, open the whole hierarchy before starting
+  absl::flat_hash_map<LGraph *, size_t> lg2level;  // 0 for leaf modules
+
+  std::function<size_t(LGraph *)> get_level = [&lg2level, &get_level](LGraph *lg) -> size_t {
+    const auto it = lg2level.find(lg);
+    if (it != lg2level.end()) return it->second;
+
+    lg2level[lg] = 0;  // No recursion in hierarchy, but do not hang if there is
+
+    size_t level = 0;
+    lg->each_sub_fast([lg, &level, &get_level](Node &node, Lg_type_id lgid) {
+      (void)node;
+      auto *sub_lg = LGraph::open(lg->get_path(), lgid);
+      if (sub_lg == nullptr) return;  // Black box, nothing to run
+
+      level = std::max(level, get_level(sub_lg) + 1);
+    });
+
+    lg2level[lg] = level;
+    return level;
+  };
+
+  std::vector<std::vector<LGraph *>> levels;
+  for (auto *lg : lgs) {
+    get_level(lg);
+  }
+  for (const auto &[lg, level] : lg2level) {
+    if (levels.size() <= level) levels.resize(level + 1);
+    levels[level].emplace_back(lg);
+  }
+
+  for (size_t level = 0; level < levels.size(); ++level) {
+    auto &lgs_level = levels[level];
+    std::sort(lgs_level.begin(), lgs_level.end(), [](const LGraph *a, const LGraph *b) { return a->get_name() < b->get_name(); });
+
+    auto run = [this, &fn, &lgs_level](size_t i) {
+      Lbench b(absl::StrCat(pass_name, "_", lgs_level[i]->get_name()));
+      fn(lgs_level[i]);
+    };
+
+    if (!parallel || lgs_level.size() == 1) {
+      for (size_t i = 0; i < lgs_level.size(); ++i) {
+        run(i);
+      }
+    } else {
+      Thread_pool::shared().parallel_for(0, lgs_level.size(), run, 1);  // only waits for this level, the pool is shared
+    }
+  }
+}
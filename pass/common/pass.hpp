@@ -29,6 +29,11 @@ protected:
 
   bool setup_directory(std::string_view dir) const;
 
+  // Call fn for each lgraph in lgs and every module below them in the hierarchy (once per module). Bottom-up: a
+  // module starts after all its submodules finish. With parallel, the modules at the same hierarchy level run in
+  // parallel: only for passes whose fn is thread safe and only modifies the lgraph passed. One Lbench per module.
+  void each_lgraph_bottom_up(const Eprp_var::Eprp_lgs &lgs, bool parallel, const std::function<void(LGraph *)> &fn) const;
+
   Pass(std::string_view _pass_name, const Eprp_var &var);
 
 public:
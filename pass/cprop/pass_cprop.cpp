@@ -16,6 +16,8 @@ static Pass_plugin sample("pass_cprop", Pass_cprop::setup);
 
 void Pass_cprop::setup() {
   Eprp_method m1("pass.cprop", "in-place copy propagation", &Pass_cprop::optimize);
+  m1.add_label_optional("hier", "true: also submodules, bottom-up", "false");
+  m1.add_label_optional("parallel", "true: with hier, modules at the same hierarchy level in parallel (experimental)", "false");
 
   register_pass(m1);
 }
@@ -25,6 +27,16 @@ Pass_cprop::Pass_cprop(const Eprp_var &var) : Pass("pass.cprop", var) {}
 void Pass_cprop::optimize(Eprp_var &var) {
   Pass_cprop pass(var);
 
+  if (var.get("hier") == "true") {
+    // Opt-in: cprop is not audited for thread safety (e.g: shared attributes and library updates)
+    bool parallel = var.get("parallel") == "true";
+    pass.each_lgraph_bottom_up(var.lgs, parallel, [&var](LGraph *lg) {
+      Pass_cprop p(var);  // node2tuple is per lgraph
+      p.trans(lg);
+    });
+    return;
+  }
+
   for (auto &l : var.lgs) {
     pass.trans(l);
   }
@@ -8,6 +8,7 @@
 #include "spmc.hpp"
 #include "mpmc.hpp"
 #include "thread_pool.hpp"
+#include "thread_pool_spmc.hpp"
 #include "concurrentqueue.hpp"
 
 int control = 1023;
@@ -93,3 +94,167 @@ TEST_F(GTest1, bench) {
   }
 }
 
+TEST_F(GTest1, parallel_for) {
+  Thread_pool pool;
+
+  std::vector<int> data(1000003, 0);
+  pool.parallel_for(0, data.size(), [&data](size_t i) { data[i] = i & 0xFF; });
+
+  long sum = 0;
+  long sum2 = 0;
+  for (size_t i = 0; i < data.size(); ++i) {
+    sum += data[i];
+    sum2 += i & 0xFF;
+  }
+  EXPECT_EQ(sum, sum2);
+
+  pool.parallel_for(10, 10, [](size_t i) { (void)i; EXPECT_TRUE(false); });
+}
+
+TEST_F(GTest1, nested_groups) {
+  Thread_pool pool(4);
+
+  std::atomic<int> leaves = 0;
+
+  Task_group top(pool);
+  for (int i = 0; i < 64; ++i) {
+    top.run([&pool, &leaves] {
+      // fork/join inside a job, waits by running jobs (no deadlock with few threads)
+      Task_group inner(pool);
+      for (int j = 0; j < 64; ++j) {
+        inner.run([&leaves] { leaves++; });
+      }
+      inner.wait();
+    });
+  }
+  top.wait();
+
+  EXPECT_EQ(leaves, 64 * 64);
+
+  total = 0;
+  pool.parallel_for(0, 100, [&pool](size_t i) {
+    (void)i;
+    pool.parallel_for(0, 100, [](size_t j) { total += j; });
+  });
+  EXPECT_EQ(total, 100 * 4950);
+}
+
+TEST_F(GTest1, nested_wait_all) {
+  Thread_pool pool(2);
+
+  std::atomic<int> leaves = 0;
+  std::atomic<int> parents_done = 0;
+  for (int i = 0; i < 16; ++i) {
+    pool.add([&pool, &leaves, &parents_done] {
+      for (int j = 0; j < 32; ++j) {
+        pool.add([&leaves] { leaves++; });
+      }
+      pool.wait_all();  // the calling job (and other parents waiting) must not block it
+      parents_done++;
+    });
+  }
+  pool.wait_all();
+
+  EXPECT_EQ(parents_done, 16);
+  EXPECT_EQ(leaves, 16 * 32);
+}
+
+// Minimal pool over moodycamel to compare the queue costs
+class Thread_pool_moody {
+  moodycamel::ConcurrentQueue<std::function<void(void)>> queue;
+  std::vector<std::thread>                              threads;
+  std::atomic<int>                                      jobs_left;
+  std::atomic<bool>                                     finishing;
+
+public:
+  Thread_pool_moody() : jobs_left(0), finishing(false) {
+    unsigned n = std::max(1u, std::thread::hardware_concurrency() - 1);
+    for (unsigned i = 0; i < n; ++i) {
+      threads.emplace_back([this] {
+        std::function<void(void)> job;
+        while (!finishing) {
+          if (queue.try_dequeue(job)) {
+            job();
+            jobs_left--;
+          }
+        }
+      });
+    }
+  }
+  ~Thread_pool_moody() {
+    wait_all();
+    finishing = true;
+    for (auto &t : threads) t.join();
+  }
+  void add(std::function<void(void)> job) {
+    jobs_left++;
+    queue.enqueue(std::move(job));
+  }
+  void wait_all() {
+    std::function<void(void)> job;
+    while (jobs_left > 0) {
+      if (queue.try_dequeue(job)) {
+        job();
+        jobs_left--;
+      }
+    }
+  }
+};
+
+TEST_F(GTest1, pool_bench) {
+  const int JOB_COUNT = 2000000;
+
+  {
+    Thread_pool pool;
+    total = 0;
+    Lbench bb("pool.work_stealing.add");
+    for (int i = 0; i < JOB_COUNT; ++i) {
+      pool.add(mywork, 1);
+    }
+    pool.wait_all();
+    EXPECT_EQ(total, JOB_COUNT);
+  }
+  {
+    Thread_pool_spmc pool;
+    total = 0;
+    Lbench bb("pool.spmc.add");
+    for (int i = 0; i < JOB_COUNT; ++i) {
+      pool.add(mywork, 1);
+    }
+    pool.wait_all();
+    EXPECT_EQ(total, JOB_COUNT);
+  }
+  {
+    Thread_pool_moody pool;
+    total = 0;
+    Lbench bb("pool.concurrentqueue.add");
+    for (int i = 0; i < JOB_COUNT; ++i) {
+      pool.add([] { mywork(1); });
+    }
+    pool.wait_all();
+    EXPECT_EQ(total, JOB_COUNT);
+  }
+  {
+    Thread_pool pool;
+    total = 0;
+    Lbench bb("pool.work_stealing.parallel_for");
+    pool.parallel_for(0, JOB_COUNT, [](size_t i) { (void)i; mywork(1); }, 1024);
+    EXPECT_EQ(total, JOB_COUNT);
+  }
+  {
+    Thread_pool pool;
+    total = 0;
+    Lbench bb("pool.work_stealing.nested");  // jobs spawning jobs: stays in the worker deque
+    Task_group group(pool);
+    for (int i = 0; i < 1024; ++i) {
+      group.run([&pool, JOB_COUNT] {
+        Task_group inner(pool);
+        for (int j = 0; j < JOB_COUNT / 1024; ++j) {
+          inner.run([] { mywork(1); });
+        }
+      });
+    }
+    group.wait();
+    EXPECT_EQ(total, (JOB_COUNT / 1024) * 1024);
+  }
+}
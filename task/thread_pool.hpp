@@ -4,21 +4,17 @@
 #include <assert.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <atomic>
 #include <condition_variable>
+#include <deque>
 #include <functional>
+#include <memory>
 #include <mutex>
 #include <thread>
 #include <type_traits>
 #include <vector>
 
-//#define MPMC
-#ifdef MPMC
-#include "mpmc.hpp"
-#else
-#include "spmc.hpp"
-#endif
-
 template <class Func, class... Args> inline auto forward_as_lambda(Func &&func, Args &&... args) {
   return [f   = std::forward<decltype(func)>(func),
           tup = std::tuple<std::conditional_t<std::is_lvalue_reference_v<Args>, Args, std::remove_reference_t<Args>>...>(
@@ -33,107 +29,155 @@ template <class Func, class T, class... Args> inline auto forward_as_lambda2(Fun
   };
 }
 
+// Work stealing pool:
+//  -Each worker has a deque. A worker pushes/pops its own jobs at the back (LIFO, cache hot), idle workers steal
+//   from the front of the others (FIFO, oldest and usually biggest jobs).
+//  -Jobs added from outside the pool go round robin to the workers.
+//  -Idle workers park in a condition variable (no busy spin).
+//  -wait_all/Task_group::wait/parallel_for run jobs in the calling thread while waiting, so nested fork/join from
+//   inside a job does not deadlock. wait_all from inside a job does not wait for the jobs blocked in wait_all
+//   (itself included), only for the rest.
 class Thread_pool {
+  using Job = std::function<void(void)>;
 
-  std::vector<std::thread> threads;
-#ifdef MPMC
-  mpmc<std::function<void(void)>> queue;
-#else
-  spmc256<std::function<void(void)>> queue;
-#endif
+  struct Worker_queue {
+    std::mutex      mutex;
+    std::deque<Job> jobs;
+
+    void push_back(Job &&job) {
+      std::lock_guard<std::mutex> lock(mutex);
+      jobs.emplace_back(std::move(job));
+    }
+    bool pop_back(Job &job) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (jobs.empty()) return false;
+      job = std::move(jobs.back());
+      jobs.pop_back();
+      return true;
+    }
+    bool steal_front(Job &job) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (jobs.empty()) return false;
+      job = std::move(jobs.front());
+      jobs.pop_front();
+      return true;
+    }
+  };
+
+  std::vector<std::unique_ptr<Worker_queue>> queues;  // queues[i] owned by threads[i]
+  std::vector<std::thread>                   threads;
 
-  std::atomic<int>  jobs_left;
-  std::atomic<bool> finishing;
+  std::atomic<int>      jobs_left;    // queued or running, for wait_all
+  std::atomic<int>      jobs_waiting; // running jobs blocked in a nested wait_all
+  std::atomic<int>      jobs_queued;  // hint to park/unpark workers
+  std::atomic<int>      n_parked;
+  std::atomic<unsigned> next_queue;   // round robin for adds from outside the pool
+  std::atomic<bool>     finishing;
 
   size_t thread_count;
 
-  std::condition_variable job_available_var;
-  std::mutex              queue_mutex;
+  std::condition_variable park_var;
+  std::mutex              park_mutex;
 
-  void task() {
-    static std::atomic_flag lock = ATOMIC_FLAG_INIT;
+  inline static thread_local const Thread_pool *tl_pool = nullptr;
+  inline static thread_local size_t             tl_id   = 0;
+  inline static thread_local const Thread_pool *tl_job_pool = nullptr;  // pool of the job running in this thread
 
-    if (!lock.test_and_set(std::memory_order_acquire)) {
-      for(unsigned i = 1; i < thread_count; ++i)
-        threads.push_back(std::thread([this] { this->task(); }));
-    }
+  size_t self_id() const {
+    if (tl_pool == this) return tl_id;
+    return next_queue.load(std::memory_order_relaxed) % queues.size();  // helper thread: start anywhere
+  }
 
-    while(!finishing) {
-      while(!queue.empty()) {
-        next_job()();
-        jobs_left--;
-      }
+  bool get_job(size_t self, Job &job) {
+    bool found = queues[self]->pop_back(job);
+    for (size_t i = 1; !found && i < queues.size(); ++i) {
+      found = queues[(self + i) % queues.size()]->steal_front(job);
     }
+    if (found) jobs_queued.fetch_sub(1, std::memory_order_relaxed);
+    return found;
   }
 
-  std::function<void(void)> next_job() {
-    std::function<void(void)>    res;
-    std::unique_lock<std::mutex> job_lock(queue_mutex);
+  void run_job(Job &job) {
+    auto *prev_job_pool = tl_job_pool;
+    tl_job_pool         = this;
+    job();
+    tl_job_pool = prev_job_pool;
+    job         = nullptr;  // release captures before signaling completion
+    jobs_left.fetch_sub(1, std::memory_order_acq_rel);
+  }
+
+  void task(size_t id) {
+    tl_pool = this;
+    tl_id   = id;
 
-    // Wait for a job if we don't have any.
-    job_available_var.wait(job_lock, [this]() -> bool { return !queue.empty() || finishing; });
+    Job job;
+    while (true) {
+      if (get_job(id, job)) {
+        run_job(job);
+        continue;
+      }
 
-    bool has_work = queue.dequeue(res);
-    if(has_work) {
-      return res;
+      std::unique_lock<std::mutex> lock(park_mutex);
+      n_parked.fetch_add(1, std::memory_order_seq_cst);
+      park_var.wait(lock, [this]() -> bool { return jobs_queued.load(std::memory_order_seq_cst) > 0 || finishing; });
+      n_parked.fetch_sub(1, std::memory_order_relaxed);
+      if (finishing && jobs_queued.load() <= 0) return;
     }
+  }
 
-    jobs_left++; // To not affect the jobs left
+  void add_(Job &&job) {
+    jobs_left.fetch_add(1, std::memory_order_relaxed);
 
-    return [] {}; // Nothing to do
-  }
+    size_t q = tl_pool == this ? tl_id : next_queue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+    queues[q]->push_back(std::move(job));
 
-  void add_(std::function<void(void)> job) {
-    if(jobs_left > 48) {
-      job();
-      return;
+    jobs_queued.fetch_add(1, std::memory_order_seq_cst);
+    if (n_parked.load(std::memory_order_seq_cst) > 0) {
+      { std::lock_guard<std::mutex> lock(park_mutex); }  // a parking worker is either waiting or sees jobs_queued
+      park_var.notify_one();
     }
-    jobs_left++;
-    queue.enqueue(job);
-    job_available_var.notify_one();
   }
 
+  friend class Task_group;
+
 public:
   Thread_pool(int _thread_count = 0)
-      :
-#ifdef MPMC
-      queue(256)
-      ,
-#endif
-      jobs_left(0)
-      , finishing(false) {
-
+      : jobs_left(0), jobs_waiting(0), jobs_queued(0), n_parked(0), next_queue(0), finishing(false) {
     thread_count = _thread_count;
-    size_t lim   = (std::thread::hardware_concurrency() - 1); // -1 for calling thread
+    size_t lim   = (std::thread::hardware_concurrency() - 1);  // -1 for calling thread
 
-    if(thread_count > lim || thread_count == 0)
-      thread_count = lim;
-    else if(thread_count < 1)
-      thread_count = 1;
+    if (thread_count > lim || thread_count == 0) thread_count = lim;
+    if (thread_count < 1) thread_count = 1;
 
-    assert(thread_count);
-
-    threads.push_back(std::thread([this] { this->task(); })); // Just one thread in critical path
+    for (size_t i = 0; i < thread_count; ++i) {
+      queues.emplace_back(std::make_unique<Worker_queue>());
+    }
+    for (size_t i = 0; i < thread_count; ++i) {
+      threads.emplace_back([this, i] { this->task(i); });
+    }
   }
 
   ~Thread_pool() {
     wait_all();
 
     {
-      std::lock_guard<std::mutex> lock(queue_mutex);
+      std::lock_guard<std::mutex> lock(park_mutex);
       finishing = true;
     }
-    job_available_var.notify_all();
+    park_var.notify_all();
 
-    for(auto &x : threads)
-      if(x.joinable())
-        x.join();
+    for (auto &x : threads)
+      if (x.joinable()) x.join();
   }
 
-  inline unsigned size() const {
-    return thread_count;
+  // Process wide pool. Passes and the eprp stream share it, separate pools would oversubscribe the cores
+  static Thread_pool &shared() {
+    static Thread_pool pool;
+    return pool;
   }
 
+  inline unsigned size() const { return thread_count; }
+
   template <class Func, class... Args> void add(Func &&func, Args &&... args) {
     return add_(forward_as_lambda(std::forward<decltype(func)>(func), std::forward<decltype(args)>(args)...));
   }
@@ -144,16 +188,73 @@ public:
   }
 #endif
 
+  // Run one pending job in the calling thread. false if there was nothing to run
+  bool run_one() {
+    Job job;
+    if (!get_job(self_id(), job)) return false;
+    run_job(job);
+    return true;
+  }
+
   void wait_all() {
-    while(jobs_left > 0) {
-      std::function<void(void)> res;
-      bool                      has_work = queue.dequeue(res);
-      if(has_work) {
-        res();
-        jobs_left--;
+    if (tl_job_pool != this) {
+      while (jobs_left.load(std::memory_order_acquire) > 0) {
+        if (!run_one()) std::this_thread::yield();
       }
+      return;
+    }
+
+    // Inside a job: the job itself (and the others waiting here) are still in jobs_left
+    jobs_waiting.fetch_add(1, std::memory_order_acq_rel);
+    while (jobs_left.load(std::memory_order_acquire) > jobs_waiting.load(std::memory_order_acquire)) {
+      if (!run_one()) std::this_thread::yield();
     }
+    jobs_waiting.fetch_sub(1, std::memory_order_acq_rel);
   }
+
+  // fn(i) for i in [begin,end). Blocks until done, the calling thread also works.
+  template <class Func> void parallel_for(size_t begin, size_t end, Func &&fn, size_t grain = 0);
 };
 
+// Fork/join group of jobs. wait only waits for the jobs in this group (not all the pool).
+class Task_group {
+  Thread_pool &    pool;
+  std::atomic<int> pending;
+
+public:
+  explicit Task_group(Thread_pool &_pool) : pool(_pool), pending(0) {}
+  ~Task_group() { wait(); }
+
+  template <class Func> void run(Func &&func) {
+    pending.fetch_add(1, std::memory_order_relaxed);
+    pool.add_([this, f = std::forward<Func>(func)]() mutable {
+      f();
+      pending.fetch_sub(1, std::memory_order_release);
+    });
+  }
+
+  void wait() {
+    while (pending.load(std::memory_order_acquire) > 0) {
+      if (!pool.run_one()) std::this_thread::yield();
+    }
+  }
+};
+
+template <class Func> void Thread_pool::parallel_for(size_t begin, size_t end, Func &&fn, size_t grain) {
+  if (begin >= end) return;
+
+  if (grain == 0) grain = std::max<size_t>(1, (end - begin) / (4 * (thread_count + 1)));  // ~4 chunks per thread
+
+  Task_group group(*this);
+  size_t     b = begin;
+  for (; b + grain < end; b += grain) {
+    group.run([&fn, b, grain] {
+      for (size_t i = b; i < b + grain; ++i) fn(i);
+    });
+  }
+  for (size_t i = b; i < end; ++i) fn(i);  // last chunk in the calling thread
+
+  group.wait();
+}
+
 #endif